@@ -28,17 +28,30 @@ let package = Package(
                 "man",
                 "README.md",
                 "src/bench.c",
+                "src/client.c",
                 "src/genkat.c",
+                "src/node.c",
                 "src/opt.c",
                 "src/run.c",
+                "src/server.c",
                 "src/test.c",
+                "src/wire.c",
             ],
             sources: [
                 "src/blake2/blake2b.c",
                 "src/argon2.c",
                 "src/core.c",
                 "src/encoding.c",
+                "src/metrics.c",
                 "src/ref.c",
+                "src/scheduler.c",
+                "src/pool.c",
+                "src/mempool.c",
+                "src/pressure.c",
+                "src/tasks.c",
+                "src/upgrade.c",
+                "src/checkpoint.c",
+                "src/coalesce.c",
                 "src/thread.c"
             ]
         )
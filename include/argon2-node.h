@@ -0,0 +1,168 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_NODE_H
+#define ARGON2_NODE_H
+
+#include "argon2.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Hashing nodes. argon2_server_start() serves hashes and verifications to
+ * other machines over TCP: each request runs as argon2_verify_async_tenant()
+ * or argon2_ctx_tenant() would run it locally, so admission control, tenant
+ * queues, coalescing and batching all apply. argon2-node is a daemon around
+ * it. Available on POSIX systems in builds with threads.
+ *
+ * These functions are not in libargon2, which opens no sockets, but in
+ * libargon2-node (`make libargon2-node.a`): the library and the nodes in one
+ * archive, linked instead of libargon2.
+ *
+ * The protocol has neither authentication nor encryption: passwords cross
+ * the network in the clear, and the tenant a request names cannot be
+ * checked. A server therefore accounts every request to the tenant of its
+ * configuration, so that a peer cannot take the queue share or escape the
+ * caps of another tenant; with trust_tenants set, requests are accounted to
+ * the tenant they name instead, which only suits peers trusted to name it,
+ * such as the login servers of a shared deployment. Serve only on the
+ * loopback interface (the default) or on a network reserved for the login
+ * servers, or tunnel the connections. Requests with costs above the caps below are refused with
+ * ARGON2_MEMORY_TOO_MUCH, ARGON2_TIME_TOO_LARGE or ARGON2_LANES_TOO_MANY
+ * before anything is queued for them.
+ */
+typedef struct Argon2_server argon2_server;
+
+typedef struct Argon2_server_config {
+    const char *address; /* address or host name to listen on, NULL for the
+                            loopback address 127.0.0.1 */
+    unsigned port;       /* TCP port, 0 for one chosen by the system */
+    uint32_t max_m_cost; /* largest m_cost served in KiB, 0 for 1 GiB */
+    uint32_t max_t_cost; /* largest t_cost served, 0 for 16 */
+    uint32_t max_lanes;  /* largest parallelism served, 0 for 16 */
+    uint32_t max_connections; /* connections served at once, 0 for 256 */
+    uint32_t tenant;     /* tenant of every request, unless trust_tenants */
+    int trust_tenants;   /* account requests to the tenant they name */
+} argon2_server_config;
+
+/**
+ * Starts serving on background threads
+ * @param server  Where to store the new server
+ * @param config  Server parameters, NULL for the defaults
+ * @return  ARGON2_OK, ARGON2_MEMORY_ALLOCATION_ERROR, ARGON2_THREAD_FAIL, or
+ * ARGON2_NETWORK_FAIL if the address cannot be bound or the build has no
+ * sockets
+ */
+ARGON2_PUBLIC int argon2_server_start(argon2_server **server,
+                                      const argon2_server_config *config);
+
+/**
+ * Returns the TCP port @server listens on
+ */
+ARGON2_PUBLIC unsigned argon2_server_port(const argon2_server *server);
+
+/**
+ * Stops listening, closes the connections once the requests already received
+ * are answered, and frees @server
+ */
+ARGON2_PUBLIC void argon2_server_stop(argon2_server *server);
+
+/*
+ * Client of a set of hashing nodes, which any number of threads can share.
+ * Each request goes to the node with the fewest requests outstanding from
+ * this client, over one of at most @connections connections to it; a
+ * connection carries the requests of many threads at once. A request still
+ * unanswered after @hedge_ms milliseconds (unless 0) is sent once more, to
+ * another node, and the first response wins. Requests on a node that fails
+ * move to another one, and the node is skipped for a second. Nodes are given
+ * as "host:port", or "[address]:port" for IPv6.
+ */
+typedef struct Argon2_client_config {
+    const char *const *nodes;
+    size_t node_count;
+    uint32_t connections; /* per node, 0 for 1 */
+    uint32_t timeout_ms;  /* per request, 0 for 10 seconds */
+    uint32_t hedge_ms;    /* delay before a second node is tried, 0 for never */
+} argon2_client_config;
+
+typedef struct Argon2_client argon2_client;
+
+/* Counters of a client */
+typedef struct Argon2_client_stats {
+    uint64_t requests; /* calls of argon2_client_verify/hash */
+    uint64_t hedges;   /* requests also sent to a second node */
+    uint64_t retries;  /* requests sent again after a node failed */
+    uint64_t timeouts; /* requests that got ARGON2_NODE_TIMEOUT */
+} argon2_client_stats;
+
+/**
+ * Creates a client of the nodes in @config, which it copies; connections are
+ * only opened by the first requests
+ * @return  ARGON2_OK, ARGON2_INCORRECT_PARAMETER for an empty or malformed
+ * node list, ARGON2_MEMORY_ALLOCATION_ERROR, or ARGON2_NETWORK_FAIL in builds
+ * without sockets
+ */
+ARGON2_PUBLIC int argon2_client_create(argon2_client **client,
+                                       const argon2_client_config *config);
+
+/**
+ * Closes the connections of @client and frees it; no call may be running
+ */
+ARGON2_PUBLIC void argon2_client_destroy(argon2_client *client);
+
+/**
+ * Verifies a password against an encoded string on a node, as
+ * argon2_verify_tenant() would; nodes only account it to @tenant if they
+ * trust their clients to name it (argon2_server_config.trust_tenants)
+ * @return  The result of the node, or ARGON2_NODE_TIMEOUT if none answered
+ * within the timeout
+ */
+ARGON2_PUBLIC int argon2_client_verify(argon2_client *client, uint32_t tenant,
+                                       const char *encoded, const void *pwd,
+                                       const size_t pwdlen, argon2_type type);
+
+/**
+ * Hashes a password on a node into an encoded string, as argon2_hash() would
+ * with the current version and no raw hash, accounted to @tenant as
+ * argon2_client_verify() is
+ * @return  The result of the node, ARGON2_ENCODING_FAIL if @encodedlen is too
+ * short for its encoded string, or ARGON2_NODE_TIMEOUT if none answered
+ * within the timeout
+ */
+ARGON2_PUBLIC int argon2_client_hash(argon2_client *client, uint32_t tenant,
+                                     const uint32_t t_cost,
+                                     const uint32_t m_cost,
+                                     const uint32_t parallelism,
+                                     const void *pwd, const size_t pwdlen,
+                                     const void *salt, const size_t saltlen,
+                                     const size_t hashlen, char *encoded,
+                                     const size_t encodedlen,
+                                     argon2_type type);
+
+/**
+ * Reads the counters of @client
+ */
+ARGON2_PUBLIC void argon2_client_snapshot(argon2_client *client,
+                                          argon2_client_stats *stats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
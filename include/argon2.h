@@ -91,6 +91,18 @@ extern "C" {
 #define ARGON2_DEFAULT_FLAGS UINT32_C(0)
 #define ARGON2_FLAG_CLEAR_PASSWORD (UINT32_C(1) << 0)
 #define ARGON2_FLAG_CLEAR_SECRET (UINT32_C(1) << 1)
+/* Lock the memory blocks in RAM (mlock) while hashing, so that swapping or
+ * reclaim cannot stall the computation. If locking fails, e.g. because of
+ * RLIMIT_MEMLOCK, hashing proceeds unlocked and the failure is counted in
+ * argon2_metrics.lock_failures. */
+#define ARGON2_FLAG_LOCK_MEMORY (UINT32_C(1) << 2)
+/* Physical layout of the memory blocks; the output is the same with any of
+ * them. By default lanes are stored one after the other. SEGMENT_MAJOR stores
+ * the memory slice by slice, so that the segments being filled at the same
+ * time are contiguous. SPLIT_LANES allocates each lane separately (ignored
+ * with caller-supplied memory). At most one of them may be set. */
+#define ARGON2_FLAG_LAYOUT_SEGMENT_MAJOR (UINT32_C(1) << 3)
+#define ARGON2_FLAG_LAYOUT_SPLIT_LANES (UINT32_C(1) << 4)
 
 /* Global flag to determine if we are wiping internal memory buffers. This flag
  * is defined in core.c and defaults to 1 (wipe internal memory). */
@@ -154,7 +166,18 @@ typedef enum Argon2_ErrorCodes {
 
     ARGON2_DECODING_LENGTH_FAIL = -34,
 
-    ARGON2_VERIFY_MISMATCH = -35
+    ARGON2_VERIFY_MISMATCH = -35,
+
+    ARGON2_MATRIX_MISMATCH = -36, /* NULL, short or misaligned matrix */
+
+    ARGON2_PRESSURE_UNAVAILABLE = -37, /* no readable memory pressure file */
+
+    ARGON2_CHECKPOINT_FAIL = -38,
+
+    ARGON2_CHECKPOINT_MISMATCH = -39, /* other inputs, or a damaged file */
+
+    ARGON2_NETWORK_FAIL = -40, /* cannot listen, or no sockets in this build */
+    ARGON2_NODE_TIMEOUT = -41  /* no hashing node answered in time */
 } argon2_error_codes;
 
 /* Memory allocator types --- for external allocation */
@@ -246,6 +269,58 @@ ARGON2_PUBLIC const char *argon2_type2string(argon2_type type, int uppercase);
  */
 ARGON2_PUBLIC int argon2_ctx(argon2_context *context, argon2_type type);
 
+/*
+ * Same as argon2_ctx(), on behalf of @tenant (see argon2_tenant_configure())
+ */
+ARGON2_PUBLIC int argon2_ctx_tenant(argon2_context *context, argon2_type type,
+                                    uint32_t tenant);
+
+/*
+ * Resources consumed by one call, as reported by argon2_ctx_cost() and
+ * argon2_verify_cost() and summed per tenant by argon2_tenant_snapshot().
+ * CPU time covers the calling thread and every worker thread that filled
+ * segments of the hash; it is 0 where the system does not measure
+ * per-thread CPU time. Memory traffic follows from @blocks: computing a
+ * block reads two blocks of 1 KiB and writes one.
+ */
+typedef struct Argon2_cost {
+    uint64_t cpu_time;   /* nanoseconds of CPU time, on all threads */
+    uint64_t memory;     /* bytes of memory matrix allocated, 0 when the
+                            caller supplied it */
+    uint64_t blocks;     /* blocks computed */
+    uint64_t queue_time; /* microseconds spent waiting for admission */
+} argon2_cost;
+
+/*
+ * Same as argon2_ctx_tenant(), and reports in @cost what the hash took
+ */
+ARGON2_PUBLIC int argon2_ctx_cost(argon2_context *context, argon2_type type,
+                                  uint32_t tenant, argon2_cost *cost);
+
+/*
+ * Same as argon2_ctx(), but fills the caller-supplied @matrix instead of
+ * allocating the memory blocks. The allocation callbacks of @context are not
+ * used; the matrix is wiped (subject to FLAG_clear_internal_memory) but never
+ * freed. With context->threads == 1 no heap allocation takes place.
+ * @param  context  Pointer to the Argon2 internal structure
+ * @param  matrix  Buffer for the memory blocks, aligned for uint64_t access
+ * @param  matrix_len  Size of @matrix in bytes, at least
+ * argon2_memory_required(context->m_cost, context->lanes)
+ * @return Error code if smth is wrong, ARGON2_OK otherwise
+ */
+ARGON2_PUBLIC int argon2_ctx_with_memory(argon2_context *context,
+                                         argon2_type type, void *matrix,
+                                         size_t matrix_len);
+
+/*
+ * Returns the size of the memory blocks argon2_ctx() allocates for the given
+ * memory cost and number of lanes
+ * @param m_cost  Memory usage in kibibytes
+ * @param lanes  Number of lanes
+ * @return  The matrix size in bytes, 0 if the parameters are out of range
+ */
+ARGON2_PUBLIC size_t argon2_memory_required(uint32_t m_cost, uint32_t lanes);
+
 /**
  * Hashes a password with Argon2i, producing an encoded hash
  * @param t_cost Number of iterations
@@ -327,6 +402,63 @@ ARGON2_PUBLIC int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
                               const size_t encodedlen, argon2_type type,
                               const uint32_t version);
 
+/* Size of the buffer holding the header of an encoded hash, such as
+ * "$argon2id$v=19$m=65536,t=2,p=1$", with three 10-digit numbers */
+#define ARGON2_HEADER_MAX 64
+
+/*
+ * A fixed parameter set for hashing many passwords into encoded hashes. The
+ * parameter part of the encoded hashes is rendered once by argon2_hasher_init()
+ * and copied into each of them.
+ */
+typedef struct Argon2_hasher {
+    uint32_t t_cost;
+    uint32_t m_cost;
+    uint32_t parallelism;
+    uint32_t hashlen;
+    argon2_type type;
+    uint32_t version;
+
+    char header[ARGON2_HEADER_MAX]; /* "$argon2id$v=19$m=...,t=...,p=...$" */
+    size_t headerlen;
+} argon2_hasher;
+
+/**
+ * Prepares a hasher: the parameters are validated and the header of the
+ * encoded hashes rendered
+ * @param hasher  Hasher to initialize
+ * @param hashlen  Desired length of the hash in bytes
+ * @param type  Argon2 type
+ * @param version  Argon2 version
+ * @return  ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_hasher_init(argon2_hasher *hasher,
+                                     const uint32_t t_cost,
+                                     const uint32_t m_cost,
+                                     const uint32_t parallelism,
+                                     const size_t hashlen, argon2_type type,
+                                     const uint32_t version);
+
+/**
+ * Hashes a password into an encoded hash, as argon2_hash() would with the
+ * parameters of @hasher
+ * @param encoded  Buffer where to write the encoded hash
+ * @param encodedlen  Size of the buffer, at least
+ * argon2_hasher_encodedlen(@hasher, @saltlen)
+ * @return  ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_hasher_hash(const argon2_hasher *hasher,
+                                     const void *pwd, const size_t pwdlen,
+                                     const void *salt, const size_t saltlen,
+                                     char *encoded, const size_t encodedlen);
+
+/**
+ * Returns the length of the encoded hashes of @hasher for salts of
+ * @saltlen bytes, including the terminating zero
+ */
+ARGON2_PUBLIC size_t argon2_hasher_encodedlen(const argon2_hasher *hasher,
+                                              uint32_t saltlen);
+
 /**
  * Verifies a password against an encoded string
  * Encoded string is restricted as in validate_inputs()
@@ -347,6 +479,148 @@ ARGON2_PUBLIC int argon2id_verify(const char *encoded, const void *pwd,
 ARGON2_PUBLIC int argon2_verify(const char *encoded, const void *pwd,
                                 const size_t pwdlen, argon2_type type);
 
+/* argon2_verify() on behalf of @tenant, see argon2_tenant_configure() */
+ARGON2_PUBLIC int argon2_verify_tenant(const char *encoded, const void *pwd,
+                                       const size_t pwdlen, argon2_type type,
+                                       uint32_t tenant);
+
+/* argon2_verify_tenant() reporting in @cost what the hash took, whatever the
+ * result */
+ARGON2_PUBLIC int argon2_verify_cost(const char *encoded, const void *pwd,
+                                     const size_t pwdlen, argon2_type type,
+                                     uint32_t tenant, argon2_cost *cost);
+
+/* Receives the result of argon2_verify_async(), as argon2_verify() would
+ * return it */
+typedef void (*argon2_verify_callback)(int result, void *arg);
+
+/**
+ * Verifies a password against an encoded hash on a library worker thread,
+ * and hands the result to @callback from that thread. A request identical
+ * to one still in flight (same @encoded, password and type) does not start
+ * a verification of its own: it attaches to the running one and receives
+ * its result. Requests are told apart by a BLAKE2b digest of their inputs,
+ * keyed with a random key of the process. Builds without threads verify
+ * before returning. A child process forked meanwhile starts workers of its
+ * own; requests of its parent still in flight call back in the parent only.
+ * @param callback  Called exactly once if ARGON2_OK is returned, never
+ * otherwise
+ * @param arg  Passed on to @callback
+ * @return  ARGON2_OK if the request was accepted, an error code otherwise
+ */
+ARGON2_PUBLIC int argon2_verify_async(const char *encoded, const void *pwd,
+                                      const size_t pwdlen, argon2_type type,
+                                      argon2_verify_callback callback,
+                                      void *arg);
+
+/*
+ * Micro-batching of asynchronous verifications, off by default. While every
+ * processor already has a verification in flight or hashes are waiting for
+ * admission, a request is held for up to @window_us microseconds to gather
+ * others of the same tenant and parameters (type, version, memory, passes,
+ * lanes), up to @max_batch of them; the batch then takes a single worker and
+ * admission ticket and runs its verifications back to back in one memory
+ * matrix, which saves the allocation and page faults of each hash. The
+ * window shrinks to the time a batch is expected to take to fill at the
+ * recent arrival rate; with processors to spare, requests start at once.
+ */
+typedef struct Argon2_batch_config {
+    uint32_t window_us; /* longest wait for more requests, in microseconds */
+    uint32_t max_batch; /* verifications per batch, at most */
+} argon2_batch_config;
+
+/**
+ * Configures (or with NULL, turns off) micro-batching of asynchronous
+ * verifications. Requests being gathered are dispatched at once.
+ * @param config  Batching parameters, NULL to turn batching off
+ * @return  ARGON2_OK, ARGON2_INCORRECT_PARAMETER if @max_batch is 0, or
+ * ARGON2_THREAD_FAIL in builds without threads
+ */
+ARGON2_PUBLIC int argon2_batch_configure(const argon2_batch_config *config);
+
+/* argon2_verify_async() on behalf of @tenant, see argon2_tenant_configure().
+ * Requests of different tenants are never coalesced. */
+ARGON2_PUBLIC int argon2_verify_async_tenant(const char *encoded,
+                                             const void *pwd,
+                                             const size_t pwdlen,
+                                             argon2_type type, uint32_t tenant,
+                                             argon2_verify_callback callback,
+                                             void *arg);
+
+/* Parameters an encoded hash is migrated to by argon2_verify_and_upgrade() */
+typedef struct Argon2_upgrade_params {
+    argon2_type type;
+    uint32_t version;
+    uint32_t t_cost;
+    uint32_t m_cost;
+    uint32_t parallelism;
+    const uint8_t *salt; /* fresh salt for the new hash, copied */
+    uint32_t saltlen;
+    uint32_t hashlen;
+} argon2_upgrade_params;
+
+/* Receives the upgraded hash: @encoded is only valid during the call, and
+ * NULL unless @result is ARGON2_OK */
+typedef void (*argon2_upgrade_callback)(int result, const char *encoded,
+                                        void *arg);
+
+/**
+ * Verifies a password against an encoded hash and, if it matches but the
+ * hash was made with other parameters than @params, rehashes the password
+ * with @params off the caller's path: on a background thread of the lowest
+ * scheduling priority, one lane at a time. Rehashes bypass admission control
+ * (see argon2_sched_configure()), so that a starved one never holds a slot
+ * or tenant budget that foreground hashes wait for; at most one runs per
+ * processor. The new encoded hash is handed to @callback, from that thread.
+ * Builds without threads rehash before returning. Rehashes queued when a
+ * child process is forked run in the parent only.
+ * @param encoded  Encoded hash to verify against
+ * @param type  Argon2 type of @encoded
+ * @param params  Parameters to upgrade to
+ * @param callback  Called exactly once with the outcome of the rehash when
+ * ARGON2_OK is returned and @encoded was made with other parameters, never
+ * otherwise
+ * @param arg  Passed on to @callback
+ * @return  The verification result, as argon2_verify() would return it
+ */
+ARGON2_PUBLIC int argon2_verify_and_upgrade(const char *encoded,
+                                            const void *pwd,
+                                            const size_t pwdlen,
+                                            argon2_type type,
+                                            const argon2_upgrade_params *params,
+                                            argon2_upgrade_callback callback,
+                                            void *arg);
+
+/**
+ * Computes a hash like argon2_ctx(), saving the memory matrix to the file
+ * @checkpoint at pass boundaries, so that a computation interrupted by a
+ * crash or preemption can go on with argon2_resume() from the last pass
+ * saved. The first pass is always saved; later ones are skipped while the
+ * last save is recent enough that saving would take more than about a fifth
+ * of the time. The file is encrypted and authenticated with keys derived
+ * from all the inputs, replaced atomically, and removed once the hash is
+ * computed.
+ * @param  context  Pointer to current Argon2 context
+ * @param  type  Argon2 type
+ * @param  checkpoint  Path of the checkpoint file
+ * @return  Zero if successful, a non zero error code otherwise
+ */
+ARGON2_PUBLIC int argon2_ctx_checkpoint(argon2_context *context,
+                                        argon2_type type,
+                                        const char *checkpoint);
+
+/**
+ * Finishes the computation checkpointed to @checkpoint by
+ * argon2_ctx_checkpoint(), saving further checkpoints to the same file
+ * @param  checkpoint  Path of the checkpoint file
+ * @param  context  The context the computation was started with; only the
+ * number of threads, the memory layout and the allocator may differ
+ * @return  Zero if successful, ARGON2_CHECKPOINT_MISMATCH if the checkpoint
+ * was not made with these inputs, a non zero error code otherwise
+ */
+ARGON2_PUBLIC int argon2_resume(const char *checkpoint,
+                                argon2_context *context);
+
 /**
  * Argon2d: Version of Argon2 that picks memory blocks depending
  * on the password and salt. Only for side-channel-free
@@ -430,6 +704,302 @@ ARGON2_PUBLIC size_t argon2_encodedlen(uint32_t t_cost, uint32_t m_cost,
                                        uint32_t parallelism, uint32_t saltlen,
                                        uint32_t hashlen, argon2_type type);
 
+/**
+ * Converts an encoded hash into a compact binary record of the same
+ * parameters, salt and hash: about half the size, and verified without any
+ * text parsing or base64 decoding
+ * @param dst  Buffer where to write the record
+ * @param dstlen  Size of @dst on input, length of the record on output
+ * @param encoded  Encoded hash to convert
+ * @param type  Argon2 type of @encoded
+ * @return  ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_encode_binary(void *dst, size_t *dstlen,
+                                       const char *encoded, argon2_type type);
+
+/**
+ * Converts a binary record made by argon2_encode_binary() back into an
+ * encoded hash
+ * @param encoded  Buffer where to write the encoded hash
+ * @param encodedlen  Size of @encoded
+ * @param src  Binary record
+ * @param srclen  Length of the record
+ * @param type  Receives the Argon2 type of the record; may be NULL
+ * @return  ARGON2_OK if successful
+ */
+ARGON2_PUBLIC int argon2_decode_binary(char *encoded, size_t encodedlen,
+                                       const void *src, size_t srclen,
+                                       argon2_type *type);
+
+/**
+ * Verifies a password against a binary record, as argon2_verify() does
+ * against the equivalent encoded hash; the type is read from the record
+ * @param src  Binary record
+ * @param srclen  Length of the record
+ */
+ARGON2_PUBLIC int argon2_verify_binary(const void *src, size_t srclen,
+                                       const void *pwd, const size_t pwdlen);
+
+/**
+ * Returns the binary record length for the given input parameters
+ * @param t_cost  Number of iterations
+ * @param m_cost  Memory usage in kibibytes
+ * @param parallelism  Number of threads; used to compute lanes
+ * @param saltlen  Salt size in bytes
+ * @param hashlen  Hash size in bytes
+ * @return  The binary record length in bytes
+ */
+ARGON2_PUBLIC size_t argon2_binarylen(uint32_t t_cost, uint32_t m_cost,
+                                      uint32_t parallelism, uint32_t saltlen,
+                                      uint32_t hashlen);
+
+/* Number of argon2_type values tracked by argon2_metrics */
+#define ARGON2_METRICS_TYPES 3
+/* Failures are tracked for error codes 0 down to -(ARGON2_METRICS_ERRORS-1) */
+#define ARGON2_METRICS_ERRORS 64
+/* Latency bucket i counts operations of [2^i, 2^(i+1)) microseconds; the last
+ * bucket also counts anything slower */
+#define ARGON2_METRICS_LATENCY_BUCKETS 32
+
+/*
+ * Process-wide library metrics, as returned by argon2_metrics_snapshot().
+ * Counters are cumulative since the process started, gauges are current
+ * values. A hash or verification is counted as completed whatever its
+ * outcome; unsuccessful ones are also counted under their error code. A
+ * verification also counts as the hash it runs.
+ */
+typedef struct Argon2_metrics {
+    uint64_t hashes_started[ARGON2_METRICS_TYPES];     /* by argon2_type */
+    uint64_t hashes_completed[ARGON2_METRICS_TYPES];
+    uint64_t verifies_started[ARGON2_METRICS_TYPES];
+    uint64_t verifies_completed[ARGON2_METRICS_TYPES];
+    uint64_t failures[ARGON2_METRICS_ERRORS]; /* indexed by -error_code */
+
+    int64_t bytes_allocated; /* gauge: memory block bytes held right now */
+    int64_t pool_occupancy;  /* gauge: worker threads filling segments */
+    int64_t queue_depth;     /* gauge: hashes waiting to be started */
+    uint64_t lock_failures;  /* ARGON2_FLAG_LOCK_MEMORY requests not honored */
+    int64_t sched_running;   /* gauge: admission-controlled hashes running */
+    int64_t sched_limit;     /* gauge: how many of them may run at once */
+    uint64_t pool_steals;    /* segments filled away from their lane's worker */
+    int64_t mempool_retained; /* gauge: bytes of idle matrices kept mapped */
+    int64_t mempool_resident; /* gauge: bytes of pooled matrices in RAM */
+    uint64_t mempool_hits;    /* matrices reused from the pool */
+    uint64_t mempool_misses;  /* matrices the pool had to map */
+    int64_t memory_pressure;  /* gauge: PSI "some avg10", in 1/100 percent */
+    uint64_t pressure_throttles; /* times memory pressure throttled admission */
+    int64_t upgrades_pending; /* gauge: rehashes queued or running */
+    uint64_t verify_coalesced; /* async verifications served by another */
+    uint64_t verify_batches;   /* batches of async verifications run */
+    uint64_t verify_batched;   /* async verifications run in those batches */
+
+    uint64_t hash_latency[ARGON2_METRICS_LATENCY_BUCKETS];
+    uint64_t verify_latency[ARGON2_METRICS_LATENCY_BUCKETS];
+} argon2_metrics;
+
+/**
+ * Copies the current library metrics into @metrics. The copy is taken
+ * without blocking the hashing threads (except with compilers lacking
+ * atomics, where a lock guards the counters), and is the state of the
+ * counters at one instant: it is retried while hashes update them. If
+ * updates keep interrupting it, the copy may mix instants, but still never
+ * shows part of an update (a completion without its latency bucket, say),
+ * and no *_completed counter exceeds its *_started counterpart.
+ * @param metrics  Where to write the snapshot
+ */
+ARGON2_PUBLIC void argon2_metrics_snapshot(argon2_metrics *metrics);
+
+/*
+ * Admission control for DRAM-sized hashes. Argon2 with a large memory cost is
+ * bound by memory bandwidth: past some number of concurrent hashes, running
+ * more at once only makes every one of them slower. With the scheduler
+ * configured, hashes of at least @dram_threshold KiB are admitted in FIFO
+ * order within each tenant (see argon2_tenant_configure()), and only as many
+ * run at once as the limit allows; smaller hashes are never held back by
+ * the limit. The limit is the smallest of:
+ *  - @max_concurrency (the number of online processors if 0);
+ *  - the number of hashes whose measured block throughput fits within
+ *    @bandwidth_cap MB/s of memory traffic (unless 0);
+ *  - if @adaptive is set, the saturation point, found by raising the limit
+ *    while it still increases the aggregate block throughput.
+ */
+typedef struct Argon2_sched_config {
+    uint32_t dram_threshold;  /* memory cost (KiB) of admission-controlled hashes */
+    uint32_t max_concurrency; /* hard limit, 0 for the number of processors */
+    uint32_t bandwidth_cap;   /* memory traffic cap in MB/s, 0 for none */
+    uint32_t adaptive;        /* whether to look for the saturation point */
+} argon2_sched_config;
+
+/**
+ * Configures (or with NULL, turns off) admission control for DRAM-sized
+ * hashes, which is off by default. Hashes already admitted keep running.
+ * @param config  Scheduler parameters, NULL to admit everything at once
+ * @return  ARGON2_OK, or ARGON2_THREAD_FAIL in builds without threads
+ */
+ARGON2_PUBLIC int argon2_sched_configure(const argon2_sched_config *config);
+
+/*
+ * Tenants. Hashes started through argon2_ctx_tenant(), argon2_verify_tenant()
+ * or argon2_verify_async_tenant() are accounted to the tenant given, all
+ * others to tenant 0. Hashes waiting for admission (see
+ * argon2_sched_configure()) are queued per tenant, and admitted by deficit
+ * round-robin across tenants, in proportion to @weight: a tenant flooding
+ * the scheduler only lengthens its own queue. On top of the global limit,
+ * a tenant may be capped to @max_concurrency running hashes and to
+ * @max_memory KiB of memory held by its running hashes; a capped tenant has
+ * all its hashes admission-controlled, whatever their size. A single hash
+ * larger than @max_memory still runs, alone. Asynchronous verifications
+ * wait for admission before taking a worker thread. Configured tenants are
+ * always tracked apart, but only the first 4096 tenants without
+ * configuration are: the hashes of later ones are accounted to tenant 0.
+ */
+typedef struct Argon2_tenant_config {
+    uint32_t weight;          /* share of admitted work, 0 for 1 */
+    uint32_t max_concurrency; /* running hashes, 0 for no cap */
+    uint32_t max_memory;      /* KiB held by running hashes, 0 for no cap */
+} argon2_tenant_config;
+
+/**
+ * Configures (or with NULL, resets to weight 1 without caps) a tenant.
+ * Hashes already admitted keep running; those of tenant 0 admitted while
+ * admission control was off and it had no caps do not count against its
+ * new caps.
+ * @param tenant  Tenant identifier
+ * @param config  Tenant parameters, NULL for the defaults
+ * @return  ARGON2_OK, ARGON2_MEMORY_ALLOCATION_ERROR, or ARGON2_THREAD_FAIL
+ * in builds without threads
+ */
+ARGON2_PUBLIC int argon2_tenant_configure(uint32_t tenant,
+                                          const argon2_tenant_config *config);
+
+/* Queue metrics of one tenant, as returned by argon2_tenant_snapshot() */
+typedef struct Argon2_tenant_metrics {
+    int64_t queued;      /* gauge: hashes waiting for admission */
+    int64_t running;     /* gauge: hashes admitted and not done */
+    int64_t memory;      /* gauge: KiB held by running hashes */
+    uint64_t admitted;   /* hashes admitted */
+    uint64_t delayed;    /* hashes that had to wait for admission */
+    uint64_t queue_time; /* microseconds spent waiting, summed */
+    uint64_t cpu_time;   /* nanoseconds of CPU time, see argon2_cost */
+    uint64_t allocated;  /* bytes of memory matrices allocated */
+    uint64_t blocks;     /* blocks computed */
+} argon2_tenant_metrics;
+
+/**
+ * Copies the queue metrics of @tenant into @metrics; tenants without
+ * configuration or hashes have all of them at zero
+ * @param tenant  Tenant identifier
+ * @param metrics  Where to write the snapshot
+ * @return  ARGON2_OK, or ARGON2_THREAD_FAIL in builds without threads
+ */
+ARGON2_PUBLIC int argon2_tenant_snapshot(uint32_t tenant,
+                                         argon2_tenant_metrics *metrics);
+
+/*
+ * Throttling of admission on memory pressure. Fixed limits cannot account
+ * for what else runs on the host; with the watcher configured, the share of
+ * time tasks stalled on memory over the last 10 seconds (the "some avg10"
+ * line of Linux PSI) is polled every @interval_ms milliseconds, and:
+ *  - above @slow_threshold, admission-controlled hashes run one at a time;
+ *  - above @stop_threshold, new ones are queued until pressure subsides.
+ * Each level is left once pressure falls below 3/4 of its threshold.
+ * Thresholds are in hundredths of a percent, 0 disables a level. Only hashes
+ * under admission control (see argon2_sched_configure()) are throttled;
+ * hashes already running are never interrupted.
+ */
+typedef struct Argon2_pressure_config {
+    const char *path;        /* PSI file, NULL for the process's cgroup v2
+                                memory.pressure, else /proc/pressure/memory */
+    uint32_t slow_threshold; /* pressure above which hashes are serialized */
+    uint32_t stop_threshold; /* pressure above which hashes are queued */
+    uint32_t interval_ms;    /* polling period, 0 for one second */
+} argon2_pressure_config;
+
+/**
+ * Starts (or with NULL, stops) watching memory pressure, which is off by
+ * default and in child processes forked while it is on
+ * @param config  Watcher parameters, NULL to stop throttling
+ * @return  ARGON2_OK, ARGON2_PRESSURE_UNAVAILABLE if no pressure file can be
+ * read, or ARGON2_THREAD_FAIL in builds without threads
+ */
+ARGON2_PUBLIC int argon2_pressure_configure(const argon2_pressure_config *config);
+
+/*
+ * Retention of memory matrices between hashes, off by default. With the pool
+ * configured, matrices are mapped directly from the system and kept when a
+ * hash ends (wiped as usual), so that the next hash of about the same size
+ * skips the allocation and page faults. Only hashes using the default
+ * allocator are pooled.
+ *  - Idle matrices beyond @high_watermark bytes are released at once.
+ *  - Matrices unused for @idle_ms milliseconds (unless 0) are released while
+ *    more than @low_watermark bytes are idle; the remaining cold ones are
+ *    handed back to the kernel (MADV_FREE) but stay mapped for reuse.
+ *  - With @pregrow set, when demand (hashes running plus hashes waiting for
+ *    admission, see argon2_sched_configure()) rises, matrices of the most
+ *    recent size are mapped and faulted in ahead of time, up to
+ *    @high_watermark.
+ * Trimming and pre-growing run on a background thread; builds without
+ * threads only trim when a matrix is taken or returned.
+ */
+typedef struct Argon2_mempool_config {
+    size_t low_watermark;  /* idle bytes kept however cold */
+    size_t high_watermark; /* idle bytes kept at most */
+    uint32_t idle_ms;      /* idle time before trimming, 0 to never trim */
+    uint32_t pregrow;      /* whether to map matrices ahead of demand */
+} argon2_mempool_config;
+
+/**
+ * Configures the matrix pool, or with NULL turns it off and releases the
+ * idle matrices
+ * @param config  Pool parameters, NULL to turn the pool off
+ * @return  ARGON2_OK, or ARGON2_INCORRECT_PARAMETER if the low watermark is
+ * above the high one
+ */
+ARGON2_PUBLIC int argon2_mempool_configure(const argon2_mempool_config *config);
+
+/*
+ * Placement of lanes on the worker pool that fills the memory of multi-lane
+ * hashes. Lanes of a hash bigger than the L2 cache mostly wait for DRAM, so
+ * two of them on the hardware threads of one core run almost as fast as on
+ * two cores: PACK fills both siblings of a core before moving to the next,
+ * leaving whole cores to other work. Lanes of a small, cache-resident hash
+ * compete for the execution units instead, and SPREAD gives each its own
+ * core first. AUTO picks PACK or SPREAD per hash by comparing the lane size
+ * to the L2 cache size.
+ */
+typedef enum Argon2_placement {
+    ARGON2_PLACEMENT_AUTO = 0,
+    ARGON2_PLACEMENT_PACK = 1,
+    ARGON2_PLACEMENT_SPREAD = 2
+} argon2_placement;
+
+/**
+ * Selects the lane placement policy for subsequent hashes
+ * @param placement  One of the argon2_placement values
+ * @return  ARGON2_OK, ARGON2_INCORRECT_PARAMETER for an unknown policy, or
+ * ARGON2_THREAD_FAIL in builds without threads
+ */
+ARGON2_PUBLIC int argon2_set_placement(argon2_placement placement);
+
+/**
+ * Returns the placement a hash with the given costs would get under the
+ * current policy, i.e. resolves ARGON2_PLACEMENT_AUTO
+ * @param m_cost  Memory cost in KiB
+ * @param lanes  Degree of parallelism
+ * @return  ARGON2_PLACEMENT_PACK or ARGON2_PLACEMENT_SPREAD, or
+ * ARGON2_PLACEMENT_AUTO in builds without threads
+ */
+ARGON2_PUBLIC argon2_placement argon2_placement_for(uint32_t m_cost,
+                                                    uint32_t lanes);
+
+/**
+ * Get the name of a placement policy
+ * @param placement  The placement policy
+ * @return  NULL if invalid, otherwise the lowercase name ("auto", "pack",
+ * "spread")
+ */
+ARGON2_PUBLIC const char *argon2_placement2string(argon2_placement placement);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -1,20 +1,92 @@
+import os
+import subprocess
+import sys
 from pathlib import Path
 from setuptools import Extension, setup
+from setuptools.command.build_ext import build_ext
+
+library_sources = [
+	"src/argon2.c", "src/core.c",
+	"src/encoding.c",
+	"src/metrics.c",
+	"src/scheduler.c",
+	"src/pool.c",
+	"src/mempool.c",
+	"src/pressure.c",
+	"src/tasks.c",
+	"src/upgrade.c",
+	"src/checkpoint.c",
+	"src/coalesce.c",
+	"src/thread.c", 
+	"src/blake2/blake2b.c",
+	"src/opt.c",
+]
+
+# ARGON2_AMALGAMATION=1 compiles the library as a single translation unit, as
+# `make AMALGAMATION=1` does, for the compiler to inline across modules
+if os.environ.get("ARGON2_AMALGAMATION") == "1":
+	Path("argon2_amalgamated.c").write_text(
+		"/* Generated by setup.py from the library sources, do not edit */\n"
+		+ "#include \"src/amalgamation.h\"\n"
+		+ "".join("#include \"%s\"\n" % source for source in library_sources))
+	library_sources = ["argon2_amalgamated.c"]
+
+# Workload the profile of ARGON2_PGO=1 is collected from, as `bench workload`
+# for `make pgo`: small to large memory, one to four lanes, all three types,
+# hashing and verification
+PGO_WORKLOAD = """
+import argon2
+for iterations, memcost, parallelism, repeat in (
+		(3, 1 << 6, 1, 200), (3, 1 << 10, 1, 40), (2, 1 << 12, 2, 20),
+		(2, 1 << 14, 4, 6), (1, 1 << 16, 2, 2)):
+	for hash_encoded in (argon2.ihash_encoded, argon2.dhash_encoded,
+			argon2.idhash_encoded):
+		for i in range(repeat):
+			encoded = hash_encoded(b"password", b"somesaltsomesalt", iterations,
+					memcost, parallelism, 32)
+			assert argon2.check(encoded, b"password") == 0
+"""
+
+class build_ext_pgo(build_ext):
+	"""ARGON2_PGO=1 builds the module instrumented, runs PGO_WORKLOAD on it,
+	and builds it again with the profile and LTO (GCC only)"""
+
+	def build_extensions(self):
+		if os.environ.get("ARGON2_PGO") != "1":
+			return super().build_extensions()
+
+		profile = os.path.abspath(os.path.join(self.build_temp, "pgo-data"))
+		compile_args = {}
+		link_args = {}
+		for ext in self.extensions:
+			compile_args[ext.name] = list(ext.extra_compile_args)
+			link_args[ext.name] = list(ext.extra_link_args)
+			ext.extra_compile_args += ["-fprofile-generate=" + profile,
+				"-fprofile-update=prefer-atomic"]
+			ext.extra_link_args += ["-fprofile-generate=" + profile]
+		self.force = True
+		super().build_extensions()
+
+		module_dir = os.path.dirname(
+			os.path.abspath(self.get_ext_fullpath(self.extensions[0].name)))
+		subprocess.check_call([sys.executable, "-c", PGO_WORKLOAD],
+			env=dict(os.environ, PYTHONPATH=module_dir))
+
+		for ext in self.extensions:
+			ext.extra_compile_args = compile_args[ext.name] + [
+				"-fprofile-use=" + profile, "-fprofile-correction",
+				"-Wno-missing-profile", "-flto"]
+			ext.extra_link_args = link_args[ext.name] + ["-flto"]
+		super().build_extensions()
 
 setup(
+	cmdclass={"build_ext": build_ext_pgo},
 	ext_modules=[
 		Extension(
 			name = "argon2",  # as it would be imported
 							# may include packages/namespaces separated by `.`
 			include_dirs = ["include"],
-			sources = [
-				"src/argon2module.c",
-				"src/argon2.c", "src/core.c",
-				"src/encoding.c",
-				"src/thread.c", 
-				"src/blake2/blake2b.c",
-				"src/opt.c",
-			],
+			sources = ["src/argon2module.c"] + library_sources,
 		),
 	]
-)
\ No newline at end of file
+)
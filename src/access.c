@@ -0,0 +1,94 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "access.h"
+#include "thread.h"
+#include "blake2/blake2-impl.h"
+
+static FILE *access_file = NULL;
+
+#if !defined(ARGON2_NO_THREADS)
+static argon2_mutex_t access_mutex = ARGON2_MUTEX_INITIALIZER;
+#define ACCESS_LOCK() argon2_mutex_lock(&access_mutex)
+#define ACCESS_UNLOCK() argon2_mutex_unlock(&access_mutex)
+#else
+#define ACCESS_LOCK()
+#define ACCESS_UNLOCK()
+#endif
+
+/* Writes one frame; called with access_mutex held */
+static void access_write(const uint32_t frame[ACCESS_FRAME_WORDS]) {
+    uint8_t bytes[ACCESS_FRAME_WORDS * sizeof(uint32_t)];
+    unsigned i;
+    if (access_file == NULL) {
+        return;
+    }
+    for (i = 0; i < ACCESS_FRAME_WORDS; ++i) {
+        store32(bytes + i * sizeof(uint32_t), frame[i]);
+    }
+    fwrite(bytes, sizeof(bytes), 1, access_file);
+}
+
+void access_begin(const argon2_instance_t *instance) {
+    uint32_t frame[ACCESS_FRAME_WORDS];
+
+    frame[0] = ACCESS_HASH_MARK;
+    frame[1] = (uint32_t)instance->type;
+    frame[2] = instance->version;
+    frame[3] = instance->passes;
+    frame[4] = instance->lanes;
+    frame[5] = instance->segment_length;
+
+    ACCESS_LOCK();
+    if (access_file == NULL) {
+        const char *path = getenv("ARGON2_ACCESS_TRACE");
+        access_file = fopen(path != NULL ? path : "access.trace", "ab");
+        if (access_file == NULL) {
+            fprintf(stderr, "Error: cannot open the access trace\n");
+        }
+    }
+    access_write(frame);
+    ACCESS_UNLOCK();
+}
+
+void access_block(const argon2_instance_t *instance,
+                  const argon2_position_t *position, uint32_t ref_lane,
+                  uint32_t ref_index) {
+    uint32_t frame[ACCESS_FRAME_WORDS];
+
+    frame[0] = position->pass;
+    frame[1] = position->lane;
+    frame[2] = position->slice;
+    frame[3] = position->slice * instance->segment_length + position->index;
+    frame[4] = ref_lane;
+    frame[5] = ref_index;
+
+    ACCESS_LOCK();
+    access_write(frame);
+    ACCESS_UNLOCK();
+}
+
+void access_end(void) {
+    ACCESS_LOCK();
+    if (access_file != NULL) {
+        fflush(access_file);
+    }
+    ACCESS_UNLOCK();
+}
@@ -0,0 +1,65 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_ACCESS_H
+#define ARGON2_ACCESS_H
+
+#include "core.h"
+
+/*
+ * Reference-access trace, compiled in with -DACCESS_TRACE (make argon2-trace)
+ * and analyzed with tracestat. Every hash appends to the file named by the
+ * ARGON2_ACCESS_TRACE environment variable (access.trace by default) a header
+ * frame followed by one frame per block computed, in the order the blocks
+ * were computed. A frame is ACCESS_FRAME_WORDS little-endian 32-bit words:
+ *
+ *   header: ACCESS_HASH_MARK, type, version, passes, lanes, segment_length
+ *   block:  pass, lane, slice, index, ref_lane, ref_index
+ *
+ * where index and ref_index are positions within their lanes. The first two
+ * blocks of each lane are not computed by fill_segment and have no frame.
+ * Frames of hashes running at the same time interleave, so trace one hash at
+ * a time.
+ */
+#define ACCESS_FRAME_WORDS 6
+#define ACCESS_HASH_MARK UINT32_C(0xFFFFFFFF)
+
+#ifdef ACCESS_TRACE
+
+/*
+ * Writes the header frame of the hash described by @instance
+ * @param instance Pointer to the instance about to fill its memory
+ */
+void access_begin(const argon2_instance_t *instance);
+
+/*
+ * Writes the frame of the block at @position
+ * @param instance Pointer to the current instance
+ * @param position Position of the block computed
+ * @param ref_lane Lane of the reference block
+ * @param ref_index Index of the reference block within @ref_lane
+ */
+void access_block(const argon2_instance_t *instance,
+                  const argon2_position_t *position, uint32_t ref_lane,
+                  uint32_t ref_index);
+
+/* Flushes the frames of the hash that just filled its memory */
+void access_end(void);
+
+#endif /* ACCESS_TRACE */
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+/*
+ * Included first by argon2_amalgamated.c and argon2-node_amalgamated.c, which
+ * `make amalgamation` generates to compile all the library sources, without
+ * and with the hashing nodes, as one translation unit.
+ */
+
+#ifndef ARGON2_AMALGAMATION_H
+#define ARGON2_AMALGAMATION_H
+
+/* Tells the sources they are compiled as one translation unit */
+#define ARGON2_AMALGAMATION
+
+/* The sources set no feature-test macros of their own in the amalgamation,
+ * as they would come after the system headers of the sources before them:
+ * the union of them is set here. Elsewhere, the defaults expose everything */
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+/* The internal functions are static, for the compiler to inline them across
+ * modules. argon2.h is included here, before any source, so that its include
+ * guard keeps this definition of ARGON2_LOCAL over its own */
+#include "argon2.h"
+#undef ARGON2_LOCAL
+#define ARGON2_LOCAL static
+
+/* Not every configuration calls every internal function, which static makes
+ * a warning */
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+#endif
@@ -20,8 +20,12 @@
 #include <stdio.h>
 
 #include "argon2.h"
+#include "checkpoint.h"
 #include "encoding.h"
 #include "core.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "trace.h"
 
 const char *argon2_type2string(argon2_type type, int uppercase) {
     switch (type) {
@@ -36,11 +40,38 @@ const char *argon2_type2string(argon2_type type, int uppercase) {
     return NULL;
 }
 
-int argon2_ctx(argon2_context *context, argon2_type type) {
+/* Number of memory blocks actually used for @m_cost KiB and @lanes lanes */
+static uint32_t aligned_memory_blocks(uint32_t m_cost, uint32_t lanes) {
+    uint32_t memory_blocks, segment_length;
+
+    /* Minimum memory_blocks = 8L blocks, where L is the number of lanes */
+    memory_blocks = m_cost;
+
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * lanes;
+    }
+
+    segment_length = memory_blocks / (lanes * ARGON2_SYNC_POINTS);
+    /* Ensure that all segments have equal length */
+    return segment_length * (lanes * ARGON2_SYNC_POINTS);
+}
+
+/*
+ * Computes a hash on behalf of @ticket, or of tenant 0 if NULL, adding what
+ * it took to ticket->usage; a ticket admitted ahead by sched_submit() is left
+ * for its owner to release
+ */
+static int argon2_ctx_matrix(argon2_context *context, argon2_type type,
+                             void *matrix, size_t matrix_len,
+                             struct Argon2_checkpoint *checkpoint,
+                             argon2_sched_ticket *ticket) {
     /* 1. Validate all inputs */
     int result = validate_inputs(context);
     uint32_t memory_blocks, segment_length;
     argon2_instance_t instance;
+    argon2_sched_ticket own;
+    uint64_t cpu_started;
+    int release;
 
     if (ARGON2_OK != result) {
         return result;
@@ -51,19 +82,26 @@ int argon2_ctx(argon2_context *context, argon2_type type) {
     }
 
     /* 2. Align memory size */
-    /* Minimum memory_blocks = 8L blocks, where L is the number of lanes */
-    memory_blocks = context->m_cost;
+    memory_blocks = aligned_memory_blocks(context->m_cost, context->lanes);
+    segment_length = memory_blocks / (context->lanes * ARGON2_SYNC_POINTS);
 
-    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * context->lanes) {
-        memory_blocks = 2 * ARGON2_SYNC_POINTS * context->lanes;
+    if (matrix != NULL &&
+        (matrix_len / sizeof(block) < memory_blocks ||
+         (uintptr_t)matrix % sizeof(uint64_t) != 0)) {
+        return ARGON2_MATRIX_MISMATCH;
     }
 
-    segment_length = memory_blocks / (context->lanes * ARGON2_SYNC_POINTS);
-    /* Ensure that all segments have equal length */
-    memory_blocks = segment_length * (context->lanes * ARGON2_SYNC_POINTS);
-
     instance.version = context->version;
-    instance.memory = NULL;
+    instance.memory = (block *)matrix;
+    instance.external_memory = matrix != NULL;
+    if (context->flags & ARGON2_FLAG_LAYOUT_SEGMENT_MAJOR) {
+        instance.layout = ARGON2_LAYOUT_SEGMENT_MAJOR;
+    } else if ((context->flags & ARGON2_FLAG_LAYOUT_SPLIT_LANES) &&
+               matrix == NULL) {
+        instance.layout = ARGON2_LAYOUT_SPLIT_LANES;
+    } else {
+        instance.layout = ARGON2_LAYOUT_LANE_MAJOR;
+    }
     instance.passes = context->t_cost;
     instance.memory_blocks = memory_blocks;
     instance.segment_length = segment_length;
@@ -71,42 +109,185 @@ int argon2_ctx(argon2_context *context, argon2_type type) {
     instance.lanes = context->lanes;
     instance.threads = context->threads;
     instance.type = type;
+    instance.checkpoint = checkpoint;
+    instance.first_pass = 0;
+    instance.cpu_time = 0;
+    instance.pool_base = 0;
 
     if (instance.threads > instance.lanes) {
         instance.threads = instance.lanes;
     }
 
+    ARGON2_PROBE4(ctx__start, type, context->m_cost, context->t_cost,
+                  context->lanes);
+
+    /* Wait for admission if the hash is large enough to be throttled, or
+     * its tenant is capped */
+    if (ticket == NULL) {
+        sched_ticket(&own, 0);
+        ticket = &own;
+    }
+    release = !ticket->granted;
+    if (release) {
+        sched_admit(ticket, &instance);
+    }
+    cpu_started = metrics_cpu_time();
+
     /* 3. Initialization: Hashing inputs, allocating memory, filling first
      * blocks
      */
     result = initialize(&instance, context);
 
-    if (ARGON2_OK != result) {
-        return result;
+    /* 4. Filling memory */
+    if (ARGON2_OK == result) {
+        result = fill_memory_blocks(&instance);
     }
 
-    /* 4. Filling memory */
-    result = fill_memory_blocks(&instance);
+    /* 5. Finalization */
+    if (ARGON2_OK == result) {
+        finalize(context, &instance);
+    }
 
-    if (ARGON2_OK != result) {
+    if (checkpoint != NULL) {
+        checkpoint_end(&instance, result);
+    }
+
+    ticket->usage.cpu_time +=
+        metrics_cpu_time() - cpu_started + instance.cpu_time;
+    if (ARGON2_OK == result) {
+        if (!instance.external_memory) {
+            ticket->usage.memory += (uint64_t)memory_blocks * sizeof(block);
+        }
+        ticket->usage.blocks +=
+            (uint64_t)memory_blocks * (instance.passes - instance.first_pass);
+    }
+    if (release) {
+        sched_release(ticket);
+    }
+
+    ARGON2_PROBE2(ctx__done, type, result);
+    return result;
+}
+
+static int ctx_ticket(argon2_context *context, argon2_type type,
+                      argon2_sched_ticket *ticket, void *matrix,
+                      size_t matrix_len) {
+    uint64_t started = metrics_begin(METRICS_OP_HASH, type);
+    int result =
+        argon2_ctx_matrix(context, type, matrix, matrix_len, NULL, ticket);
+    metrics_end(METRICS_OP_HASH, type, result, started);
+    return result;
+}
+
+int argon2_ctx(argon2_context *context, argon2_type type) {
+    return ctx_ticket(context, type, NULL, NULL, 0);
+}
+
+int hash_ticket(argon2_context *context, argon2_type type,
+                argon2_sched_ticket *ticket) {
+    return ctx_ticket(context, type, ticket, NULL, 0);
+}
+
+int argon2_ctx_tenant(argon2_context *context, argon2_type type,
+                      uint32_t tenant) {
+    argon2_sched_ticket ticket;
+    sched_ticket(&ticket, tenant);
+    return ctx_ticket(context, type, &ticket, NULL, 0);
+}
+
+int argon2_ctx_cost(argon2_context *context, argon2_type type,
+                    uint32_t tenant, argon2_cost *cost) {
+    argon2_sched_ticket ticket;
+    int result;
+
+    sched_ticket(&ticket, tenant);
+    result = ctx_ticket(context, type, &ticket, NULL, 0);
+    *cost = ticket.usage;
+    return result;
+}
+
+int argon2_ctx_checkpoint(argon2_context *context, argon2_type type,
+                          const char *checkpoint) {
+    struct Argon2_checkpoint state;
+    uint64_t started;
+    int result;
+
+    if (checkpoint == NULL) {
+        return ARGON2_CHECKPOINT_FAIL;
+    }
+    state.path = checkpoint;
+    state.resume = 0;
+
+    started = metrics_begin(METRICS_OP_HASH, type);
+    result = argon2_ctx_matrix(context, type, NULL, 0, &state, NULL);
+    metrics_end(METRICS_OP_HASH, type, result, started);
+    return result;
+}
+
+int argon2_resume(const char *checkpoint, argon2_context *context) {
+    struct Argon2_checkpoint state;
+    argon2_type type;
+    uint64_t started;
+    int result;
+
+    if (checkpoint == NULL) {
+        return ARGON2_CHECKPOINT_FAIL;
+    }
+    result = checkpoint_type(checkpoint, &type);
+    if (result != ARGON2_OK) {
         return result;
     }
-    /* 5. Finalization */
-    finalize(context, &instance);
+    state.path = checkpoint;
+    state.resume = 1;
 
-    return ARGON2_OK;
+    started = metrics_begin(METRICS_OP_HASH, type);
+    result = argon2_ctx_matrix(context, type, NULL, 0, &state, NULL);
+    metrics_end(METRICS_OP_HASH, type, result, started);
+    return result;
 }
 
-int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
-                const uint32_t parallelism, const void *pwd,
-                const size_t pwdlen, const void *salt, const size_t saltlen,
-                void *hash, const size_t hashlen, char *encoded,
-                const size_t encodedlen, argon2_type type,
-                const uint32_t version){
+int argon2_ctx_with_memory(argon2_context *context, argon2_type type,
+                           void *matrix, size_t matrix_len) {
+    uint64_t started = metrics_begin(METRICS_OP_HASH, type);
+    int result = ARGON2_MATRIX_MISMATCH;
+    if (matrix != NULL) {
+        result = argon2_ctx_matrix(context, type, matrix, matrix_len, NULL,
+                                   NULL);
+    }
+    metrics_end(METRICS_OP_HASH, type, result, started);
+    return result;
+}
+
+size_t argon2_memory_required(uint32_t m_cost, uint32_t lanes) {
+    uint32_t memory_blocks;
+
+    if (lanes < ARGON2_MIN_LANES || lanes > ARGON2_MAX_LANES ||
+        m_cost < ARGON2_MIN_MEMORY || m_cost > ARGON2_MAX_MEMORY) {
+        return 0;
+    }
+
+    memory_blocks = aligned_memory_blocks(m_cost, lanes);
+    if ((size_t)memory_blocks > (size_t)-1 / sizeof(block)) {
+        return 0;
+    }
+    return (size_t)memory_blocks * sizeof(block);
+}
+
+/*
+ * Underlies argon2_hash() and argon2_hasher_hash(): the encoded hash is made
+ * from @header, if not NULL, rather than rendered in full
+ */
+static int hash_encoded(const uint32_t t_cost, const uint32_t m_cost,
+                        const uint32_t parallelism, const void *pwd,
+                        const size_t pwdlen, const void *salt,
+                        const size_t saltlen, void *hash, const size_t hashlen,
+                        char *encoded, const size_t encodedlen,
+                        argon2_type type, const uint32_t version,
+                        const char *header, size_t headerlen) {
 
     argon2_context context;
     int result;
-    uint8_t *out;
+    uint8_t *out, *out_allocated = NULL;
 
     if (pwdlen > ARGON2_MAX_PWD_LENGTH) {
         return ARGON2_PWD_TOO_LONG;
@@ -124,12 +305,21 @@ int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
         return ARGON2_OUTPUT_TOO_SHORT;
     }
 
-    out = malloc(hashlen);
-    if (!out) {
-        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    /* Produce the tag straight into the caller's buffers when possible: the
+     * raw hash buffer, or else the tail of the encoded buffer, which the
+     * Base64 encoding of the tag overtakes only after reading it. */
+    if (hash) {
+        out = (uint8_t *)hash;
+    } else if (encoded && encodedlen > hashlen) {
+        out = (uint8_t *)encoded + (encodedlen - hashlen);
+    } else {
+        out = out_allocated = malloc(hashlen);
+        if (!out) {
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
     }
 
-    context.out = (uint8_t *)out;
+    context.out = out;
     context.outlen = (uint32_t)hashlen;
     context.pwd = CONST_CAST(uint8_t *)pwd;
     context.pwdlen = (uint32_t)pwdlen;
@@ -152,30 +342,125 @@ int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
 
     if (result != ARGON2_OK) {
         clear_internal_memory(out, hashlen);
-        free(out);
+        free(out_allocated);
         return result;
     }
 
-    /* if raw hash requested, write it */
-    if (hash) {
-        memcpy(hash, out, hashlen);
-    }
-
     /* if encoding requested, write it */
     if (encoded && encodedlen) {
-        if (encode_string(encoded, encodedlen, &context, type) != ARGON2_OK) {
+        if ((header != NULL
+                 ? encode_with_header(encoded, encodedlen, header, headerlen,
+                                      &context)
+                 : encode_string(encoded, encodedlen, &context, type)) !=
+            ARGON2_OK) {
             clear_internal_memory(out, hashlen); /* wipe buffers if error */
             clear_internal_memory(encoded, encodedlen);
-            free(out);
+            free(out_allocated);
             return ARGON2_ENCODING_FAIL;
         }
     }
-    clear_internal_memory(out, hashlen);
-    free(out);
 
+    if (out_allocated) {
+        clear_internal_memory(out_allocated, hashlen);
+        free(out_allocated);
+    } else if (!hash && encoded) {
+        /* wipe what is left of the tag past the terminating zero */
+        size_t used = strlen(encoded) + 1;
+        clear_internal_memory(encoded + used, encodedlen - used);
+    }
+
+    return ARGON2_OK;
+}
+
+int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
+                const uint32_t parallelism, const void *pwd,
+                const size_t pwdlen, const void *salt, const size_t saltlen,
+                void *hash, const size_t hashlen, char *encoded,
+                const size_t encodedlen, argon2_type type,
+                const uint32_t version){
+
+    return hash_encoded(t_cost, m_cost, parallelism, pwd, pwdlen, salt,
+                        saltlen, hash, hashlen, encoded, encodedlen, type,
+                        version, NULL, 0);
+}
+
+int argon2_hasher_init(argon2_hasher *hasher, const uint32_t t_cost,
+                       const uint32_t m_cost, const uint32_t parallelism,
+                       const size_t hashlen, argon2_type type,
+                       const uint32_t version) {
+    /* validated as a hash with the shortest salt would be */
+    uint8_t salt[ARGON2_MIN_SALT_LENGTH];
+    argon2_context context;
+    int result;
+
+    if (hasher == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    if (hashlen > ARGON2_MAX_OUTLEN) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+
+    if (argon2_type2string(type, 0) == NULL) {
+        return ARGON2_INCORRECT_TYPE;
+    }
+
+    if (version != ARGON2_VERSION_10 && version != ARGON2_VERSION_13) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    memset(&context, 0, sizeof(context));
+    context.out = salt; /* not written */
+    context.outlen = (uint32_t)hashlen;
+    context.salt = salt;
+    context.saltlen = sizeof(salt);
+    context.t_cost = t_cost;
+    context.m_cost = m_cost;
+    context.lanes = parallelism;
+    context.threads = parallelism;
+    context.version = version;
+
+    result = validate_inputs(&context);
+    if (result != ARGON2_OK) {
+        return result;
+    }
+
+    result = encode_header(hasher->header, sizeof(hasher->header), &context,
+                           type);
+    if (result != ARGON2_OK) {
+        return result;
+    }
+
+    hasher->t_cost = t_cost;
+    hasher->m_cost = m_cost;
+    hasher->parallelism = parallelism;
+    hasher->hashlen = (uint32_t)hashlen;
+    hasher->type = type;
+    hasher->version = version;
+    hasher->headerlen = strlen(hasher->header);
     return ARGON2_OK;
 }
 
+int argon2_hasher_hash(const argon2_hasher *hasher, const void *pwd,
+                       const size_t pwdlen, const void *salt,
+                       const size_t saltlen, char *encoded,
+                       const size_t encodedlen) {
+    if (hasher == NULL || encoded == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    return hash_encoded(hasher->t_cost, hasher->m_cost, hasher->parallelism,
+                        pwd, pwdlen, salt, saltlen, NULL, hasher->hashlen,
+                        encoded, encodedlen, hasher->type, hasher->version,
+                        hasher->header, hasher->headerlen);
+}
+
+size_t argon2_hasher_encodedlen(const argon2_hasher *hasher,
+                                uint32_t saltlen) {
+    return hasher->headerlen + b64len(saltlen) + 1 + b64len(hasher->hashlen) +
+           1;
+}
+
 int argon2i_hash_encoded(const uint32_t t_cost, const uint32_t m_cost,
                          const uint32_t parallelism, const void *pwd,
                          const size_t pwdlen, const void *salt,
@@ -246,8 +531,25 @@ static int argon2_compare(const uint8_t *b1, const uint8_t *b2, size_t len) {
     return (int)((1 & ((d - 1) >> 8)) - 1);
 }
 
-int argon2_verify(const char *encoded, const void *pwd, const size_t pwdlen,
-                  argon2_type type) {
+static int verify_ctx(argon2_context *context, const char *hash,
+                      argon2_type type, argon2_sched_ticket *ticket,
+                      void *matrix, size_t matrix_len) {
+    int ret = ctx_ticket(context, type, ticket, matrix, matrix_len);
+    if (ret != ARGON2_OK) {
+        return ret;
+    }
+
+    if (argon2_compare((uint8_t *)hash, context->out, context->outlen)) {
+        return ARGON2_VERIFY_MISMATCH;
+    }
+
+    return ARGON2_OK;
+}
+
+static int verify_encoded(const char *encoded, const void *pwd,
+                          const size_t pwdlen, argon2_type type,
+                          argon2_sched_ticket *ticket, void *matrix,
+                          size_t matrix_len) {
 
     argon2_context ctx;
     uint8_t *desired_result = NULL;
@@ -299,7 +601,8 @@ int argon2_verify(const char *encoded, const void *pwd, const size_t pwdlen,
         goto fail;
     }
 
-    ret = argon2_verify_ctx(&ctx, (char *)desired_result, type);
+    ret = verify_ctx(&ctx, (char *)desired_result, type, ticket, matrix,
+                     matrix_len);
     if (ret != ARGON2_OK) {
         goto fail;
     }
@@ -312,6 +615,145 @@ fail:
     return ret;
 }
 
+int verify_ticket(const char *encoded, const void *pwd, const size_t pwdlen,
+                  argon2_type type, argon2_sched_ticket *ticket, void *matrix,
+                  size_t matrix_len) {
+    uint64_t started = metrics_begin(METRICS_OP_VERIFY, type);
+    int ret = verify_encoded(encoded, pwd, pwdlen, type, ticket, matrix,
+                             matrix_len);
+    metrics_end(METRICS_OP_VERIFY, type, ret, started);
+    return ret;
+}
+
+int argon2_verify(const char *encoded, const void *pwd, const size_t pwdlen,
+                  argon2_type type) {
+    return verify_ticket(encoded, pwd, pwdlen, type, NULL, NULL, 0);
+}
+
+int argon2_verify_tenant(const char *encoded, const void *pwd,
+                         const size_t pwdlen, argon2_type type,
+                         uint32_t tenant) {
+    argon2_sched_ticket ticket;
+    sched_ticket(&ticket, tenant);
+    return verify_ticket(encoded, pwd, pwdlen, type, &ticket, NULL, 0);
+}
+
+int argon2_verify_cost(const char *encoded, const void *pwd,
+                       const size_t pwdlen, argon2_type type, uint32_t tenant,
+                       argon2_cost *cost) {
+    argon2_sched_ticket ticket;
+    int result;
+
+    sched_ticket(&ticket, tenant);
+    result = verify_ticket(encoded, pwd, pwdlen, type, &ticket, NULL, 0);
+    *cost = ticket.usage;
+    return result;
+}
+
+static int verify_binary(const void *src, size_t srclen, const void *pwd,
+                         const size_t pwdlen) {
+    argon2_context ctx;
+    argon2_type type;
+    uint8_t *desired_result;
+    int ret;
+
+    if (pwdlen > ARGON2_MAX_PWD_LENGTH) {
+        return ARGON2_PWD_TOO_LONG;
+    }
+
+    if (src == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+
+    ctx.pwd = (uint8_t *)pwd;
+    ctx.pwdlen = (uint32_t)pwdlen;
+
+    /* Salt and desired result are used in place */
+    ret = decode_binary(&ctx, (const uint8_t *)src, srclen, &type);
+    if (ret != ARGON2_OK) {
+        return ret;
+    }
+
+    desired_result = ctx.out;
+    ctx.out = malloc(ctx.outlen);
+    if (!ctx.out) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+
+    ret = verify_ctx(&ctx, (char *)desired_result, type, NULL, NULL, 0);
+
+    free(ctx.out);
+    return ret;
+}
+
+int argon2_verify_binary(const void *src, size_t srclen, const void *pwd,
+                         const size_t pwdlen) {
+    argon2_type type =
+        binary_type((const uint8_t *)src, src != NULL ? srclen : 0);
+    uint64_t started = metrics_begin(METRICS_OP_VERIFY, type);
+    int ret = verify_binary(src, srclen, pwd, pwdlen);
+    metrics_end(METRICS_OP_VERIFY, type, ret, started);
+    return ret;
+}
+
+int argon2_encode_binary(void *dst, size_t *dstlen, const char *encoded,
+                         argon2_type type) {
+    argon2_context ctx;
+    size_t encoded_len;
+    int ret;
+
+    if (dst == NULL || dstlen == NULL || encoded == NULL) {
+        return ARGON2_ENCODING_FAIL;
+    }
+
+    encoded_len = strlen(encoded);
+    if (encoded_len > UINT32_MAX) {
+        return ARGON2_DECODING_FAIL;
+    }
+
+    /* No field can be longer than the encoded length */
+    ctx.saltlen = (uint32_t)encoded_len;
+    ctx.outlen = (uint32_t)encoded_len;
+    ctx.salt = malloc(ctx.saltlen);
+    ctx.out = malloc(ctx.outlen);
+    ctx.pwd = NULL;
+    ctx.pwdlen = 0;
+
+    if (!ctx.salt || !ctx.out) {
+        ret = ARGON2_MEMORY_ALLOCATION_ERROR;
+    } else if ((ret = decode_string(&ctx, encoded, type)) == ARGON2_OK) {
+        ret = encode_binary((uint8_t *)dst, dstlen, &ctx, type);
+    }
+
+    free(ctx.salt);
+    free(ctx.out);
+    return ret;
+}
+
+int argon2_decode_binary(char *encoded, size_t encodedlen, const void *src,
+                         size_t srclen, argon2_type *type) {
+    argon2_context ctx;
+    argon2_type decoded;
+    int ret;
+
+    if (encoded == NULL || src == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+
+    ctx.pwd = NULL;
+    ctx.pwdlen = 0;
+    ret = decode_binary(&ctx, (const uint8_t *)src, srclen, &decoded);
+    if (ret != ARGON2_OK) {
+        return ret;
+    }
+
+    ret = encode_string(encoded, encodedlen, &ctx, decoded);
+    if (ret == ARGON2_OK && type != NULL) {
+        *type = decoded;
+    }
+    return ret;
+}
+
 int argon2i_verify(const char *encoded, const void *pwd, const size_t pwdlen) {
 
     return argon2_verify(encoded, pwd, pwdlen, Argon2_i);
@@ -341,16 +783,10 @@ int argon2id_ctx(argon2_context *context) {
 
 int argon2_verify_ctx(argon2_context *context, const char *hash,
                       argon2_type type) {
-    int ret = argon2_ctx(context, type);
-    if (ret != ARGON2_OK) {
-        return ret;
-    }
-
-    if (argon2_compare((uint8_t *)hash, context->out, context->outlen)) {
-        return ARGON2_VERIFY_MISMATCH;
-    }
-
-    return ARGON2_OK;
+    uint64_t started = metrics_begin(METRICS_OP_VERIFY, type);
+    int ret = verify_ctx(context, hash, type, NULL, NULL, 0);
+    metrics_end(METRICS_OP_VERIFY, type, ret, started);
+    return ret;
 }
 
 int argon2d_verify_ctx(argon2_context *context, const char *hash) {
@@ -439,6 +875,18 @@ const char *argon2_error_message(int error_code) {
         return "Some of encoded parameters are too long or too short";
     case ARGON2_VERIFY_MISMATCH:
         return "The password does not match the supplied hash";
+    case ARGON2_MATRIX_MISMATCH:
+        return "Memory matrix is NULL, too small or misaligned";
+    case ARGON2_PRESSURE_UNAVAILABLE:
+        return "Memory pressure information is unavailable";
+    case ARGON2_CHECKPOINT_FAIL:
+        return "Checkpoint file cannot be read or written";
+    case ARGON2_CHECKPOINT_MISMATCH:
+        return "Checkpoint file does not match the inputs";
+    case ARGON2_NETWORK_FAIL:
+        return "Network endpoint cannot be set up";
+    case ARGON2_NODE_TIMEOUT:
+        return "No hashing node answered in time";
     default:
         return "Unknown error code";
     }
@@ -450,3 +898,9 @@ size_t argon2_encodedlen(uint32_t t_cost, uint32_t m_cost, uint32_t parallelism,
          numlen(t_cost) + numlen(m_cost) + numlen(parallelism) +
          b64len(saltlen) + b64len(hashlen) + numlen(ARGON2_VERSION_NUMBER) + 1;
 }
+
+size_t argon2_binarylen(uint32_t t_cost, uint32_t m_cost, uint32_t parallelism,
+                        uint32_t saltlen, uint32_t hashlen) {
+  return 1 + varintlen(m_cost) + varintlen(t_cost) + varintlen(parallelism) +
+         varintlen(saltlen) + saltlen + hashlen;
+}
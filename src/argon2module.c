@@ -5,9 +5,6 @@
 // Include the main Argon2 header file.
 #include "argon2.h"
 
-// Library includes
-#include "encoding.h"
-
 // STL includes
 #include <string.h>
 #include <math.h>
@@ -88,7 +85,7 @@ argon2_ihash_encoded (PyObject *self, PyObject *args, PyObject *kwargs) {
 		return NULL;
 	}
 	// Allocate memory for the hash
-	size_t encodedlen = 16 + numlen((uint32_t) memcost) + 3 + numlen((uint32_t) iterations) + 3 + numlen((uint32_t) parallelism) + 1 + b64len((uint32_t) saltlen) + 1 + b64len((uint32_t) hashlen) + 2;
+	size_t encodedlen = argon2_encodedlen((uint32_t) iterations, (uint32_t) memcost, (uint32_t) parallelism, (uint32_t) saltlen, (uint32_t) hashlen, Argon2_i);
 	encoded = malloc(encodedlen);
 	if (encoded == NULL) {
 		PyErr_SetString(PyExc_MemoryError, "Could not allocate memory for the encoded hash.");
@@ -177,7 +174,7 @@ argon2_dhash_encoded (PyObject *self, PyObject *args, PyObject *kwargs) {
 		return NULL;
 	}
 	// Allocate memory for the hash
-	size_t encodedlen = 16 + numlen((uint32_t) memcost) + 3 + numlen((uint32_t) iterations) + 3 + numlen((uint32_t) parallelism) + 1 + b64len((uint32_t) saltlen) + 1 + b64len((uint32_t) hashlen) + 2;
+	size_t encodedlen = argon2_encodedlen((uint32_t) iterations, (uint32_t) memcost, (uint32_t) parallelism, (uint32_t) saltlen, (uint32_t) hashlen, Argon2_d);
 	encoded = malloc(encodedlen);
 	if (encoded == NULL) {
 		PyErr_SetString(PyExc_MemoryError, "Could not allocate memory for the encoded hash.");
@@ -265,7 +262,7 @@ argon2_idhash_encoded (PyObject *self, PyObject *args, PyObject *kwargs) {
 		return NULL;
 	}
 	// Allocate memory for the hash
-	size_t encodedlen = 16 + numlen((uint32_t) memcost) + 3 + numlen((uint32_t) iterations) + 3 + numlen((uint32_t) parallelism) + 1 + b64len((uint32_t) saltlen) + 1 + b64len((uint32_t) hashlen) + 2;
+	size_t encodedlen = argon2_encodedlen((uint32_t) iterations, (uint32_t) memcost, (uint32_t) parallelism, (uint32_t) saltlen, (uint32_t) hashlen, Argon2_id);
 	encoded = malloc(encodedlen);
 	if (encoded == NULL) {
 		PyErr_SetString(PyExc_MemoryError, "Could not allocate memory for the encoded hash.");
@@ -95,9 +95,12 @@ static void benchmark() {
                 mcycles = (double)(stop_cycles - start_cycles) / (1UL << 20);
                 run_time += ((double)stop_time - start_time) / (CLOCKS_PER_SEC);
 
-                printf("%s %d iterations  %d MiB %d threads:  %2.2f cpb %2.2f "
-                       "Mcycles \n", argon2_type2string(type, 1), t_cost,
-                       m_cost >> 10, thread_n, (float)delta / 1024, mcycles);
+                printf("%s %d iterations  %d MiB %d threads %s:  %2.2f cpb "
+                       "%2.2f Mcycles \n", argon2_type2string(type, 1), t_cost,
+                       m_cost >> 10, thread_n,
+                       argon2_placement2string(
+                           argon2_placement_for(m_cost, thread_n)),
+                       (float)delta / 1024, mcycles);
             }
 
             printf("%2.4f seconds\n\n", run_time);
@@ -105,7 +108,86 @@ static void benchmark() {
     }
 }
 
-int main() {
+/*
+ * A short mix of what servers run: small to large m_cost, one to four lanes,
+ * all three types, and the encoding and verification paths. Trains the
+ * profile of `make pgo`, and compares builds in a few seconds.
+ */
+static void workload(void) {
+    static const struct {
+        uint32_t t_cost, m_cost, lanes, repeat;
+    } cases[] = {{3, 1 << 6, 1, 200}, {3, 1 << 10, 1, 40}, {2, 1 << 12, 2, 20},
+                 {2, 1 << 14, 4, 6},  {1, 1 << 16, 2, 2}};
+    argon2_type types[3] = {Argon2_i, Argon2_d, Argon2_id};
+    const char *pwd = "password";
+    unsigned char salt[16];
+    char encoded[128];
+    double total = 0;
+    unsigned i, j, k;
+
+    memset(salt, 1, sizeof(salt));
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        for (j = 0; j < 3; ++j) {
+            clock_t start_time = clock();
+            double run_time;
+            int ret = ARGON2_OK;
+
+            for (k = 0; k < cases[i].repeat && ret == ARGON2_OK; ++k) {
+                ret = argon2_hash(cases[i].t_cost, cases[i].m_cost,
+                                  cases[i].lanes, pwd, strlen(pwd), salt,
+                                  sizeof(salt), NULL, 32, encoded,
+                                  sizeof(encoded), types[j],
+                                  ARGON2_VERSION_NUMBER);
+                if (ret == ARGON2_OK) {
+                    ret = argon2_verify(encoded, pwd, strlen(pwd), types[j]);
+                }
+            }
+            if (ret != ARGON2_OK) {
+                printf("%s\n", argon2_error_message(ret));
+                exit(1);
+            }
+
+            run_time = ((double)clock() - start_time) / CLOCKS_PER_SEC;
+            total += run_time;
+            printf("%-8s t=%u m=%6u KiB p=%u: %8.3f ms per hash and verify\n",
+                   argon2_type2string(types[j], 1), cases[i].t_cost,
+                   cases[i].m_cost, cases[i].lanes,
+                   run_time * 1000 / cases[i].repeat);
+        }
+    }
+
+    printf("%2.4f seconds\n", total);
+}
+
+static void usage(const char *cmd) {
+    printf("Usage:  %s [auto|pack|spread|workload]\n", cmd);
+    printf("\tauto|pack|spread  lane placement policy (default auto)\n");
+    printf("\tworkload          short mixed workload, as profiled by make pgo\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "workload")) {
+        workload();
+        return ARGON2_OK;
+    }
+    if (argc > 1) {
+        argon2_placement placement;
+        if (!strcmp(argv[1], "auto")) {
+            placement = ARGON2_PLACEMENT_AUTO;
+        } else if (!strcmp(argv[1], "pack")) {
+            placement = ARGON2_PLACEMENT_PACK;
+        } else if (!strcmp(argv[1], "spread")) {
+            placement = ARGON2_PLACEMENT_SPREAD;
+        } else {
+            usage(argv[0]);
+            return ARGON2_INCORRECT_PARAMETER;
+        }
+        if (argon2_set_placement(placement) != ARGON2_OK) {
+            printf("Lane placement is not supported by this build\n");
+            return ARGON2_THREAD_FAIL;
+        }
+    }
     benchmark();
     return ARGON2_OK;
 }
@@ -0,0 +1,581 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#if !defined(_WIN32)
+#if defined(ARGON2_AMALGAMATION)
+/* feature-test macros are set by amalgamation.h */
+#elif defined(__linux__)
+/* for ftruncate(), fsync() and posix_madvise() */
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "checkpoint.h"
+#include "core.h"
+#include "metrics.h"
+#include "thread.h"
+#include "blake2/blake2.h"
+#include "blake2/blake2-impl.h"
+
+#define CHECKPOINT_MAGIC "ARGON2CP"
+#define CHECKPOINT_FORMAT 1
+#define CHECKPOINT_TMP_SUFFIX ".tmp"
+/* Saves take at most about 1/CHECKPOINT_SPACING of the time */
+#define CHECKPOINT_SPACING 4
+
+enum checkpoint_layout {
+    /* magic, then the little-endian 32-bit fields below */
+    CHECKPOINT_HEADER_LENGTH = 64,
+    CHECKPOINT_TAG_LENGTH = 64,
+    CHECKPOINT_DATA_OFFSET = CHECKPOINT_HEADER_LENGTH + CHECKPOINT_TAG_LENGTH,
+    /* keystream bytes from one BLAKE2b call */
+    CHECKPOINT_STREAM_CHUNK = 64
+};
+
+enum checkpoint_field {
+    CHECKPOINT_FIELD_FORMAT,
+    CHECKPOINT_FIELD_TYPE,
+    CHECKPOINT_FIELD_VERSION,
+    CHECKPOINT_FIELD_LANES,
+    CHECKPOINT_FIELD_LANE_LENGTH,
+    CHECKPOINT_FIELD_PASSES,
+    CHECKPOINT_FIELD_COMPLETED, /* passes the saved matrix went through */
+    CHECKPOINT_FIELDS
+};
+
+/* Domain separation bytes, absorbed right after the key */
+enum checkpoint_domain {
+    CHECKPOINT_DOMAIN_STREAM = 1,
+    CHECKPOINT_DOMAIN_LANE_TAG = 2,
+    CHECKPOINT_DOMAIN_TAG = 3
+};
+
+/* A checkpoint file mapped in memory */
+typedef struct checkpoint_file {
+    uint8_t *data;
+    size_t size;
+#if defined(_WIN32)
+    HANDLE file, mapping;
+#else
+    int fd;
+#endif
+} checkpoint_file;
+
+/* The lanes one thread encrypts (or decrypts) and authenticates */
+typedef struct checkpoint_task {
+    const argon2_instance_t *instance;
+    const struct Argon2_checkpoint *checkpoint;
+    uint8_t *data;     /* ciphertext of the whole matrix */
+    uint8_t *tags;     /* CHECKPOINT_TAG_LENGTH bytes per lane */
+    uint32_t completed;
+    uint32_t lane, lane_step;
+    int open;          /* decrypt into the matrix rather than encrypt it */
+} checkpoint_task;
+
+/***************File mapping*****************/
+
+/*
+ * Maps a checkpoint file, creating it with @size bytes if @create is set
+ * @return 0 on success
+ */
+static int checkpoint_map(checkpoint_file *file, const char *path,
+                          size_t size, int create) {
+#if defined(_WIN32)
+    DWORD access = create ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    LARGE_INTEGER length;
+
+    file->data = NULL;
+    file->mapping = NULL;
+    file->file = CreateFileA(path, access, 0, NULL,
+                             create ? CREATE_ALWAYS : OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    if (!create) {
+        if (!GetFileSizeEx(file->file, &length)) {
+            return -1;
+        }
+        size = (size_t)length.QuadPart;
+    }
+    file->size = size;
+    if (size < CHECKPOINT_DATA_OFFSET) {
+        return -1;
+    }
+    file->mapping = CreateFileMappingA(
+        file->file, NULL, create ? PAGE_READWRITE : PAGE_READONLY,
+        (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+    if (file->mapping == NULL) {
+        return -1;
+    }
+    file->data = MapViewOfFile(file->mapping,
+                               create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0,
+                               size);
+    return file->data != NULL ? 0 : -1;
+#else
+    struct stat st;
+    void *map;
+
+    file->data = NULL;
+    file->fd = create ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0600)
+                      : open(path, O_RDONLY);
+    if (file->fd < 0) {
+        return -1;
+    }
+    if (create) {
+        if (ftruncate(file->fd, (off_t)size) != 0) {
+            return -1;
+        }
+    } else {
+        if (fstat(file->fd, &st) != 0) {
+            return -1;
+        }
+        size = (size_t)st.st_size;
+    }
+    file->size = size;
+    if (size < CHECKPOINT_DATA_OFFSET) {
+        return -1;
+    }
+    map = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+               MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    file->data = (uint8_t *)map;
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+    return 0;
+#endif
+}
+
+/* Writes a mapped file through to the disk, returns 0 on success */
+static int checkpoint_sync(checkpoint_file *file) {
+#if defined(_WIN32)
+    return FlushViewOfFile(file->data, file->size) &&
+                   FlushFileBuffers(file->file)
+               ? 0
+               : -1;
+#else
+    return msync(file->data, file->size, MS_SYNC) == 0 && fsync(file->fd) == 0
+               ? 0
+               : -1;
+#endif
+}
+
+static void checkpoint_unmap(checkpoint_file *file) {
+#if defined(_WIN32)
+    if (file->data != NULL) {
+        UnmapViewOfFile(file->data);
+    }
+    if (file->mapping != NULL) {
+        CloseHandle(file->mapping);
+    }
+    if (file->file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file->file);
+    }
+#else
+    if (file->data != NULL) {
+        munmap(file->data, file->size);
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+#endif
+}
+
+/* Replaces @path by @tmp, returns 0 on success */
+static int checkpoint_replace(const char *tmp, const char *path) {
+#if defined(_WIN32)
+    return MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(tmp, path);
+#endif
+}
+
+/***************Sealing*****************/
+
+static void checkpoint_header(uint8_t *header, const argon2_instance_t *instance,
+                              uint32_t completed) {
+    uint32_t fields[CHECKPOINT_FIELDS];
+    int i;
+
+    fields[CHECKPOINT_FIELD_FORMAT] = CHECKPOINT_FORMAT;
+    fields[CHECKPOINT_FIELD_TYPE] = (uint32_t)instance->type;
+    fields[CHECKPOINT_FIELD_VERSION] = instance->version;
+    fields[CHECKPOINT_FIELD_LANES] = instance->lanes;
+    fields[CHECKPOINT_FIELD_LANE_LENGTH] = instance->lane_length;
+    fields[CHECKPOINT_FIELD_PASSES] = instance->passes;
+    fields[CHECKPOINT_FIELD_COMPLETED] = completed;
+
+    memset(header, 0, CHECKPOINT_HEADER_LENGTH);
+    memcpy(header, CHECKPOINT_MAGIC, 8);
+    for (i = 0; i < CHECKPOINT_FIELDS; ++i) {
+        store32(header + 8 + 4 * i, fields[i]);
+    }
+}
+
+static uint32_t checkpoint_field(const uint8_t *header, int field) {
+    return load32(header + 8 + 4 * field);
+}
+
+/*
+ * Starts a keyed BLAKE2b computation. The domain byte is absorbed right
+ * away so that the key block gets compressed once here, rather than again
+ * in every copy of the state.
+ */
+static void checkpoint_keyed(blake2b_state *state, size_t outlen,
+                             const uint8_t *key, uint8_t domain) {
+    blake2b_init_key(state, outlen, key, ARGON2_PREHASH_DIGEST_LENGTH);
+    blake2b_update(state, &domain, 1);
+}
+
+/*
+ * Encrypts or decrypts one block in place: XORs it with the keystream
+ * BLAKE2b(encryption key, domain || completed || block number || chunk)
+ * @param stream BLAKE2b state from checkpoint_keyed()
+ * @param completed Passes of the saved matrix, so that every checkpoint
+ * of a hash has its own keystream
+ * @param number Logical number of the block, lane * lane_length + index
+ */
+static void checkpoint_crypt(uint8_t *data, const blake2b_state *stream,
+                             uint32_t completed, uint32_t number) {
+    uint8_t nonce[9], keystream[CHECKPOINT_STREAM_CHUNK];
+    blake2b_state state;
+    unsigned chunk, i;
+
+    store32(nonce, completed);
+    store32(nonce + 4, number);
+    for (chunk = 0; chunk < ARGON2_BLOCK_SIZE / CHECKPOINT_STREAM_CHUNK;
+         ++chunk) {
+        nonce[8] = (uint8_t)chunk;
+        state = *stream;
+        blake2b_update(&state, nonce, sizeof(nonce));
+        blake2b_final(&state, keystream, sizeof(keystream));
+        for (i = 0; i < CHECKPOINT_STREAM_CHUNK; ++i) {
+            data[chunk * CHECKPOINT_STREAM_CHUNK + i] ^= keystream[i];
+        }
+    }
+    clear_internal_memory(keystream, sizeof(keystream));
+}
+
+/* Encrypts or decrypts the lanes of @task, and computes their tags over the
+ * ciphertext */
+static void checkpoint_lanes(checkpoint_task *task) {
+    const argon2_instance_t *instance = task->instance;
+    uint8_t bytes[ARGON2_BLOCK_SIZE], lane_number[4];
+    blake2b_state stream, mac;
+    uint32_t lane, index, i;
+
+    checkpoint_keyed(&stream, CHECKPOINT_STREAM_CHUNK,
+                     task->checkpoint->encryption_key,
+                     CHECKPOINT_DOMAIN_STREAM);
+    for (lane = task->lane; lane < instance->lanes; lane += task->lane_step) {
+        uint32_t first = lane * instance->lane_length;
+        checkpoint_keyed(&mac, CHECKPOINT_TAG_LENGTH,
+                         task->checkpoint->authentication_key,
+                         CHECKPOINT_DOMAIN_LANE_TAG);
+        store32(lane_number, lane);
+        blake2b_update(&mac, lane_number, sizeof(lane_number));
+        for (index = 0; index < instance->lane_length; ++index) {
+            uint8_t *cipher = task->data + (size_t)(first + index) *
+                                               ARGON2_BLOCK_SIZE;
+            block *plain = block_at(instance, lane, index);
+            if (task->open) {
+                blake2b_update(&mac, cipher, ARGON2_BLOCK_SIZE);
+                memcpy(bytes, cipher, ARGON2_BLOCK_SIZE);
+                checkpoint_crypt(bytes, &stream, task->completed,
+                                 first + index);
+                for (i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i) {
+                    plain->v[i] = load64(bytes + 8 * i);
+                }
+            } else {
+                for (i = 0; i < ARGON2_QWORDS_IN_BLOCK; ++i) {
+                    store64(bytes + 8 * i, plain->v[i]);
+                }
+                checkpoint_crypt(bytes, &stream, task->completed,
+                                 first + index);
+                memcpy(cipher, bytes, ARGON2_BLOCK_SIZE);
+                blake2b_update(&mac, cipher, ARGON2_BLOCK_SIZE);
+            }
+        }
+        blake2b_final(&mac, task->tags + (size_t)lane * CHECKPOINT_TAG_LENGTH,
+                      CHECKPOINT_TAG_LENGTH);
+    }
+    clear_internal_memory(bytes, sizeof(bytes));
+    clear_internal_memory(&stream, sizeof(stream));
+}
+
+#if !defined(ARGON2_NO_THREADS)
+#ifdef _WIN32
+static unsigned __stdcall checkpoint_worker(void *arg)
+#else
+static void *checkpoint_worker(void *arg)
+#endif
+{
+    checkpoint_lanes((checkpoint_task *)arg);
+    return 0;
+}
+#endif
+
+/*
+ * Encrypts the matrix into @data, or decrypts @data into it, on up to
+ * instance->threads threads, one lane at a time each
+ * @param tag Where to store the tag over @header and the lane tags
+ * @return ARGON2_OK or ARGON2_MEMORY_ALLOCATION_ERROR
+ */
+static int checkpoint_run(const argon2_instance_t *instance, uint8_t *data,
+                          const uint8_t *header, uint32_t completed, int open,
+                          uint8_t *tag) {
+#if !defined(ARGON2_NO_THREADS)
+    uint32_t threads = instance->threads, t;
+#else
+    uint32_t threads = 1, t;
+#endif
+    checkpoint_task *tasks = calloc(threads, sizeof(checkpoint_task));
+    uint8_t *tags = malloc((size_t)instance->lanes * CHECKPOINT_TAG_LENGTH);
+    blake2b_state mac;
+#if !defined(ARGON2_NO_THREADS)
+    argon2_thread_handle_t *handles =
+        calloc(threads, sizeof(argon2_thread_handle_t));
+    int *started = calloc(threads, sizeof(int));
+#endif
+
+    if (tasks == NULL || tags == NULL
+#if !defined(ARGON2_NO_THREADS)
+        || handles == NULL || started == NULL
+#endif
+    ) {
+        free(tasks);
+        free(tags);
+#if !defined(ARGON2_NO_THREADS)
+        free(handles);
+        free(started);
+#endif
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+
+    for (t = 0; t < threads; ++t) {
+        tasks[t].instance = instance;
+        tasks[t].checkpoint = instance->checkpoint;
+        tasks[t].data = data;
+        tasks[t].tags = tags;
+        tasks[t].completed = completed;
+        tasks[t].lane = t;
+        tasks[t].lane_step = threads;
+        tasks[t].open = open;
+    }
+#if !defined(ARGON2_NO_THREADS)
+    for (t = 1; t < threads; ++t) {
+        started[t] = argon2_thread_create(&handles[t], &checkpoint_worker,
+                                          &tasks[t]) == 0;
+    }
+#endif
+    checkpoint_lanes(&tasks[0]);
+#if !defined(ARGON2_NO_THREADS)
+    for (t = 1; t < threads; ++t) {
+        if (started[t]) {
+            argon2_thread_join(handles[t]);
+        } else {
+            /* no thread for these lanes: do them here */
+            checkpoint_lanes(&tasks[t]);
+        }
+    }
+    free(handles);
+    free(started);
+#endif
+
+    checkpoint_keyed(&mac, CHECKPOINT_TAG_LENGTH,
+                     instance->checkpoint->authentication_key,
+                     CHECKPOINT_DOMAIN_TAG);
+    blake2b_update(&mac, header, CHECKPOINT_HEADER_LENGTH);
+    blake2b_update(&mac, tags, (size_t)instance->lanes * CHECKPOINT_TAG_LENGTH);
+    blake2b_final(&mac, tag, CHECKPOINT_TAG_LENGTH);
+
+    free(tasks);
+    free(tags);
+    return ARGON2_OK;
+}
+
+/* Compares two tags in constant time, returns 0 if they are equal */
+static int checkpoint_compare(const uint8_t *a, const uint8_t *b) {
+    uint8_t diff = 0;
+    unsigned i;
+    for (i = 0; i < CHECKPOINT_TAG_LENGTH; ++i) {
+        diff |= (uint8_t)(a[i] ^ b[i]);
+    }
+    return diff != 0;
+}
+
+static size_t checkpoint_size(const argon2_instance_t *instance) {
+    return CHECKPOINT_DATA_OFFSET +
+           (size_t)instance->memory_blocks * ARGON2_BLOCK_SIZE;
+}
+
+/* Derives both keys from H_0 */
+static void checkpoint_keys(struct Argon2_checkpoint *checkpoint,
+                            const uint8_t *prehash) {
+    static const char encryption[] = "argon2 checkpoint encryption";
+    static const char authentication[] = "argon2 checkpoint authentication";
+
+    blake2b(checkpoint->encryption_key, ARGON2_PREHASH_DIGEST_LENGTH,
+            encryption, sizeof(encryption) - 1, prehash,
+            ARGON2_PREHASH_DIGEST_LENGTH);
+    blake2b(checkpoint->authentication_key, ARGON2_PREHASH_DIGEST_LENGTH,
+            authentication, sizeof(authentication) - 1, prehash,
+            ARGON2_PREHASH_DIGEST_LENGTH);
+}
+
+/***************Checkpoints*****************/
+
+int checkpoint_type(const char *path, argon2_type *type) {
+    uint8_t header[CHECKPOINT_HEADER_LENGTH];
+    FILE *file = fopen(path, "rb");
+    size_t got;
+
+    if (file == NULL) {
+        return ARGON2_CHECKPOINT_FAIL;
+    }
+    got = fread(header, 1, sizeof(header), file);
+    fclose(file);
+    if (got != sizeof(header) ||
+        memcmp(header, CHECKPOINT_MAGIC, 8) != 0 ||
+        checkpoint_field(header, CHECKPOINT_FIELD_FORMAT) !=
+            CHECKPOINT_FORMAT) {
+        return ARGON2_CHECKPOINT_FAIL;
+    }
+    *type = (argon2_type)checkpoint_field(header, CHECKPOINT_FIELD_TYPE);
+    return ARGON2_OK;
+}
+
+int checkpoint_begin(argon2_instance_t *instance, const uint8_t *prehash) {
+    struct Argon2_checkpoint *checkpoint = instance->checkpoint;
+    uint8_t expected[CHECKPOINT_HEADER_LENGTH], tag[CHECKPOINT_TAG_LENGTH];
+    checkpoint_file file;
+    uint32_t completed, n;
+    int result;
+
+    instance->first_pass = 0;
+    checkpoint->saved_at = 0;
+    checkpoint->save_time = 0;
+    checkpoint_keys(checkpoint, prehash);
+    if (!checkpoint->resume) {
+        return ARGON2_OK;
+    }
+
+    if (checkpoint_map(&file, checkpoint->path, 0, 0) != 0) {
+        checkpoint_unmap(&file);
+        return ARGON2_CHECKPOINT_FAIL;
+    }
+    completed = checkpoint_field(file.data, CHECKPOINT_FIELD_COMPLETED);
+    checkpoint_header(expected, instance, completed);
+    if (file.size != checkpoint_size(instance) ||
+        memcmp(file.data, expected, CHECKPOINT_HEADER_LENGTH) != 0 ||
+        completed == 0 || completed >= instance->passes) {
+        checkpoint_unmap(&file);
+        return ARGON2_CHECKPOINT_MISMATCH;
+    }
+
+    result = checkpoint_run(instance, file.data + CHECKPOINT_DATA_OFFSET,
+                            file.data, completed, 1, tag);
+    if (result == ARGON2_OK) {
+        if (checkpoint_compare(tag, file.data + CHECKPOINT_HEADER_LENGTH) ==
+            0) {
+            instance->first_pass = completed;
+        } else {
+            /* Other inputs, or a damaged file: nothing of it may be used */
+            for (n = 0; n < instance->memory_blocks; ++n) {
+                clear_internal_memory(
+                    block_at(instance, n / instance->lane_length,
+                             n % instance->lane_length),
+                    sizeof(block));
+            }
+            result = ARGON2_CHECKPOINT_MISMATCH;
+        }
+    }
+    checkpoint_unmap(&file);
+    return result;
+}
+
+int checkpoint_save(const argon2_instance_t *instance, uint32_t completed) {
+    struct Argon2_checkpoint *checkpoint = instance->checkpoint;
+    uint64_t started = metrics_now();
+    size_t pathlen;
+    char *tmp;
+    checkpoint_file file;
+    int result = ARGON2_CHECKPOINT_FAIL;
+
+    if (checkpoint->save_time != 0 &&
+        started - checkpoint->saved_at <
+            CHECKPOINT_SPACING * checkpoint->save_time) {
+        return ARGON2_OK;
+    }
+
+    pathlen = strlen(checkpoint->path);
+    tmp = malloc(pathlen + sizeof(CHECKPOINT_TMP_SUFFIX));
+    if (tmp == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    memcpy(tmp, checkpoint->path, pathlen);
+    memcpy(tmp + pathlen, CHECKPOINT_TMP_SUFFIX, sizeof(CHECKPOINT_TMP_SUFFIX));
+
+    /* Written through a shared mapping in one sequential sweep per lane */
+    if (checkpoint_map(&file, tmp, checkpoint_size(instance), 1) == 0) {
+        checkpoint_header(file.data, instance, completed);
+        result = checkpoint_run(instance, file.data + CHECKPOINT_DATA_OFFSET,
+                                file.data, completed, 0,
+                                file.data + CHECKPOINT_HEADER_LENGTH);
+        if (result == ARGON2_OK && checkpoint_sync(&file) != 0) {
+            result = ARGON2_CHECKPOINT_FAIL;
+        }
+    }
+    checkpoint_unmap(&file);
+    if (result == ARGON2_OK && checkpoint_replace(tmp, checkpoint->path) != 0) {
+        result = ARGON2_CHECKPOINT_FAIL;
+    }
+    if (result != ARGON2_OK) {
+        remove(tmp);
+    }
+    free(tmp);
+    checkpoint->saved_at = metrics_now();
+    checkpoint->save_time = checkpoint->saved_at - started + 1;
+    return result;
+}
+
+void checkpoint_end(argon2_instance_t *instance, int result) {
+    struct Argon2_checkpoint *checkpoint = instance->checkpoint;
+
+    /* A failed hash keeps its last checkpoint to resume from */
+    if (result == ARGON2_OK) {
+        remove(checkpoint->path);
+    }
+    clear_internal_memory(checkpoint->encryption_key,
+                          sizeof(checkpoint->encryption_key));
+    clear_internal_memory(checkpoint->authentication_key,
+                          sizeof(checkpoint->authentication_key));
+}
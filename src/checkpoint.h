@@ -0,0 +1,76 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_CHECKPOINT_H
+#define ARGON2_CHECKPOINT_H
+
+#include "core.h"
+
+/*
+ * Checkpoint file of a hash, see argon2_ctx_checkpoint(). The file holds a
+ * header, a tag, and the matrix in logical block order, encrypted with a
+ * keystream of keyed BLAKE2b, then authenticated with keyed BLAKE2b over
+ * the header and ciphertext. Both keys derive from H_0, so only the same
+ * inputs can read a checkpoint back. It is written to a temporary file that
+ * is renamed over the previous checkpoint, so a crash while saving leaves
+ * the previous one intact.
+ *
+ * Saving costs about as much as hashing the matrix with BLAKE2b, which can
+ * exceed the time of a pass, so a pass boundary is skipped when the time
+ * since the last save is under CHECKPOINT_SPACING times its duration.
+ */
+struct Argon2_checkpoint {
+    const char *path;
+    int resume; /* whether to start from the file rather than from scratch */
+    uint64_t saved_at;  /* when the last save ended, see metrics_now() */
+    uint64_t save_time; /* how long it took, in microseconds */
+    uint8_t encryption_key[ARGON2_PREHASH_DIGEST_LENGTH];
+    uint8_t authentication_key[ARGON2_PREHASH_DIGEST_LENGTH];
+};
+
+/*
+ * Reads the Argon2 type recorded in a checkpoint file
+ * @param path Checkpoint file
+ * @param type Where to store the type
+ * @return ARGON2_OK, or ARGON2_CHECKPOINT_FAIL if the file cannot be read or
+ * is not a checkpoint
+ */
+ARGON2_LOCAL int checkpoint_type(const char *path, argon2_type *type);
+
+/*
+ * Derives the checkpoint keys and, when resuming, fills the matrix from the
+ * file and sets @instance->first_pass
+ * @param instance Current instance, with its matrix allocated
+ * @param prehash H_0
+ * @return ARGON2_OK, ARGON2_CHECKPOINT_FAIL if the file cannot be read, or
+ * ARGON2_CHECKPOINT_MISMATCH if it was not made with these inputs
+ */
+ARGON2_LOCAL int checkpoint_begin(argon2_instance_t *instance,
+                                  const uint8_t *prehash);
+
+/*
+ * Saves the matrix after pass @completed, unless the last save is too
+ * recent
+ * @return ARGON2_OK or ARGON2_CHECKPOINT_FAIL
+ */
+ARGON2_LOCAL int checkpoint_save(const argon2_instance_t *instance,
+                                 uint32_t completed);
+
+/* Removes the checkpoint file of a completed hash and wipes the keys */
+ARGON2_LOCAL void checkpoint_end(argon2_instance_t *instance, int result);
+
+#endif
@@ -0,0 +1,703 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2-node.h"
+#include "wire.h"
+
+#if defined(ARGON2_WIRE)
+
+#include "core.h"
+#include "metrics.h"
+#include "thread.h"
+#include "blake2/blake2-impl.h"
+
+/* Timeout of requests unless configured */
+#define CLIENT_TIMEOUT_MS 10000
+/* Time a node that failed is skipped for, unless every node failed */
+#define CLIENT_DOWN_MS 1000
+/* Pause between attempts while no node can be reached */
+#define CLIENT_RETRY_MS 100
+
+struct client_conn;
+
+/* A call of argon2_client_verify/hash, waiting on its caller's thread */
+typedef struct client_call {
+    argon2_cond_t cond;          /* signaled when done or a copy was lost */
+    int done;
+    int result;
+    char *encoded;               /* where the encoded hash of WIRE_HASH goes */
+    size_t encodedlen;
+    uint8_t *frame;              /* the request, its id set for each copy */
+    size_t frame_len;
+    uint32_t copies;             /* copies sent and not answered */
+    struct client_pending *pending;
+} client_call;
+
+/* A copy of a call sent on a connection, until its response or the end of
+ * the connection. A copy whose call returned (answered by another copy, or
+ * timed out) stays to keep the load of its node right. */
+typedef struct client_pending {
+    uint32_t id;
+    client_call *call; /* NULL once the call returned */
+    struct client_conn *conn;
+    struct client_pending *conn_next, *call_next;
+} client_pending;
+
+typedef struct client_conn {
+    struct Argon2_client *client;
+    struct client_node *node;
+    int fd;
+    int broken;        /* failed, waiting for its reader to end */
+    int reading;       /* whether the reader thread still runs */
+    uint32_t senders;  /* threads about to send on it */
+    uint32_t outstanding;
+    client_pending *pending;
+    argon2_mutex_t write_mutex;
+    argon2_thread_handle_t reader;
+    struct client_conn *next; /* in its node, or in the dead list */
+} client_conn;
+
+typedef struct client_node {
+    char *host;
+    char *port;
+    uint32_t outstanding; /* copies sent to it and not answered */
+    uint32_t conn_count;  /* connections open, or being opened */
+    uint64_t down_until;  /* skipped until then after a failure */
+    client_conn *conns;
+} client_node;
+
+struct Argon2_client {
+    client_node *nodes;
+    size_t node_count;
+    uint32_t connections;
+    uint32_t timeout_ms;
+    uint32_t hedge_ms;
+    uint32_t next_id;
+    size_t next_node; /* where ties between nodes start being broken */
+    client_conn *dead; /* failed connections to reap */
+    argon2_client_stats stats;
+    argon2_mutex_t mutex;
+};
+
+/* Ends @conn: its copies are lost, and its node skipped for a while. Called
+ * with client->mutex held. */
+static void client_fail(argon2_client *client, client_conn *conn) {
+    client_node *node = conn->node;
+    client_conn **link;
+    client_pending *p, *next, **call_link;
+
+    if (conn->broken) {
+        return;
+    }
+    conn->broken = 1;
+    wire_shutdown(conn->fd);
+    node->down_until = metrics_now() + (uint64_t)CLIENT_DOWN_MS * 1000;
+
+    for (link = &node->conns; *link != conn; link = &(*link)->next) {
+    }
+    *link = conn->next;
+    --node->conn_count;
+    conn->next = client->dead;
+    client->dead = conn;
+
+    for (p = conn->pending; p != NULL; p = next) {
+        next = p->conn_next;
+        if (p->call != NULL) {
+            for (call_link = &p->call->pending; *call_link != p;
+                 call_link = &(*call_link)->call_next) {
+            }
+            *call_link = p->call_next;
+            if (--p->call->copies == 0) {
+                argon2_cond_broadcast(&p->call->cond);
+            }
+        }
+        free(p);
+    }
+    node->outstanding -= conn->outstanding;
+    conn->outstanding = 0;
+    conn->pending = NULL;
+}
+
+/* Joins the readers of failed connections and frees them. Called with
+ * client->mutex held. */
+static void client_reap(argon2_client *client) {
+    client_conn **link = &client->dead, *conn;
+
+    while ((conn = *link) != NULL) {
+        if (conn->reading || conn->senders != 0) {
+            link = &conn->next;
+            continue;
+        }
+        *link = conn->next;
+        argon2_thread_join(conn->reader);
+        wire_close(conn->fd);
+        argon2_mutex_destroy(&conn->write_mutex);
+        free(conn);
+    }
+}
+
+/* Hands the response in @frame to the call of the copy it answers */
+static void client_answer(client_conn *conn, const uint8_t *frame,
+                          size_t len) {
+    uint32_t id = load32(frame);
+    client_pending **link, *p, **call_link;
+    client_call *call;
+    size_t body = len - WIRE_RESPONSE_HEADER;
+
+    for (link = &conn->pending; (p = *link) != NULL; link = &p->conn_next) {
+        if (p->id == id) {
+            break;
+        }
+    }
+    if (p == NULL) {
+        return;
+    }
+    *link = p->conn_next;
+    --conn->outstanding;
+    --conn->node->outstanding;
+
+    call = p->call;
+    if (call != NULL) {
+        for (call_link = &call->pending; *call_link != p;
+             call_link = &(*call_link)->call_next) {
+        }
+        *call_link = p->call_next;
+        --call->copies;
+        call->done = 1;
+        call->result = (int)(int32_t)load32(frame + 4);
+        if (call->result == ARGON2_OK && call->encoded != NULL) {
+            if (body < call->encodedlen) {
+                memcpy(call->encoded, frame + WIRE_RESPONSE_HEADER, body);
+                call->encoded[body] = '\0';
+            } else {
+                call->result = ARGON2_ENCODING_FAIL;
+            }
+        }
+        argon2_cond_broadcast(&call->cond);
+    }
+    free(p);
+}
+
+static void *client_read(void *arg) {
+    client_conn *conn = (client_conn *)arg;
+    argon2_client *client = conn->client;
+    uint8_t frame[WIRE_FRAME_MAX];
+    long len;
+
+    for (;;) {
+        len = wire_recv(conn->fd, frame);
+        if (len < WIRE_RESPONSE_HEADER) {
+            break;
+        }
+        argon2_mutex_lock(&client->mutex);
+        client_answer(conn, frame, (size_t)len);
+        argon2_mutex_unlock(&client->mutex);
+    }
+
+    argon2_mutex_lock(&client->mutex);
+    client_fail(client, conn);
+    conn->reading = 0;
+    argon2_mutex_unlock(&client->mutex);
+    return NULL;
+}
+
+/* Whether a copy of @call is waiting on @node */
+static int client_serves(const client_call *call, const client_node *node) {
+    const client_pending *p;
+
+    for (p = call->pending; p != NULL; p = p->call_next) {
+        if (p->conn->node == node) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Node with the fewest copies outstanding among those not serving @call,
+ * preferring nodes not skipped after a failure. Called with client->mutex
+ * held. */
+static client_node *client_pick(argon2_client *client,
+                                const client_call *call) {
+    client_node *node, *best = NULL;
+    uint64_t now = metrics_now();
+    int best_up = 0, up;
+    size_t i;
+
+    for (i = 0; i < client->node_count; ++i) {
+        node = &client->nodes[(client->next_node + i) % client->node_count];
+        if (client_serves(call, node)) {
+            continue;
+        }
+        up = node->down_until <= now;
+        if (best == NULL || up > best_up ||
+            (up == best_up && node->outstanding < best->outstanding)) {
+            best = node;
+            best_up = up;
+        }
+    }
+    client->next_node = (client->next_node + 1) % client->node_count;
+    return best;
+}
+
+/* Least loaded connection of @node, opening one more if all are busy and
+ * the pool is not full. Called with client->mutex held, which is released
+ * while connecting.
+ * @return The connection, or NULL if none could be opened */
+static client_conn *client_conn_of(argon2_client *client, client_node *node) {
+    client_conn *conn, *best = NULL;
+    int fd;
+
+    for (conn = node->conns; conn != NULL; conn = conn->next) {
+        if (best == NULL || conn->outstanding < best->outstanding) {
+            best = conn;
+        }
+    }
+    if (best != NULL &&
+        (best->outstanding == 0 || node->conn_count >= client->connections)) {
+        return best;
+    }
+
+    ++node->conn_count;
+    argon2_mutex_unlock(&client->mutex);
+    fd = wire_connect(node->host, node->port, client->timeout_ms);
+    conn = fd >= 0 ? calloc(1, sizeof(*conn)) : NULL;
+    if (conn != NULL && argon2_mutex_init(&conn->write_mutex) != 0) {
+        free(conn);
+        conn = NULL;
+    }
+    argon2_mutex_lock(&client->mutex);
+    --node->conn_count;
+
+    if (conn != NULL) {
+        conn->client = client;
+        conn->node = node;
+        conn->fd = fd;
+        conn->reading = 1;
+        if (argon2_thread_create(&conn->reader, &client_read, conn) != 0) {
+            argon2_mutex_destroy(&conn->write_mutex);
+            free(conn);
+            conn = NULL;
+        }
+    }
+    if (conn == NULL) {
+        if (fd >= 0) {
+            wire_close(fd);
+        }
+        node->down_until = metrics_now() + (uint64_t)CLIENT_DOWN_MS * 1000;
+        /* The connections already open may still work, though not
+         * necessarily those seen before connecting */
+        best = NULL;
+        for (conn = node->conns; conn != NULL; conn = conn->next) {
+            if (best == NULL || conn->outstanding < best->outstanding) {
+                best = conn;
+            }
+        }
+        return best;
+    }
+    conn->next = node->conns;
+    node->conns = conn;
+    ++node->conn_count;
+    return conn;
+}
+
+/*
+ * Sends a copy of @call to the least loaded node not serving it yet. Called
+ * with client->mutex held, which is released while connecting and sending.
+ * @return 0 if a copy was sent, -1 if no node took it
+ */
+static int client_send(argon2_client *client, client_call *call) {
+    client_node *node;
+    client_conn *conn;
+    client_pending *p;
+    size_t attempt;
+    int sent;
+
+    client_reap(client);
+    for (attempt = 0; attempt < client->node_count; ++attempt) {
+        node = client_pick(client, call);
+        if (node == NULL) {
+            return -1;
+        }
+        conn = client_conn_of(client, node);
+        if (conn == NULL) {
+            continue;
+        }
+        p = malloc(sizeof(*p));
+        if (p == NULL) {
+            return -1;
+        }
+        p->id = client->next_id++;
+        p->call = call;
+        p->conn = conn;
+        p->conn_next = conn->pending;
+        conn->pending = p;
+        p->call_next = call->pending;
+        call->pending = p;
+        ++conn->outstanding;
+        ++node->outstanding;
+        ++call->copies;
+        ++conn->senders;
+
+        store32(call->frame + 4, p->id);
+        argon2_mutex_unlock(&client->mutex);
+        argon2_mutex_lock(&conn->write_mutex);
+        sent = wire_send(conn->fd, call->frame, call->frame_len);
+        argon2_mutex_unlock(&conn->write_mutex);
+        argon2_mutex_lock(&client->mutex);
+
+        --conn->senders;
+        if (sent == 0) {
+            return 0;
+        }
+        client_fail(client, conn);
+    }
+    return -1;
+}
+
+/* Runs @call until a node answers it or it times out */
+static int client_run(argon2_client *client, client_call *call) {
+    client_pending *p;
+    uint64_t now = metrics_now();
+    uint64_t deadline = now + (uint64_t)client->timeout_ms * 1000;
+    uint64_t hedge_at = now + (uint64_t)client->hedge_ms * 1000;
+    uint64_t wake;
+    int hedge = client->hedge_ms != 0 && client->node_count > 1;
+    int sent = 0;
+
+    if (argon2_cond_init(&call->cond) != 0) {
+        return ARGON2_THREAD_FAIL;
+    }
+    argon2_mutex_lock(&client->mutex);
+    ++client->stats.requests;
+    for (;;) {
+        if (call->done) {
+            break;
+        }
+        now = metrics_now();
+        if (now >= deadline) {
+            call->result = ARGON2_NODE_TIMEOUT;
+            ++client->stats.timeouts;
+            break;
+        }
+        if (call->copies == 0) {
+            /* Not sent yet, or every copy was lost with its node */
+            if (sent) {
+                ++client->stats.retries;
+            }
+            if (client_send(client, call) == 0) {
+                sent = 1;
+                continue;
+            }
+            wake = now + (uint64_t)CLIENT_RETRY_MS * 1000;
+        } else if (hedge && now >= hedge_at) {
+            hedge = 0;
+            if (client_send(client, call) == 0) {
+                ++client->stats.hedges;
+            }
+            continue;
+        } else {
+            wake = hedge ? hedge_at : deadline;
+        }
+        if (wake > deadline) {
+            wake = deadline;
+        }
+        argon2_cond_wait_us(&call->cond, &client->mutex,
+                            (unsigned long)(wake - now) + 1);
+    }
+    /* Copies still out are dropped when answered */
+    for (p = call->pending; p != NULL; p = p->call_next) {
+        p->call = NULL;
+    }
+    argon2_mutex_unlock(&client->mutex);
+    argon2_cond_destroy(&call->cond);
+    return call->result;
+}
+
+/* Starts a request frame of @len bytes after its length */
+static void client_frame(uint8_t *frame, size_t len, uint32_t op,
+                         argon2_type type, uint32_t tenant) {
+    store32(frame, (uint32_t)len);
+    store32(frame + 4, 0); /* id, see client_send() */
+    store32(frame + 8, op);
+    store32(frame + 12, (uint32_t)type);
+    store32(frame + 16, tenant);
+}
+
+int argon2_client_verify(argon2_client *client, uint32_t tenant,
+                         const char *encoded, const void *pwd,
+                         const size_t pwdlen, argon2_type type) {
+    uint8_t frame[4 + WIRE_FRAME_MAX];
+    client_call call;
+    size_t encoded_len, len;
+    int result;
+
+    if (client == NULL || encoded == NULL) {
+        return ARGON2_MISSING_ARGS;
+    }
+    if (pwd == NULL && pwdlen != 0) {
+        return ARGON2_PWD_PTR_MISMATCH;
+    }
+    encoded_len = strlen(encoded);
+    if (encoded_len > WIRE_FRAME_MAX || pwdlen > WIRE_FRAME_MAX ||
+        WIRE_REQUEST_HEADER + 4 + encoded_len + pwdlen > WIRE_FRAME_MAX) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    len = WIRE_REQUEST_HEADER + 4 + encoded_len + pwdlen;
+    client_frame(frame, len, WIRE_VERIFY, type, tenant);
+    store32(frame + 4 + WIRE_REQUEST_HEADER, (uint32_t)encoded_len);
+    memcpy(frame + 8 + WIRE_REQUEST_HEADER, encoded, encoded_len);
+    if (pwdlen != 0) {
+        memcpy(frame + 8 + WIRE_REQUEST_HEADER + encoded_len, pwd, pwdlen);
+    }
+
+    memset(&call, 0, sizeof(call));
+    call.frame = frame;
+    call.frame_len = 4 + len;
+    result = client_run(client, &call);
+    clear_internal_memory(frame, 4 + len);
+    return result;
+}
+
+int argon2_client_hash(argon2_client *client, uint32_t tenant,
+                       const uint32_t t_cost, const uint32_t m_cost,
+                       const uint32_t parallelism, const void *pwd,
+                       const size_t pwdlen, const void *salt,
+                       const size_t saltlen, const size_t hashlen,
+                       char *encoded, const size_t encodedlen,
+                       argon2_type type) {
+    uint8_t frame[4 + WIRE_FRAME_MAX];
+    uint8_t *body = frame + 4 + WIRE_REQUEST_HEADER;
+    client_call call;
+    size_t len;
+    int result;
+
+    if (client == NULL || encoded == NULL) {
+        return ARGON2_MISSING_ARGS;
+    }
+    if (pwd == NULL && pwdlen != 0) {
+        return ARGON2_PWD_PTR_MISMATCH;
+    }
+    if (salt == NULL && saltlen != 0) {
+        return ARGON2_SALT_PTR_MISMATCH;
+    }
+    if (hashlen > ARGON2_MAX_OUTLEN) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+    if (saltlen > WIRE_FRAME_MAX || pwdlen > WIRE_FRAME_MAX ||
+        WIRE_REQUEST_HEADER + 20 + saltlen + pwdlen > WIRE_FRAME_MAX) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    len = WIRE_REQUEST_HEADER + 20 + saltlen + pwdlen;
+    client_frame(frame, len, WIRE_HASH, type, tenant);
+    store32(body, t_cost);
+    store32(body + 4, m_cost);
+    store32(body + 8, parallelism);
+    store32(body + 12, (uint32_t)hashlen);
+    store32(body + 16, (uint32_t)saltlen);
+    if (saltlen != 0) {
+        memcpy(body + 20, salt, saltlen);
+    }
+    if (pwdlen != 0) {
+        memcpy(body + 20 + saltlen, pwd, pwdlen);
+    }
+
+    memset(&call, 0, sizeof(call));
+    call.frame = frame;
+    call.frame_len = 4 + len;
+    call.encoded = encoded;
+    call.encodedlen = encodedlen;
+    result = client_run(client, &call);
+    clear_internal_memory(frame, 4 + len);
+    return result;
+}
+
+/* Splits "host:port" or "[address]:port" into @node */
+static int client_node_init(client_node *node, const char *spec) {
+    const char *colon = strrchr(spec, ':');
+    const char *host = spec, *host_end = colon;
+
+    if (colon == NULL || colon[1] == '\0') {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (*spec == '[') {
+        if (colon == spec || colon[-1] != ']') {
+            return ARGON2_INCORRECT_PARAMETER;
+        }
+        host = spec + 1;
+        host_end = colon - 1;
+    }
+    node->host = malloc((size_t)(host_end - host) + 1);
+    node->port = malloc(strlen(colon + 1) + 1);
+    if (node->host == NULL || node->port == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    memcpy(node->host, host, (size_t)(host_end - host));
+    node->host[host_end - host] = '\0';
+    strcpy(node->port, colon + 1);
+    return ARGON2_OK;
+}
+
+int argon2_client_create(argon2_client **client,
+                         const argon2_client_config *config) {
+    argon2_client *c;
+    size_t i;
+    int result = ARGON2_OK;
+
+    if (client == NULL || config == NULL) {
+        return ARGON2_MISSING_ARGS;
+    }
+    if (config->nodes == NULL || config->node_count == 0) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    c->nodes = calloc(config->node_count, sizeof(*c->nodes));
+    if (c->nodes == NULL) {
+        free(c);
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    c->node_count = config->node_count;
+    for (i = 0; i < config->node_count && result == ARGON2_OK; ++i) {
+        result = config->nodes[i] != NULL
+                     ? client_node_init(&c->nodes[i], config->nodes[i])
+                     : ARGON2_INCORRECT_PARAMETER;
+    }
+    if (result == ARGON2_OK && argon2_mutex_init(&c->mutex) != 0) {
+        result = ARGON2_THREAD_FAIL;
+    }
+    if (result != ARGON2_OK) {
+        for (i = 0; i < c->node_count; ++i) {
+            free(c->nodes[i].host);
+            free(c->nodes[i].port);
+        }
+        free(c->nodes);
+        free(c);
+        return result;
+    }
+    c->connections = config->connections != 0 ? config->connections : 1;
+    c->timeout_ms =
+        config->timeout_ms != 0 ? config->timeout_ms : CLIENT_TIMEOUT_MS;
+    c->hedge_ms = config->hedge_ms;
+    *client = c;
+    return ARGON2_OK;
+}
+
+void argon2_client_destroy(argon2_client *client) {
+    client_conn *dead, *conn;
+    size_t i;
+
+    if (client == NULL) {
+        return;
+    }
+    argon2_mutex_lock(&client->mutex);
+    for (i = 0; i < client->node_count; ++i) {
+        while (client->nodes[i].conns != NULL) {
+            client_fail(client, client->nodes[i].conns);
+        }
+    }
+    dead = client->dead;
+    client->dead = NULL;
+    argon2_mutex_unlock(&client->mutex);
+
+    /* Readers end once they see their connection shut down */
+    while ((conn = dead) != NULL) {
+        dead = conn->next;
+        argon2_thread_join(conn->reader);
+        wire_close(conn->fd);
+        argon2_mutex_destroy(&conn->write_mutex);
+        free(conn);
+    }
+
+    for (i = 0; i < client->node_count; ++i) {
+        free(client->nodes[i].host);
+        free(client->nodes[i].port);
+    }
+    argon2_mutex_destroy(&client->mutex);
+    free(client->nodes);
+    free(client);
+}
+
+void argon2_client_snapshot(argon2_client *client,
+                            argon2_client_stats *stats) {
+    if (client == NULL || stats == NULL) {
+        return;
+    }
+    argon2_mutex_lock(&client->mutex);
+    *stats = client->stats;
+    argon2_mutex_unlock(&client->mutex);
+}
+
+#else /* ARGON2_WIRE */
+
+int argon2_client_create(argon2_client **client,
+                         const argon2_client_config *config) {
+    (void)client;
+    (void)config;
+    return ARGON2_NETWORK_FAIL;
+}
+
+void argon2_client_destroy(argon2_client *client) { (void)client; }
+
+int argon2_client_verify(argon2_client *client, uint32_t tenant,
+                         const char *encoded, const void *pwd,
+                         const size_t pwdlen, argon2_type type) {
+    (void)client;
+    (void)tenant;
+    (void)encoded;
+    (void)pwd;
+    (void)pwdlen;
+    (void)type;
+    return ARGON2_NETWORK_FAIL;
+}
+
+int argon2_client_hash(argon2_client *client, uint32_t tenant,
+                       const uint32_t t_cost, const uint32_t m_cost,
+                       const uint32_t parallelism, const void *pwd,
+                       const size_t pwdlen, const void *salt,
+                       const size_t saltlen, const size_t hashlen,
+                       char *encoded, const size_t encodedlen,
+                       argon2_type type) {
+    (void)client;
+    (void)tenant;
+    (void)t_cost;
+    (void)m_cost;
+    (void)parallelism;
+    (void)pwd;
+    (void)pwdlen;
+    (void)salt;
+    (void)saltlen;
+    (void)hashlen;
+    (void)encoded;
+    (void)encodedlen;
+    (void)type;
+    return ARGON2_NETWORK_FAIL;
+}
+
+void argon2_client_snapshot(argon2_client *client,
+                            argon2_client_stats *stats) {
+    (void)client;
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+#endif /* ARGON2_WIRE */
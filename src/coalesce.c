@@ -0,0 +1,740 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#if defined(_MSC_VER)
+/* for rand_s() */
+#define _CRT_RAND_S
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "argon2.h"
+#include "core.h"
+#include "encoding.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "tasks.h"
+#include "thread.h"
+#include "blake2/blake2.h"
+#include "blake2/blake2-impl.h"
+
+/* Size of the digests identifying requests, and of their key */
+#define COALESCE_DIGEST_LENGTH 32
+#define COALESCE_KEY_LENGTH 32
+/* Buckets of in-flight verifications, indexed by the first digest byte */
+#define COALESCE_BUCKETS 256
+/* Buckets of the batch groups, a power of two, and most groups kept */
+#define COALESCE_GROUP_BUCKETS 64
+#define COALESCE_GROUPS_MAX 256
+
+/* A caller waiting for the result of a verification */
+typedef struct coalesce_waiter {
+    argon2_verify_callback callback;
+    void *arg;
+    struct coalesce_waiter *next;
+} coalesce_waiter;
+
+/* Tenant and parameters of the hash a request verifies against, which the
+ * requests of a batch share */
+typedef struct coalesce_params {
+    uint32_t tenant;
+    argon2_type type;
+    uint32_t version;
+    uint32_t m_cost;
+    uint32_t t_cost;
+    uint32_t lanes;
+} coalesce_params;
+
+/* A verification in flight, and everyone waiting for it */
+typedef struct coalesce_job {
+    argon2_task task; /* first, see tasks.h */
+    argon2_sched_ticket ticket; /* admission, taken before the task starts */
+    uint8_t digest[COALESCE_DIGEST_LENGTH];
+    char *encoded; /* copies, wiped once verified */
+    uint8_t *pwd;
+    size_t pwdlen;
+    argon2_type type;
+    coalesce_waiter *waiters; /* in arrival order */
+    coalesce_waiter **last;
+    struct coalesce_job *next;       /* in its bucket */
+    struct coalesce_job *batch_next; /* in its batch */
+} coalesce_job;
+
+/* Verifications of the same parameters, run back to back in one matrix */
+typedef struct coalesce_batch {
+    argon2_task task; /* first, see tasks.h */
+    argon2_sched_ticket ticket;
+    coalesce_params params;
+    coalesce_job *jobs, **last;
+    uint32_t count;
+    struct coalesce_batch *next; /* among batches closed together */
+} coalesce_batch;
+
+/* Requests of one tenant and parameter set, gathered into batches */
+typedef struct coalesce_group {
+    coalesce_params params;
+    coalesce_batch *open;  /* being gathered, NULL if none */
+    uint64_t deadline;     /* when it is dispatched however full */
+    uint64_t last_arrival; /* see metrics_now() */
+    uint64_t gap;          /* between arrivals, moving average, 0 if unknown */
+    struct coalesce_group *next; /* in its bucket */
+} coalesce_group;
+
+static struct {
+    int seeded;
+    uint8_t key[COALESCE_KEY_LENGTH];
+    coalesce_job *buckets[COALESCE_BUCKETS];
+
+    uint32_t inflight; /* jobs and batches dispatched and not done */
+    int batching;      /* whether argon2_batch_configure() turned it on */
+    argon2_batch_config batch;
+    int batcher;       /* whether the batcher thread runs */
+    coalesce_group *groups[COALESCE_GROUP_BUCKETS];
+    uint32_t group_count;
+} coalesce;
+
+#if !defined(ARGON2_NO_THREADS)
+static argon2_mutex_t coalesce_mutex = ARGON2_MUTEX_INITIALIZER;
+static argon2_cond_t coalesce_cond = ARGON2_COND_INITIALIZER;
+#define COALESCE_LOCK() argon2_mutex_lock(&coalesce_mutex)
+#define COALESCE_UNLOCK() argon2_mutex_unlock(&coalesce_mutex)
+#else
+#define COALESCE_LOCK()
+#define COALESCE_UNLOCK()
+#endif
+
+/*
+ * Draws the digest key from the system's random source. The key only keeps
+ * the digests, which sit in memory next to nothing else, from serving as a
+ * fast hash of the password; should the random source be missing, a hash
+ * of the time and of addresses still sets it apart from other processes.
+ * Called with coalesce_mutex held.
+ */
+static void coalesce_seed(void) {
+    uint8_t fallback[sizeof(void *) * 2 + sizeof(uint64_t) + sizeof(time_t) +
+                     sizeof(clock_t)];
+    uint8_t *p = fallback;
+    void *addresses[2];
+    uint64_t now = metrics_now();
+    time_t seconds = time(NULL);
+    clock_t ticks = clock();
+    int seeded = 0;
+#if defined(_MSC_VER)
+    unsigned int word;
+    unsigned i;
+
+    for (i = 0; i < COALESCE_KEY_LENGTH; i += sizeof(word)) {
+        if (rand_s(&word) != 0) {
+            break;
+        }
+        memcpy(coalesce.key + i, &word, sizeof(word));
+    }
+    seeded = i >= COALESCE_KEY_LENGTH;
+#else
+    FILE *random = fopen("/dev/urandom", "rb");
+
+    if (random != NULL) {
+        seeded = fread(coalesce.key, 1, COALESCE_KEY_LENGTH, random) ==
+                 COALESCE_KEY_LENGTH;
+        fclose(random);
+    }
+#endif
+    if (!seeded) {
+        addresses[0] = &now;
+        addresses[1] = coalesce.buckets;
+        memcpy(p, addresses, sizeof(addresses));
+        p += sizeof(addresses);
+        memcpy(p, &now, sizeof(now));
+        p += sizeof(now);
+        memcpy(p, &seconds, sizeof(seconds));
+        p += sizeof(seconds);
+        memcpy(p, &ticks, sizeof(ticks));
+        blake2b(coalesce.key, COALESCE_KEY_LENGTH, fallback, sizeof(fallback),
+                NULL, 0);
+    }
+    coalesce.seeded = 1;
+}
+
+/* Identifies a request by the keyed BLAKE2b digest of its inputs; called
+ * with coalesce_mutex held */
+static void coalesce_digest(uint8_t *digest, const char *encoded,
+                            const void *pwd, size_t pwdlen, argon2_type type,
+                            uint32_t tenant) {
+    blake2b_state state;
+    uint8_t lengths[16];
+
+    if (!coalesce.seeded) {
+        coalesce_seed();
+    }
+    store32(lengths, (uint32_t)type);
+    store32(lengths + 4, tenant);
+    store64(lengths + 8, (uint64_t)strlen(encoded));
+    blake2b_init_key(&state, COALESCE_DIGEST_LENGTH, coalesce.key,
+                     COALESCE_KEY_LENGTH);
+    blake2b_update(&state, lengths, sizeof(lengths));
+    blake2b_update(&state, encoded, strlen(encoded));
+    blake2b_update(&state, pwd, pwdlen);
+    blake2b_final(&state, digest, COALESCE_DIGEST_LENGTH);
+}
+
+static void coalesce_free(coalesce_job *job) {
+    if (job->encoded != NULL) {
+        clear_internal_memory(job->encoded, strlen(job->encoded));
+        free(job->encoded);
+    }
+    if (job->pwd != NULL) {
+        secure_wipe_memory(job->pwd, job->pwdlen);
+        free(job->pwd);
+    }
+    free(job);
+}
+
+/* Unlinks @job from its bucket; called with coalesce_mutex held */
+static void coalesce_unlink(coalesce_job *job) {
+    coalesce_job **link = &coalesce.buckets[job->digest[0]];
+    while (*link != job) {
+        link = &(*link)->next;
+    }
+    *link = job->next;
+}
+
+/* Hands the result to every waiter and frees the job */
+static void coalesce_finish(coalesce_job *job, int result) {
+    coalesce_waiter *waiter, *next;
+
+    /* Requests arriving from now on start a verification of their own */
+    COALESCE_LOCK();
+    coalesce_unlink(job);
+    waiter = job->waiters;
+    COALESCE_UNLOCK();
+
+    coalesce_free(job);
+    for (; waiter != NULL; waiter = next) {
+        next = waiter->next;
+        waiter->callback(result, waiter->arg);
+        free(waiter);
+    }
+}
+
+/* Counts a job or batch as done */
+static void coalesce_done(void) {
+    COALESCE_LOCK();
+    --coalesce.inflight;
+    COALESCE_UNLOCK();
+}
+
+/* Verifies, then hands the result to every waiter and frees the job */
+static void coalesce_run(argon2_task *task) {
+    coalesce_job *job = (coalesce_job *)task;
+    int result = verify_ticket(job->encoded, job->pwd, job->pwdlen, job->type,
+                               &job->ticket, NULL, 0);
+
+    sched_release(&job->ticket);
+    coalesce_finish(job, result);
+    coalesce_done();
+}
+
+/* Starts an admitted job on a worker, or failing any, right here */
+static void coalesce_ready(argon2_sched_ticket *ticket) {
+    coalesce_job *job =
+        (coalesce_job *)((uint8_t *)ticket - offsetof(coalesce_job, ticket));
+
+    if (tasks_submit(TASKS_FOREGROUND, &job->task) != 0) {
+        coalesce_run(&job->task);
+    }
+}
+
+/* Verifies the jobs of a batch in turn, in a matrix of its own, then frees
+ * it. The matrix is wiped after each hash. */
+static void coalesce_run_batch(argon2_task *task) {
+    coalesce_batch *batch = (coalesce_batch *)task;
+    coalesce_job *job, *next;
+    size_t matrix_len = argon2_memory_required(batch->params.m_cost,
+                                               batch->params.lanes);
+    /* Failing that, each hash allocates its own */
+    void *matrix = matrix_len != 0 ? malloc(matrix_len) : NULL;
+    int result;
+
+    for (job = batch->jobs; job != NULL; job = next) {
+        next = job->batch_next;
+        result = verify_ticket(job->encoded, job->pwd, job->pwdlen, job->type,
+                               &batch->ticket, matrix,
+                               matrix != NULL ? matrix_len : 0);
+        coalesce_finish(job, result);
+    }
+
+    if (matrix != NULL) {
+        /* The hashes used it as caller-supplied memory */
+        batch->ticket.usage.memory += matrix_len;
+        free(matrix);
+    }
+    sched_release(&batch->ticket);
+    free(batch);
+    coalesce_done();
+}
+
+static void coalesce_ready_batch(argon2_sched_ticket *ticket) {
+    coalesce_batch *batch = (coalesce_batch *)((uint8_t *)ticket -
+                                               offsetof(coalesce_batch, ticket));
+
+    if (tasks_submit(TASKS_FOREGROUND, &batch->task) != 0) {
+        coalesce_run_batch(&batch->task);
+    }
+}
+
+/* Queues a batch closed by coalesce_close() for admission, as a single hash
+ * holding one matrix and computing the blocks of all its jobs */
+static void coalesce_dispatch_batch(coalesce_batch *batch) {
+    uint32_t memory_blocks =
+        (uint32_t)(argon2_memory_required(batch->params.m_cost,
+                                          batch->params.lanes) /
+                   ARGON2_BLOCK_SIZE);
+    uint64_t passes = (uint64_t)batch->params.t_cost * batch->count;
+
+    metrics_add(METRIC_VERIFY_BATCHES, 1);
+    metrics_add(METRIC_VERIFY_BATCHED, batch->count);
+    sched_ticket(&batch->ticket, batch->params.tenant);
+    sched_submit(&batch->ticket, memory_blocks,
+                 passes > UINT32_MAX ? UINT32_MAX : (uint32_t)passes,
+                 coalesce_ready_batch);
+}
+
+/*
+ * Reads the tenant and parameters of the hash @job verifies against
+ * @return 1 on success, 0 if it does not decode, as it then fails at once
+ */
+static int coalesce_params_of(const coalesce_job *job, uint32_t tenant,
+                              coalesce_params *params) {
+    argon2_context ctx;
+    size_t encoded_len = strlen(job->encoded);
+    uint8_t *scratch = malloc(encoded_len);
+    int decoded;
+
+    if (scratch == NULL) {
+        return 0;
+    }
+    /* Salt and tag are decoded into the same scratch buffer and dropped */
+    ctx.salt = scratch;
+    ctx.saltlen = (uint32_t)encoded_len;
+    ctx.out = scratch;
+    ctx.outlen = (uint32_t)encoded_len;
+    ctx.pwd = job->pwd;
+    ctx.pwdlen = (uint32_t)job->pwdlen;
+    decoded = decode_string(&ctx, job->encoded, job->type) == ARGON2_OK;
+    if (decoded) {
+        memset(params, 0, sizeof(*params));
+        params->tenant = tenant;
+        params->type = job->type;
+        params->version = ctx.version;
+        params->m_cost = ctx.m_cost;
+        params->t_cost = ctx.t_cost;
+        params->lanes = ctx.lanes;
+    }
+    clear_internal_memory(scratch, encoded_len);
+    free(scratch);
+    return decoded;
+}
+
+#if !defined(ARGON2_NO_THREADS)
+
+static void coalesce_lock(void) { argon2_mutex_lock(&coalesce_mutex); }
+
+static void coalesce_unlock(void) { argon2_mutex_unlock(&coalesce_mutex); }
+
+/*
+ * Starts over in a forked child, which only has the thread that called
+ * fork(): the verifications in flight are the parent's, whose threads hand
+ * out their results. The child wipes its copies of their passwords and
+ * drops them without calling back. Batching stays on, with a batcher thread
+ * of its own started by the next request.
+ */
+static void coalesce_forked(void) {
+    coalesce_job *job, *next;
+    coalesce_waiter *waiter, *next_waiter;
+    coalesce_group *group;
+    unsigned i;
+
+    argon2_mutex_init(&coalesce_mutex);
+    argon2_cond_init(&coalesce_cond);
+    for (i = 0; i < COALESCE_BUCKETS; ++i) {
+        for (job = coalesce.buckets[i]; job != NULL; job = next) {
+            next = job->next;
+            for (waiter = job->waiters; waiter != NULL; waiter = next_waiter) {
+                next_waiter = waiter->next;
+                free(waiter);
+            }
+            coalesce_free(job);
+        }
+        coalesce.buckets[i] = NULL;
+    }
+    for (i = 0; i < COALESCE_GROUP_BUCKETS; ++i) {
+        for (group = coalesce.groups[i]; group != NULL; group = group->next) {
+            free(group->open);
+            group->open = NULL;
+        }
+    }
+    coalesce.inflight = 0;
+    coalesce.batcher = 0;
+}
+
+static argon2_once_t coalesce_once = ARGON2_ONCE_INIT;
+
+static void coalesce_register(void) {
+    /* Requests are gathered with coalesce_mutex held, which calls the
+     * scheduler */
+    sched_atfork();
+    argon2_thread_atfork(coalesce_lock, coalesce_unlock, coalesce_forked);
+}
+
+static void coalesce_atfork(void) {
+    argon2_thread_once(&coalesce_once, coalesce_register);
+}
+
+/* Starts the batcher thread unless it runs; called with coalesce_mutex held
+ * @return Whether it runs */
+static int coalesce_start_batcher(void);
+
+/* Finds the group of @params, creating it unless there are too many;
+ * called with coalesce_mutex held */
+static coalesce_group *coalesce_group_of(const coalesce_params *params) {
+    coalesce_group *group;
+    coalesce_group **bucket =
+        &coalesce.groups[(params->m_cost ^ params->t_cost ^ params->tenant) &
+                         (COALESCE_GROUP_BUCKETS - 1)];
+
+    for (group = *bucket; group != NULL; group = group->next) {
+        if (memcmp(&group->params, params, sizeof(*params)) == 0) {
+            return group;
+        }
+    }
+    if (coalesce.group_count >= COALESCE_GROUPS_MAX) {
+        return NULL;
+    }
+    group = calloc(1, sizeof(*group));
+    if (group != NULL) {
+        group->params = *params;
+        group->next = *bucket;
+        *bucket = group;
+        ++coalesce.group_count;
+    }
+    return group;
+}
+
+/* Takes the batch being gathered out of @group for dispatch; called with
+ * coalesce_mutex held */
+static coalesce_batch *coalesce_close(coalesce_group *group) {
+    coalesce_batch *batch = group->open;
+    group->open = NULL;
+    ++coalesce.inflight;
+    return batch;
+}
+
+/*
+ * Adds @job to the batch gathered for @params, opening one if the
+ * processors are all busy (with verifications in flight, or hashes waiting
+ * for admission) and more requests are expected within the window. Called
+ * with coalesce_mutex held.
+ * @param full Receives the batch if the job filled it, for dispatch
+ * @return 1 if the job was batched, 0 if it is to run alone
+ */
+static int coalesce_gather(coalesce_job *job, const coalesce_params *params,
+                           coalesce_batch **full) {
+    coalesce_group *group;
+    coalesce_batch *batch;
+    uint64_t now, window;
+
+    *full = NULL;
+    if (!coalesce.batching || !coalesce_start_batcher() ||
+        (group = coalesce_group_of(params)) == NULL) {
+        return 0;
+    }
+
+    now = metrics_now();
+    if (group->last_arrival != 0) {
+        uint64_t gap = now - group->last_arrival;
+        group->gap = group->gap != 0 ? (group->gap * 3 + gap) / 4 : gap;
+    }
+    group->last_arrival = now;
+
+    if (group->open == NULL) {
+        window = coalesce.batch.window_us;
+        if (group->gap != 0) {
+            if (group->gap >= window) {
+                return 0; /* no other request expected in time */
+            }
+            /* as long as a batch takes to fill at the recent rate */
+            if (group->gap * (coalesce.batch.max_batch - 1) < window) {
+                window = group->gap * (coalesce.batch.max_batch - 1);
+            }
+        }
+        if (coalesce.inflight < argon2_thread_cpus() && sched_waiting() == 0) {
+            return 0; /* a processor is free: start at once */
+        }
+        batch = calloc(1, sizeof(*batch));
+        if (batch == NULL) {
+            return 0;
+        }
+        batch->task.run = coalesce_run_batch;
+        batch->params = *params;
+        batch->last = &batch->jobs;
+        group->open = batch;
+        group->deadline = now + window;
+        argon2_cond_broadcast(&coalesce_cond);
+    }
+
+    batch = group->open;
+    job->batch_next = NULL;
+    *batch->last = job;
+    batch->last = &job->batch_next;
+    if (++batch->count >= coalesce.batch.max_batch) {
+        *full = coalesce_close(group);
+    }
+    return 1;
+}
+
+/* Closes the batches whose window is over, or all of them if @all is set,
+ * onto @closed; called with coalesce_mutex held
+ * @return Microseconds until the next window is over, 0 if none is open */
+static uint64_t coalesce_expire(int all, coalesce_batch ***closed) {
+    coalesce_group *group;
+    uint64_t now = metrics_now(), next = 0;
+    unsigned i;
+
+    for (i = 0; i < COALESCE_GROUP_BUCKETS; ++i) {
+        for (group = coalesce.groups[i]; group != NULL; group = group->next) {
+            if (group->open == NULL) {
+                continue;
+            }
+            if (all || group->deadline <= now) {
+                coalesce_batch *batch = coalesce_close(group);
+                batch->next = NULL;
+                **closed = batch;
+                *closed = &batch->next;
+            } else if (next == 0 || group->deadline - now < next) {
+                next = group->deadline - now;
+            }
+        }
+    }
+    return next;
+}
+
+/* Dispatches batches collected by coalesce_expire() */
+static void coalesce_dispatch_closed(coalesce_batch *closed) {
+    coalesce_batch *next;
+    for (; closed != NULL; closed = next) {
+        next = closed->next;
+        coalesce_dispatch_batch(closed);
+    }
+}
+
+#ifdef _WIN32
+static unsigned __stdcall coalesce_batcher(void *arg)
+#else
+static void *coalesce_batcher(void *arg)
+#endif
+{
+    coalesce_batch *closed, **last;
+    uint64_t next;
+
+    (void)arg;
+    COALESCE_LOCK();
+    for (;;) {
+        closed = NULL;
+        last = &closed;
+        next = coalesce_expire(0, &last);
+        if (closed != NULL) {
+            COALESCE_UNLOCK();
+            coalesce_dispatch_closed(closed);
+            COALESCE_LOCK();
+            continue;
+        }
+        argon2_cond_wait_us(&coalesce_cond, &coalesce_mutex,
+                            (unsigned long)next);
+    }
+    return 0;
+}
+
+static int coalesce_start_batcher(void) {
+    argon2_thread_handle_t handle;
+
+    if (!coalesce.batcher) {
+        coalesce.batcher =
+            argon2_thread_create(&handle, &coalesce_batcher, NULL) == 0;
+    }
+    return coalesce.batcher;
+}
+
+int argon2_batch_configure(const argon2_batch_config *config) {
+    coalesce_batch *closed = NULL, **last = &closed;
+    int result = ARGON2_OK;
+
+    if (config != NULL && config->max_batch == 0) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    coalesce_atfork();
+    COALESCE_LOCK();
+    if (config == NULL) {
+        coalesce.batching = 0;
+        coalesce_expire(1, &last);
+    } else {
+        coalesce.batch = *config;
+        coalesce.batching = 1;
+        if (!coalesce_start_batcher()) {
+            coalesce.batching = 0;
+            result = ARGON2_THREAD_FAIL;
+        }
+    }
+    argon2_cond_broadcast(&coalesce_cond);
+    COALESCE_UNLOCK();
+
+    coalesce_dispatch_closed(closed);
+    return result;
+}
+
+#else /* ARGON2_NO_THREADS */
+
+static void coalesce_atfork(void) {}
+
+static int coalesce_gather(coalesce_job *job, const coalesce_params *params,
+                           coalesce_batch **full) {
+    (void)job;
+    (void)params;
+    *full = NULL;
+    return 0;
+}
+
+int argon2_batch_configure(const argon2_batch_config *config) {
+    (void)config;
+    return ARGON2_THREAD_FAIL;
+}
+
+#endif /* ARGON2_NO_THREADS */
+
+int argon2_verify_async(const char *encoded, const void *pwd,
+                        const size_t pwdlen, argon2_type type,
+                        argon2_verify_callback callback, void *arg) {
+    return argon2_verify_async_tenant(encoded, pwd, pwdlen, type, 0, callback,
+                                      arg);
+}
+
+int argon2_verify_async_tenant(const char *encoded, const void *pwd,
+                               const size_t pwdlen, argon2_type type,
+                               uint32_t tenant,
+                               argon2_verify_callback callback, void *arg) {
+    uint8_t digest[COALESCE_DIGEST_LENGTH];
+    coalesce_waiter *waiter;
+    coalesce_job *job;
+    size_t encoded_len;
+    coalesce_params params;
+    coalesce_batch *full;
+    int batched;
+
+    if (encoded == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+    if (pwd == NULL && pwdlen != 0) {
+        return ARGON2_PWD_PTR_MISMATCH;
+    }
+    if (pwdlen > ARGON2_MAX_PWD_LENGTH) {
+        return ARGON2_PWD_TOO_LONG;
+    }
+    if (callback == NULL) {
+        return ARGON2_MISSING_ARGS;
+    }
+
+    waiter = malloc(sizeof(*waiter));
+    if (waiter == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    waiter->callback = callback;
+    waiter->arg = arg;
+    waiter->next = NULL;
+
+    coalesce_atfork();
+    COALESCE_LOCK();
+    coalesce_digest(digest, encoded, pwd, pwdlen, type, tenant);
+    for (job = coalesce.buckets[digest[0]]; job != NULL; job = job->next) {
+        if (memcmp(job->digest, digest, sizeof(digest)) == 0) {
+            /* Identical request in flight: wait for its result */
+            *job->last = waiter;
+            job->last = &waiter->next;
+            metrics_add(METRIC_VERIFY_COALESCED, 1);
+            COALESCE_UNLOCK();
+            return ARGON2_OK;
+        }
+    }
+
+    encoded_len = strlen(encoded);
+    job = calloc(1, sizeof(*job));
+    if (job != NULL) {
+        job->encoded = malloc(encoded_len + 1);
+        job->pwd = malloc(pwdlen + 1);
+    }
+    if (job == NULL || job->encoded == NULL || job->pwd == NULL) {
+        COALESCE_UNLOCK();
+        if (job != NULL) {
+            free(job->encoded);
+            free(job->pwd);
+            free(job);
+        }
+        free(waiter);
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    memcpy(job->digest, digest, sizeof(digest));
+    memcpy(job->encoded, encoded, encoded_len + 1);
+    if (pwdlen != 0) {
+        memcpy(job->pwd, pwd, pwdlen);
+    }
+    job->pwdlen = pwdlen;
+    job->type = type;
+    job->waiters = waiter;
+    job->last = &waiter->next;
+    job->task.run = coalesce_run;
+    sched_ticket(&job->ticket, tenant);
+    job->next = coalesce.buckets[digest[0]];
+    coalesce.buckets[digest[0]] = job;
+    COALESCE_UNLOCK();
+
+    if (!coalesce_params_of(job, tenant, &params)) {
+        memset(&params, 0, sizeof(params));
+    }
+    COALESCE_LOCK();
+    batched = params.m_cost != 0 && coalesce_gather(job, &params, &full);
+    if (!batched) {
+        ++coalesce.inflight;
+    }
+    COALESCE_UNLOCK();
+
+    /* The job takes a worker once admitted, so that hashes held back by the
+     * limit or by the caps of their tenant do not tie up the workers. A job
+     * that fails to get one runs on the thread that admitted it. */
+    if (!batched) {
+        sched_submit(&job->ticket,
+                     (uint32_t)(argon2_memory_required(params.m_cost,
+                                                       params.lanes) /
+                                ARGON2_BLOCK_SIZE),
+                     params.t_cost, coalesce_ready);
+    } else if (full != NULL) {
+        coalesce_dispatch_batch(full);
+    }
+    return ARGON2_OK;
+}
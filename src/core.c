@@ -25,15 +25,29 @@
 #endif
 #define VC_GE_2005(version) (version >= 1400)
 
+#if !defined(ARGON2_AMALGAMATION)
 /* for explicit_bzero() on glibc */
 #define _DEFAULT_SOURCE
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
 
+#include "checkpoint.h"
 #include "core.h"
-#include "thread.h"
+#include "mempool.h"
+#include "metrics.h"
+#include "pool.h"
+#include "trace.h"
 #include "blake2/blake2.h"
 #include "blake2/blake2-impl.h"
 
@@ -41,6 +55,10 @@
 #include "genkat.h"
 #endif
 
+#ifdef ACCESS_TRACE
+#include "access.h"
+#endif
+
 #if defined(__clang__)
 #if __has_attribute(optnone)
 #define NOT_OPTIMIZED __attribute__((optnone))
@@ -101,7 +119,7 @@ int allocate_memory(const argon2_context *context, uint8_t **memory,
     /* 2. Try to allocate with appropriate allocator */
     if (context->allocate_cbk) {
         (context->allocate_cbk)(memory, memory_size);
-    } else {
+    } else if ((*memory = mempool_acquire(memory_size)) == NULL) {
         *memory = malloc(memory_size);
     }
 
@@ -109,18 +127,119 @@ int allocate_memory(const argon2_context *context, uint8_t **memory,
         return ARGON2_MEMORY_ALLOCATION_ERROR;
     }
 
+    metrics_add(METRIC_BYTES_ALLOCATED, (int64_t)memory_size);
+    ARGON2_PROBE2(allocate, memory_size, *memory);
     return ARGON2_OK;
 }
 
 void free_memory(const argon2_context *context, uint8_t *memory,
                  size_t num, size_t size) {
     size_t memory_size = num*size;
+    ARGON2_PROBE2(free, memory_size, memory);
     clear_internal_memory(memory, memory_size);
     if (context->free_cbk) {
         (context->free_cbk)(memory, memory_size);
-    } else {
+    } else if (!mempool_release(memory, memory_size)) {
         free(memory);
     }
+    metrics_add(METRIC_BYTES_ALLOCATED, -(int64_t)memory_size);
+}
+
+#if defined(__linux__) && !defined(MLOCK_ONFAULT)
+#define MLOCK_ONFAULT 1
+#endif
+
+/* Locks @memory in RAM, returns 0 on success. On Linux pages are locked as
+ * they are first touched (MLOCK_ONFAULT) rather than all prefaulted here. */
+static int lock_memory(void *memory, size_t size) {
+#if defined(_WIN32)
+    return VirtualLock(memory, size) ? 0 : -1;
+#else
+#if defined(__linux__) && defined(SYS_mlock2)
+    if (syscall(SYS_mlock2, memory, size, MLOCK_ONFAULT) == 0) {
+        return 0;
+    }
+    if (errno != ENOSYS && errno != EINVAL) {
+        return -1;
+    }
+    /* Kernel without mlock2 or MLOCK_ONFAULT: lock it all up front */
+#endif
+    return mlock(memory, size);
+#endif
+}
+
+static void unlock_memory(void *memory, size_t size) {
+#if defined(_WIN32)
+    VirtualUnlock(memory, size);
+#else
+    munlock(memory, size);
+#endif
+}
+
+/***************Matrix layout*****************/
+
+/* Number of separately allocated regions the matrix is made of */
+static uint32_t matrix_regions(const argon2_instance_t *instance) {
+    return instance->layout == ARGON2_LAYOUT_SPLIT_LANES ? instance->lanes : 1;
+}
+
+/* Pointer to the start of region @r of the matrix */
+static block **matrix_region(argon2_instance_t *instance, uint32_t r) {
+    return instance->layout == ARGON2_LAYOUT_SPLIT_LANES
+               ? &instance->lane_memory[r]
+               : &instance->memory;
+}
+
+/* Allocates the regions of the matrix; on failure nothing stays allocated */
+static int allocate_matrix(const argon2_context *context,
+                           argon2_instance_t *instance) {
+    uint32_t regions = matrix_regions(instance), r;
+    size_t region_blocks = instance->memory_blocks / regions;
+    int result = ARGON2_OK;
+
+    if (instance->layout == ARGON2_LAYOUT_SPLIT_LANES) {
+        instance->lane_memory = calloc(instance->lanes, sizeof(block *));
+        if (instance->lane_memory == NULL) {
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
+    }
+    for (r = 0; r < regions && result == ARGON2_OK; ++r) {
+        result = allocate_memory(context, (uint8_t **)matrix_region(instance, r),
+                                 region_blocks, sizeof(block));
+    }
+    if (result != ARGON2_OK) {
+        while (--r > 0) {
+            free_memory(context, (uint8_t *)*matrix_region(instance, r - 1),
+                        region_blocks, sizeof(block));
+        }
+        free(instance->lane_memory);
+        instance->lane_memory = NULL;
+    }
+    return result;
+}
+
+/* Unlocks the regions of the matrix if they were locked, then clears them,
+ * and frees them unless they were supplied by the caller */
+static void free_matrix(const argon2_context *context,
+                        argon2_instance_t *instance) {
+    uint32_t regions = matrix_regions(instance), r;
+    size_t region_blocks = instance->memory_blocks / regions;
+
+    for (r = 0; r < regions; ++r) {
+        block *region = *matrix_region(instance, r);
+        if (instance->memory_locked) {
+            unlock_memory(region, region_blocks * sizeof(block));
+        }
+        if (instance->external_memory) {
+            clear_internal_memory(region, region_blocks * sizeof(block));
+        } else {
+            free_memory(context, (uint8_t *)region, region_blocks,
+                        sizeof(block));
+        }
+    }
+    instance->memory_locked = 0;
+    free(instance->lane_memory);
+    instance->lane_memory = NULL;
 }
 
 #if defined(__OpenBSD__)
@@ -157,13 +276,14 @@ void finalize(const argon2_context *context, argon2_instance_t *instance) {
         block blockhash;
         uint32_t l;
 
-        copy_block(&blockhash, instance->memory + instance->lane_length - 1);
+        ARGON2_PROBE1(finalize__start, instance->lanes);
+
+        copy_block(&blockhash, block_at(instance, 0, instance->lane_length - 1));
 
         /* XOR the last blocks */
         for (l = 1; l < instance->lanes; ++l) {
-            uint32_t last_block_in_lane =
-                l * instance->lane_length + (instance->lane_length - 1);
-            xor_block(&blockhash, instance->memory + last_block_in_lane);
+            xor_block(&blockhash,
+                      block_at(instance, l, instance->lane_length - 1));
         }
 
         /* Hash the result */
@@ -181,8 +301,9 @@ void finalize(const argon2_context *context, argon2_instance_t *instance) {
         print_tag(context->out, context->outlen);
 #endif
 
-        free_memory(context, (uint8_t *)instance->memory,
-                    instance->memory_blocks, sizeof(block));
+        free_matrix(context, instance);
+
+        ARGON2_PROBE1(finalize__done, context->outlen);
     }
 }
 
@@ -260,129 +381,87 @@ uint32_t index_alpha(const argon2_instance_t *instance,
 static int fill_memory_blocks_st(argon2_instance_t *instance) {
     uint32_t r, s, l;
 
-    for (r = 0; r < instance->passes; ++r) {
+    for (r = instance->first_pass; r < instance->passes; ++r) {
         for (s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+            ARGON2_PROBE2(slice__start, r, s);
             for (l = 0; l < instance->lanes; ++l) {
                 argon2_position_t position = {r, l, (uint8_t)s, 0};
+                ARGON2_PROBE3(segment__start, r, s, l);
                 fill_segment(instance, position);
+                ARGON2_PROBE3(segment__done, r, s, l);
             }
+            ARGON2_PROBE2(slice__done, r, s);
         }
 #ifdef GENKAT
         internal_kat(instance, r); /* Print all memory blocks */
 #endif
+        if (instance->checkpoint != NULL && r + 1 < instance->passes) {
+            int rc = checkpoint_save(instance, r + 1);
+            if (rc != ARGON2_OK) {
+                return rc;
+            }
+        }
     }
     return ARGON2_OK;
 }
 
 #if !defined(ARGON2_NO_THREADS)
 
-#ifdef _WIN32
-static unsigned __stdcall fill_segment_thr(void *thread_data)
-#else
-static void *fill_segment_thr(void *thread_data)
-#endif
-{
-    argon2_thread_data *my_data = thread_data;
-    fill_segment(my_data->instance_ptr, my_data->pos);
-    argon2_thread_exit();
-    return 0;
-}
-
 /* Multi-threaded version for p > 1 case */
 static int fill_memory_blocks_mt(argon2_instance_t *instance) {
     uint32_t r, s;
-    argon2_thread_handle_t *thread = NULL;
-    argon2_thread_data *thr_data = NULL;
-    int rc = ARGON2_OK;
 
-    /* 1. Allocating space for threads */
-    thread = calloc(instance->lanes, sizeof(argon2_thread_handle_t));
-    if (thread == NULL) {
-        rc = ARGON2_MEMORY_ALLOCATION_ERROR;
-        goto fail;
-    }
-
-    thr_data = calloc(instance->lanes, sizeof(argon2_thread_data));
-    if (thr_data == NULL) {
-        rc = ARGON2_MEMORY_ALLOCATION_ERROR;
-        goto fail;
-    }
-
-    for (r = 0; r < instance->passes; ++r) {
+    for (r = instance->first_pass; r < instance->passes; ++r) {
         for (s = 0; s < ARGON2_SYNC_POINTS; ++s) {
-            uint32_t l, ll;
-
-            /* 2. Calling threads */
-            for (l = 0; l < instance->lanes; ++l) {
-                argon2_position_t position;
-
-                /* 2.1 Join a thread if limit is exceeded */
-                if (l >= instance->threads) {
-                    if (argon2_thread_join(thread[l - instance->threads])) {
-                        rc = ARGON2_THREAD_FAIL;
-                        goto fail;
-                    }
-                }
-
-                /* 2.2 Create thread */
-                position.pass = r;
-                position.lane = l;
-                position.slice = (uint8_t)s;
-                position.index = 0;
-                thr_data[l].instance_ptr =
-                    instance; /* preparing the thread input */
-                memcpy(&(thr_data[l].pos), &position,
-                       sizeof(argon2_position_t));
-                if (argon2_thread_create(&thread[l], &fill_segment_thr,
-                                         (void *)&thr_data[l])) {
-                    /* Wait for already running threads */
-                    for (ll = 0; ll < l; ++ll)
-                        argon2_thread_join(thread[ll]);
-                    rc = ARGON2_THREAD_FAIL;
-                    goto fail;
-                }
-
-                /* fill_segment(instance, position); */
-                /*Non-thread equivalent of the lines above */
-            }
+            int rc;
 
-            /* 3. Joining remaining threads */
-            for (l = instance->lanes - instance->threads; l < instance->lanes;
-                 ++l) {
-                if (argon2_thread_join(thread[l])) {
-                    rc = ARGON2_THREAD_FAIL;
-                    goto fail;
-                }
+            ARGON2_PROBE2(slice__start, r, s);
+            rc = pool_fill_slice(instance, r, (uint8_t)s);
+            if (rc != ARGON2_OK) {
+                return rc;
             }
+            ARGON2_PROBE2(slice__done, r, s);
         }
 
 #ifdef GENKAT
         internal_kat(instance, r); /* Print all memory blocks */
 #endif
+        /* Pass boundary: every segment of pass r is written */
+        if (instance->checkpoint != NULL && r + 1 < instance->passes) {
+            int rc = checkpoint_save(instance, r + 1);
+            if (rc != ARGON2_OK) {
+                return rc;
+            }
+        }
     }
-
-fail:
-    if (thread != NULL) {
-        free(thread);
-    }
-    if (thr_data != NULL) {
-        free(thr_data);
-    }
-    return rc;
+    return ARGON2_OK;
 }
 
 #endif /* ARGON2_NO_THREADS */
 
 int fill_memory_blocks(argon2_instance_t *instance) {
+    int rc;
+
 	if (instance == NULL || instance->lanes == 0) {
 	    return ARGON2_INCORRECT_PARAMETER;
     }
+#ifdef ACCESS_TRACE
+    access_begin(instance);
+#endif
 #if defined(ARGON2_NO_THREADS)
-    return fill_memory_blocks_st(instance);
+    rc = fill_memory_blocks_st(instance);
 #else
-    return instance->threads == 1 ?
+    rc = instance->threads == 1 ?
 			fill_memory_blocks_st(instance) : fill_memory_blocks_mt(instance);
 #endif
+#ifdef ACCESS_TRACE
+    access_end();
+#endif
+    /* finalize() will not run: unlock, clear and free the matrix here */
+    if (rc != ARGON2_OK) {
+        free_matrix(instance->context_ptr, instance);
+    }
+    return rc;
 }
 
 int validate_inputs(const argon2_context *context) {
@@ -509,6 +588,12 @@ int validate_inputs(const argon2_context *context) {
         return ARGON2_ALLOCATE_MEMORY_CBK_NULL;
     }
 
+    /* Validate layout: at most one may be requested */
+    if ((context->flags & ARGON2_FLAG_LAYOUT_SEGMENT_MAJOR) &&
+        (context->flags & ARGON2_FLAG_LAYOUT_SPLIT_LANES)) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
     return ARGON2_OK;
 }
 
@@ -523,14 +608,12 @@ void fill_first_blocks(uint8_t *blockhash, const argon2_instance_t *instance) {
         store32(blockhash + ARGON2_PREHASH_DIGEST_LENGTH + 4, l);
         blake2b_long(blockhash_bytes, ARGON2_BLOCK_SIZE, blockhash,
                      ARGON2_PREHASH_SEED_LENGTH);
-        load_block(&instance->memory[l * instance->lane_length + 0],
-                   blockhash_bytes);
+        load_block(block_at(instance, l, 0), blockhash_bytes);
 
         store32(blockhash + ARGON2_PREHASH_DIGEST_LENGTH, 1);
         blake2b_long(blockhash_bytes, ARGON2_BLOCK_SIZE, blockhash,
                      ARGON2_PREHASH_SEED_LENGTH);
-        load_block(&instance->memory[l * instance->lane_length + 1],
-                   blockhash_bytes);
+        load_block(block_at(instance, l, 1), blockhash_bytes);
     }
     clear_internal_memory(blockhash_bytes, ARGON2_BLOCK_SIZE);
 }
@@ -617,11 +700,35 @@ int initialize(argon2_instance_t *instance, argon2_context *context) {
         return ARGON2_INCORRECT_PARAMETER;
     instance->context_ptr = context;
 
+    ARGON2_PROBE2(init__start, instance->memory_blocks, instance->lanes);
+
     /* 1. Memory allocation */
-    result = allocate_memory(context, (uint8_t **)&(instance->memory),
-                             instance->memory_blocks, sizeof(block));
-    if (result != ARGON2_OK) {
-        return result;
+    instance->lane_memory = NULL;
+    if (!instance->external_memory) {
+        result = allocate_matrix(context, instance);
+        if (result != ARGON2_OK) {
+            ARGON2_PROBE1(init__done, result);
+            return result;
+        }
+    }
+
+    instance->memory_locked = 0;
+    if (context->flags & ARGON2_FLAG_LOCK_MEMORY) {
+        uint32_t regions = matrix_regions(instance), r;
+        size_t region_size = instance->memory_blocks / regions * sizeof(block);
+        for (r = 0; r < regions; ++r) {
+            if (lock_memory(*matrix_region(instance, r), region_size) != 0) {
+                break;
+            }
+        }
+        if (r == regions) {
+            instance->memory_locked = 1;
+        } else {
+            while (r-- > 0) {
+                unlock_memory(*matrix_region(instance, r), region_size);
+            }
+            metrics_add(METRIC_LOCK_FAILURES, 1);
+        }
     }
 
     /* 2. Initial hashing */
@@ -641,8 +748,18 @@ int initialize(argon2_instance_t *instance, argon2_context *context) {
     /* 3. Creating first blocks, we always have at least two blocks in a slice
      */
     fill_first_blocks(blockhash, instance);
+
+    /* 4. Restoring the matrix of a checkpoint over them, if resuming */
+    instance->first_pass = 0;
+    if (instance->checkpoint != NULL) {
+        result = checkpoint_begin(instance, blockhash);
+    }
     /* Clearing the hash */
     clear_internal_memory(blockhash, ARGON2_PREHASH_SEED_LENGTH);
 
-    return ARGON2_OK;
+    if (result != ARGON2_OK) {
+        free_matrix(context, instance);
+    }
+    ARGON2_PROBE1(init__done, result);
+    return result;
 }
@@ -22,6 +22,14 @@
 
 #define CONST_CAST(x) (x)(uintptr_t)
 
+#ifdef _WIN32
+#define ARGON2_INLINE __inline
+#elif defined(__GNUC__) || defined(__clang__)
+#define ARGON2_INLINE __inline__
+#else
+#define ARGON2_INLINE
+#endif
+
 /**********************Argon2 internal constants*******************************/
 
 enum argon2_core_constants {
@@ -54,13 +62,27 @@ typedef struct block_ { uint64_t v[ARGON2_QWORDS_IN_BLOCK]; } block;
 /*****************Functions that work with the block******************/
 
 /* Initialize each byte of the block with @in */
-void init_block_value(block *b, uint8_t in);
+ARGON2_LOCAL void init_block_value(block *b, uint8_t in);
 
 /* Copy block @src to block @dst */
-void copy_block(block *dst, const block *src);
+ARGON2_LOCAL void copy_block(block *dst, const block *src);
 
 /* XOR @src onto @dst bytewise */
-void xor_block(block *dst, const block *src);
+ARGON2_LOCAL void xor_block(block *dst, const block *src);
+
+/*
+ * Physical placement of the blocks of the matrix. The algorithm only sees
+ * blocks by (lane, index) through block_at(); every layout keeps each segment
+ * contiguous.
+ */
+typedef enum Argon2_layout {
+    ARGON2_LAYOUT_LANE_MAJOR = 0,    /* lane after lane, in one allocation */
+    ARGON2_LAYOUT_SEGMENT_MAJOR = 1, /* slice after slice: the segments all
+                                        lanes fill at once are side by side */
+    ARGON2_LAYOUT_SPLIT_LANES = 2    /* each lane in an allocation of its own */
+} argon2_layout;
+
+struct Argon2_checkpoint;
 
 /*
  * Argon2 instance: memory pointer, number of passes, amount of memory, type,
@@ -70,6 +92,8 @@ void xor_block(block *dst, const block *src);
  */
 typedef struct Argon2_instance_t {
     block *memory;          /* Memory pointer */
+    block **lane_memory;    /* Lane pointers for ARGON2_LAYOUT_SPLIT_LANES */
+    argon2_layout layout;
     uint32_t version;
     uint32_t passes;        /* Number of passes */
     uint32_t memory_blocks; /* Number of blocks in memory */
@@ -79,7 +103,14 @@ typedef struct Argon2_instance_t {
     uint32_t threads;
     argon2_type type;
     int print_internals; /* whether to print the memory blocks */
+    int external_memory; /* whether memory was supplied by the caller */
+    int memory_locked;   /* whether memory is locked in RAM */
     argon2_context *context_ptr; /* points back to original context */
+    struct Argon2_checkpoint *checkpoint; /* NULL unless checkpointing */
+    uint32_t first_pass; /* pass to start from, non-zero when resuming */
+    uint64_t cpu_time;   /* nanoseconds pool workers spent filling it */
+    uint32_t pool_base;  /* first pool rank of its lanes plus one, 0 until
+                            its first slice on the pool */
 } argon2_instance_t;
 
 /*
@@ -93,14 +124,31 @@ typedef struct Argon2_position_t {
     uint32_t index;
 } argon2_position_t;
 
-/*Struct that holds the inputs for thread handling FillSegment*/
-typedef struct Argon2_thread_data {
-    argon2_instance_t *instance_ptr;
-    argon2_position_t pos;
-} argon2_thread_data;
-
 /*************************Argon2 core functions********************************/
 
+/*
+ * Locates a block of the matrix. Inline, as the filling loops call it for
+ * every reference block.
+ * @param instance Current Argon2 instance
+ * @param lane Lane of the block
+ * @param index Index of the block within its lane
+ * @return Pointer to the block, according to @instance->layout
+ */
+static ARGON2_INLINE block *block_at(const argon2_instance_t *instance,
+                                     uint32_t lane, uint32_t index) {
+    if (instance->layout == ARGON2_LAYOUT_LANE_MAJOR) {
+        return instance->memory + (size_t)lane * instance->lane_length + index;
+    } else if (instance->layout == ARGON2_LAYOUT_SPLIT_LANES) {
+        return instance->lane_memory[lane] + index;
+    } else {
+        uint32_t slice = index / instance->segment_length;
+        return instance->memory +
+               ((size_t)slice * instance->lanes + lane) *
+                   instance->segment_length +
+               (index - slice * instance->segment_length);
+    }
+}
+
 /* Allocates memory to the given pointer, uses the appropriate allocator as
  * specified in the context. Total allocated memory is num*size.
  * @param context argon2_context which specifies the allocator
@@ -109,8 +157,8 @@ typedef struct Argon2_thread_data {
  * @param num the number of elements to be allocated
  * @return ARGON2_OK if @memory is a valid pointer and memory is allocated
  */
-int allocate_memory(const argon2_context *context, uint8_t **memory,
-                    size_t num, size_t size);
+ARGON2_LOCAL int allocate_memory(const argon2_context *context,
+                                 uint8_t **memory, size_t num, size_t size);
 
 /*
  * Frees memory at the given pointer, uses the appropriate deallocator as
@@ -120,15 +168,15 @@ int allocate_memory(const argon2_context *context, uint8_t **memory,
  * @param size the size in bytes for each element to be deallocated
  * @param num the number of elements to be deallocated
  */
-void free_memory(const argon2_context *context, uint8_t *memory,
-                 size_t num, size_t size);
+ARGON2_LOCAL void free_memory(const argon2_context *context, uint8_t *memory,
+                              size_t num, size_t size);
 
 /* Function that securely cleans the memory. This ignores any flags set
  * regarding clearing memory. Usually one just calls clear_internal_memory.
  * @param mem Pointer to the memory
  * @param s Memory size in bytes
  */
-void secure_wipe_memory(void *v, size_t n);
+ARGON2_LOCAL void secure_wipe_memory(void *v, size_t n);
 
 /* Function that securely clears the memory if FLAG_clear_internal_memory is
  * set. If the flag isn't set, this function does nothing.
@@ -147,9 +195,9 @@ void clear_internal_memory(void *v, size_t n);
  * If so we can reference the current segment
  * @pre All pointers must be valid
  */
-uint32_t index_alpha(const argon2_instance_t *instance,
-                     const argon2_position_t *position, uint32_t pseudo_rand,
-                     int same_lane);
+ARGON2_LOCAL uint32_t index_alpha(const argon2_instance_t *instance,
+                                  const argon2_position_t *position,
+                                  uint32_t pseudo_rand, int same_lane);
 
 /*
  * Function that validates all inputs against predefined restrictions and return
@@ -158,7 +206,7 @@ uint32_t index_alpha(const argon2_instance_t *instance,
  * @return ARGON2_OK if everything is all right, otherwise one of error codes
  * (all defined in <argon2.h>
  */
-int validate_inputs(const argon2_context *context);
+ARGON2_LOCAL int validate_inputs(const argon2_context *context);
 
 /*
  * Hashes all the inputs into @a blockhash[PREHASH_DIGEST_LENGTH], clears
@@ -170,8 +218,8 @@ int validate_inputs(const argon2_context *context);
  * @pre    @a blockhash must have at least @a PREHASH_DIGEST_LENGTH bytes
  * allocated
  */
-void initial_hash(uint8_t *blockhash, argon2_context *context,
-                  argon2_type type);
+ARGON2_LOCAL void initial_hash(uint8_t *blockhash, argon2_context *context,
+                               argon2_type type);
 
 /*
  * Function creates first 2 blocks per lane
@@ -179,23 +227,26 @@ void initial_hash(uint8_t *blockhash, argon2_context *context,
  * @param blockhash Pointer to the pre-hashing digest
  * @pre blockhash must point to @a PREHASH_SEED_LENGTH allocated values
  */
-void fill_first_blocks(uint8_t *blockhash, const argon2_instance_t *instance);
+ARGON2_LOCAL void fill_first_blocks(uint8_t *blockhash,
+                                    const argon2_instance_t *instance);
 
 /*
- * Function allocates memory, hashes the inputs with Blake,  and creates first
- * two blocks. Returns the pointer to the main memory with 2 blocks per lane
- * initialized
+ * Function allocates memory (unless @instance->external_memory is set, in
+ * which case @instance->memory is used as is), hashes the inputs with Blake,
+ * and creates first two blocks. Returns the pointer to the main memory with 2
+ * blocks per lane initialized
  * @param  context  Pointer to the Argon2 internal structure containing memory
  * pointer, and parameters for time and space requirements.
  * @param  instance Current Argon2 instance
  * @return Zero if successful, -1 if memory failed to allocate. @context->state
  * will be modified if successful.
  */
-int initialize(argon2_instance_t *instance, argon2_context *context);
+ARGON2_LOCAL int initialize(argon2_instance_t *instance,
+                            argon2_context *context);
 
 /*
  * XORing the last block of each lane, hashing it, making the tag. Deallocates
- * the memory.
+ * the memory, or only clears it if it was supplied by the caller.
  * @param context Pointer to current Argon2 context (use only the out parameters
  * from it)
  * @param instance Pointer to current instance of Argon2
@@ -204,7 +255,8 @@ int initialize(argon2_instance_t *instance, argon2_context *context);
  * @pre if context->free_cbk is not NULL, it should point to a function that
  * deallocates memory
  */
-void finalize(const argon2_context *context, argon2_instance_t *instance);
+ARGON2_LOCAL void finalize(const argon2_context *context,
+                           argon2_instance_t *instance);
 
 /*
  * Function that fills the segment using previous segments also from other
@@ -214,15 +266,16 @@ void finalize(const argon2_context *context, argon2_instance_t *instance);
  * @param position Current position
  * @pre all block pointers must be valid
  */
-void fill_segment(const argon2_instance_t *instance,
-                  argon2_position_t position);
+ARGON2_LOCAL void fill_segment(const argon2_instance_t *instance,
+                               argon2_position_t position);
 
 /*
  * Function that fills the entire memory t_cost times based on the first two
- * blocks in each lane
+ * blocks in each lane. On failure the memory is released as finalize()
+ * would release it.
  * @param instance Pointer to the current instance
  * @return ARGON2_OK if successful, @context->state
  */
-int fill_memory_blocks(argon2_instance_t *instance);
+ARGON2_LOCAL int fill_memory_blocks(argon2_instance_t *instance);
 
 #endif
@@ -370,8 +370,6 @@ int decode_string(argon2_context *ctx, const char *str, argon2_type type) {
 #undef BIN
 }
 
-int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
-                  argon2_type type) {
 #define SS(str)                                                                \
     do {                                                                       \
         size_t pp_len = strlen(str);                                           \
@@ -400,18 +398,14 @@ int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
         dst_len -= sb_len;                                                     \
     } while ((void)0, 0)
 
+int encode_header(char *dst, size_t dst_len, const argon2_context *ctx,
+                  argon2_type type) {
     const char* type_string = argon2_type2string(type, 0);
-    int validation_result = validate_inputs(ctx);
 
     if (!type_string) {
       return ARGON2_ENCODING_FAIL;
     }
 
-    if (validation_result != ARGON2_OK) {
-      return validation_result;
-    }
-
-
     SS("$");
     SS(type_string);
 
@@ -426,15 +420,195 @@ int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
     SX(ctx->lanes);
 
     SS("$");
+    return ARGON2_OK;
+}
+
+/* Encodes what follows the header: the salt and the output */
+static int encode_body(char *dst, size_t dst_len, const argon2_context *ctx) {
     SB(ctx->salt, ctx->saltlen);
 
     SS("$");
     SB(ctx->out, ctx->outlen);
     return ARGON2_OK;
+}
+
+int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
+                  argon2_type type) {
+    int validation_result;
+    size_t header_len;
+
+    if (!argon2_type2string(type, 0)) {
+      return ARGON2_ENCODING_FAIL;
+    }
+
+    validation_result = validate_inputs(ctx);
+    if (validation_result != ARGON2_OK) {
+      return validation_result;
+    }
+
+    validation_result = encode_header(dst, dst_len, ctx, type);
+    if (validation_result != ARGON2_OK) {
+      return validation_result;
+    }
+
+    header_len = strlen(dst);
+    return encode_body(dst + header_len, dst_len - header_len, ctx);
+}
+
+int encode_with_header(char *dst, size_t dst_len, const char *header,
+                       size_t header_len, const argon2_context *ctx) {
+    if (header_len + b64len(ctx->saltlen) + 1 + b64len(ctx->outlen) >=
+        dst_len) {
+        return ARGON2_ENCODING_FAIL;
+    }
+
+    memcpy(dst, header, header_len);
+    return encode_body(dst + header_len, dst_len - header_len, ctx);
+}
 
 #undef SS
 #undef SX
 #undef SB
+
+/*
+ * Compact binary records hold the fields of a hash string without any text:
+ *
+ *   header m_cost t_cost lanes saltlen salt out
+ *
+ * The integers are unsigned LEB128 varints, seven bits per byte with the
+ * least significant group first. Only their shortest form is accepted, so
+ * that a hash has exactly one record.
+ */
+
+static size_t to_varint(uint8_t *dst, uint32_t x) {
+    size_t len = 0;
+    while (x >= 0x80) {
+        dst[len++] = (uint8_t)(x | 0x80);
+        x >>= 7;
+    }
+    dst[len++] = (uint8_t)x;
+    return len;
+}
+
+/*
+ * Decode an unsigned varint into *v, returning the number of bytes read, or 0
+ * if the input is truncated, overlong, or out of range.
+ */
+static size_t from_varint(uint32_t *v, const uint8_t *src, size_t src_len) {
+    uint32_t acc = 0;
+    size_t i;
+
+    for (i = 0; i < src_len && i < 5; i++) {
+        uint32_t group = src[i] & 0x7F;
+        if (i == 4 && group > 0x0F) {
+            return 0; /* more than 32 bits */
+        }
+        acc |= group << (7 * i);
+        if (!(src[i] & 0x80)) {
+            if (i > 0 && group == 0) {
+                return 0; /* not the shortest form */
+            }
+            *v = acc;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+int encode_binary(uint8_t *dst, size_t *dst_len, argon2_context *ctx,
+                  argon2_type type) {
+    int validation_result = validate_inputs(ctx);
+    size_t len;
+
+    if (argon2_type2string(type, 0) == NULL ||
+        (ctx->version != ARGON2_VERSION_10 &&
+         ctx->version != ARGON2_VERSION_13)) {
+        return ARGON2_ENCODING_FAIL;
+    }
+
+    if (validation_result != ARGON2_OK) {
+        return validation_result;
+    }
+
+    len = 1 + varintlen(ctx->m_cost) + varintlen(ctx->t_cost) +
+          varintlen(ctx->lanes) + varintlen(ctx->saltlen) + ctx->saltlen +
+          ctx->outlen;
+    if (len > *dst_len) {
+        return ARGON2_ENCODING_FAIL;
+    }
+
+    *dst++ = (uint8_t)((ARGON2_BINARY_FORMAT << 4) |
+                       (ctx->version == ARGON2_VERSION_13 ? 0x04 : 0) |
+                       (unsigned)type);
+    dst += to_varint(dst, ctx->m_cost);
+    dst += to_varint(dst, ctx->t_cost);
+    dst += to_varint(dst, ctx->lanes);
+    dst += to_varint(dst, ctx->saltlen);
+    memcpy(dst, ctx->salt, ctx->saltlen);
+    memcpy(dst + ctx->saltlen, ctx->out, ctx->outlen);
+
+    *dst_len = len;
+    return ARGON2_OK;
+}
+
+int decode_binary(argon2_context *ctx, const uint8_t *src, size_t src_len,
+                  argon2_type *type) {
+
+/* Decoding a varint into a uint32_t */
+#define VARINT(x)                                                              \
+    do {                                                                       \
+        size_t vi_len = from_varint(&(x), src, src_len);                       \
+        if (vi_len == 0) {                                                     \
+            return ARGON2_DECODING_FAIL;                                       \
+        }                                                                      \
+        src += vi_len;                                                         \
+        src_len -= vi_len;                                                     \
+    } while ((void)0, 0)
+
+    unsigned header;
+
+    if (src_len == 0) {
+        return ARGON2_DECODING_FAIL;
+    }
+    header = *src++;
+    src_len--;
+    if ((header >> 4) != ARGON2_BINARY_FORMAT || (header & 0x08) != 0 ||
+        argon2_type2string((argon2_type)(header & 0x03), 0) == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+    *type = (argon2_type)(header & 0x03);
+    ctx->version = header & 0x04 ? ARGON2_VERSION_13 : ARGON2_VERSION_10;
+
+    VARINT(ctx->m_cost);
+    VARINT(ctx->t_cost);
+    VARINT(ctx->lanes);
+    ctx->threads = ctx->lanes;
+
+    VARINT(ctx->saltlen);
+    if (ctx->saltlen > src_len || src_len - ctx->saltlen > UINT32_MAX) {
+        return ARGON2_DECODING_FAIL;
+    }
+    ctx->salt = (uint8_t *)src;
+    ctx->out = (uint8_t *)src + ctx->saltlen;
+    ctx->outlen = (uint32_t)(src_len - ctx->saltlen);
+
+    /* The rest of the fields get the default values */
+    ctx->secret = NULL;
+    ctx->secretlen = 0;
+    ctx->ad = NULL;
+    ctx->adlen = 0;
+    ctx->allocate_cbk = NULL;
+    ctx->free_cbk = NULL;
+    ctx->flags = ARGON2_DEFAULT_FLAGS;
+
+    /* On return, must have valid context */
+    return validate_inputs(ctx);
+#undef VARINT
+}
+
+argon2_type binary_type(const uint8_t *src, size_t src_len) {
+    /* an impossible type if there is no header, for metrics to ignore */
+    return (argon2_type)(src_len > 0 ? src[0] & 0x03 : 0x03);
 }
 
 size_t b64len(uint32_t len) {
@@ -461,3 +635,11 @@ size_t numlen(uint32_t num) {
     return len;
 }
 
+size_t varintlen(uint32_t num) {
+    size_t len = 1;
+    while (num >= 0x80) {
+        ++len;
+        num >>= 7;
+    }
+    return len;
+}
@@ -31,8 +31,29 @@
 *
 * on success, ARGON2_OK is returned.
 */
-int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
-                  argon2_type type);
+ARGON2_LOCAL int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
+                               argon2_type type);
+
+/*
+* encode the header of an Argon2 hash string, "$argon2id$v=19$m=...,t=...,p=...$",
+* into the provided buffer, as encode_string() would. The inputs are not
+* validated.
+*
+* on success, ARGON2_OK is returned.
+*/
+ARGON2_LOCAL int encode_header(char *dst, size_t dst_len,
+                               const argon2_context *ctx, argon2_type type);
+
+/*
+* encode an Argon2 hash string made of a header rendered by encode_header()
+* and of the salt and output of 'ctx', without rendering the parameters
+* again; 'dst_len' is checked against the precomputed length up front.
+*
+* on success, ARGON2_OK is returned.
+*/
+ARGON2_LOCAL int encode_with_header(char *dst, size_t dst_len,
+                                    const char *header, size_t header_len,
+                                    const argon2_context *ctx);
 
 /*
 * Decodes an Argon2 hash string into the provided structure 'ctx'.
@@ -46,12 +67,48 @@ int encode_string(char *dst, size_t dst_len, argon2_context *ctx,
 *
 * Returned value is ARGON2_OK on success, other ARGON2_ codes on error.
 */
-int decode_string(argon2_context *ctx, const char *str, argon2_type type);
+ARGON2_LOCAL int decode_string(argon2_context *ctx, const char *str,
+                               argon2_type type);
+
+/*
+* Compact binary records hold the same fields as hash strings: a header byte
+* (record format in the high nibble, bit 2 set for version 0x13, the type in
+* the low two bits), then m_cost, t_cost, the lanes and the salt length as
+* LEB128 varints, the raw salt, and the raw output up to the end of the record.
+*/
+#define ARGON2_BINARY_FORMAT 1
+
+/*
+* encode an Argon2 binary record into the provided buffer. '*dst_len' contains
+* the size of the 'dst' buffer, and receives the length of the record; if the
+* buffer is too small, then this function returns ARGON2_ENCODING_FAIL.
+*
+* on success, ARGON2_OK is returned.
+*/
+ARGON2_LOCAL int encode_binary(uint8_t *dst, size_t *dst_len,
+                               argon2_context *ctx, argon2_type type);
+
+/*
+* Decodes an Argon2 binary record into the provided structure 'ctx', and its
+* type into 'type'. ctx.salt and ctx.out are pointed into 'src' rather than
+* copied, so the record must outlive the use of ctx. ctx.pwd and ctx.pwdlen
+* must hold a valid password.
+*
+* Returned value is ARGON2_OK on success, other ARGON2_ codes on error.
+*/
+ARGON2_LOCAL int decode_binary(argon2_context *ctx, const uint8_t *src,
+                               size_t src_len, argon2_type *type);
+
+/* Returns the type a binary record claims, without validating it */
+ARGON2_LOCAL argon2_type binary_type(const uint8_t *src, size_t src_len);
 
 /* Returns the length of the encoded byte stream with length len */
-size_t b64len(uint32_t len);
+ARGON2_LOCAL size_t b64len(uint32_t len);
 
 /* Returns the length of the encoded number num */
-size_t numlen(uint32_t num);
+ARGON2_LOCAL size_t numlen(uint32_t num);
+
+/* Returns the length of the varint num */
+ARGON2_LOCAL size_t varintlen(uint32_t num);
 
 #endif
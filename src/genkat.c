@@ -20,6 +20,8 @@
 #include <string.h>
 #include "argon2.h"
 #include "core.h"
+#include "blake2/blake2.h"
+#include "blake2/blake2-impl.h"
 #ifdef __MINGW32__
 #include <inttypes.h>
 #else
@@ -27,6 +29,10 @@
 #define PRIx64 "llx"
 #endif
 
+/* Whether internal_kat() prints a digest of the memory rather than the
+ * memory itself */
+static int digest_kat = 0;
+
 void initial_kat(const uint8_t *blockhash, const argon2_context *context,
                  argon2_type type) {
     unsigned i;
@@ -108,9 +114,40 @@ void print_tag(const void *out, uint32_t outlen) {
     }
 }
 
+/*
+ * BLAKE2b digest of the whole memory, every word of every block in the
+ * logical order of internal_kat(), whatever the layout
+ */
+static void digest_kat_memory(const argon2_instance_t *instance) {
+    uint8_t bytes[ARGON2_BLOCK_SIZE];
+    uint8_t digest[BLAKE2B_OUTBYTES];
+    blake2b_state state;
+    uint32_t i, j;
+
+    blake2b_init(&state, BLAKE2B_OUTBYTES);
+    for (i = 0; i < instance->memory_blocks; ++i) {
+        const block *b = block_at(instance, i / instance->lane_length,
+                                  i % instance->lane_length);
+        for (j = 0; j < ARGON2_QWORDS_IN_BLOCK; ++j) {
+            store64(bytes + j * sizeof(b->v[j]), b->v[j]);
+        }
+        blake2b_update(&state, bytes, ARGON2_BLOCK_SIZE);
+    }
+    blake2b_final(&state, digest, BLAKE2B_OUTBYTES);
+
+    printf("Memory digest: ");
+    for (i = 0; i < BLAKE2B_OUTBYTES; ++i) {
+        printf("%2.2x", digest[i]);
+    }
+    printf("\n");
+}
+
 void internal_kat(const argon2_instance_t *instance, uint32_t pass) {
 
-    if (instance != NULL) {
+    if (instance != NULL && digest_kat) {
+        printf("\n After pass %u:\n", pass);
+        digest_kat_memory(instance);
+    } else if (instance != NULL) {
         uint32_t i, j;
         printf("\n After pass %u:\n", pass);
 
@@ -119,10 +156,12 @@ void internal_kat(const argon2_instance_t *instance, uint32_t pass) {
                 (instance->memory_blocks > ARGON2_QWORDS_IN_BLOCK)
                     ? 1
                     : ARGON2_QWORDS_IN_BLOCK;
+            const block *b = block_at(instance, i / instance->lane_length,
+                                      i % instance->lane_length);
 
             for (j = 0; j < how_many_words; ++j)
                 printf("Block %.4u [%3u]: %016" PRIx64 "\n", i, j,
-                       (unsigned long long)instance->memory[i].v[j]);
+                       (unsigned long long)b->v[j]);
         }
     }
 }
@@ -132,7 +171,8 @@ static void fatal(const char *error) {
     exit(1);
 }
 
-static void generate_testvectors(argon2_type type, const uint32_t version) {
+static void generate_testvectors(argon2_type type, const uint32_t version,
+                                 uint32_t layout_flags) {
 #define TEST_OUTLEN 32
 #define TEST_PWDLEN 32
 #define TEST_SALTLEN 16
@@ -174,7 +214,7 @@ static void generate_testvectors(argon2_type type, const uint32_t version) {
     context.threads = lanes;
     context.allocate_cbk = myown_allocator;
     context.free_cbk = myown_deallocator;
-    context.flags = ARGON2_DEFAULT_FLAGS;
+    context.flags = ARGON2_DEFAULT_FLAGS | layout_flags;
 
 #undef TEST_OUTLEN
 #undef TEST_PWDLEN
@@ -190,6 +230,7 @@ int main(int argc, char *argv[]) {
     const char *type_str = (argc > 1) ? argv[1] : "i";
     argon2_type type = Argon2_i;
     uint32_t version = ARGON2_VERSION_NUMBER;
+    uint32_t layout_flags = 0;
     if (!strcmp(type_str, "d")) {
         type = Argon2_d;
     } else if (!strcmp(type_str, "i")) {
@@ -208,6 +249,25 @@ int main(int argc, char *argv[]) {
         fatal("wrong Argon2 version number");
     }
 
-    generate_testvectors(type, version);
+    /* Get and check the memory layout */
+    if (argc > 3) {
+        if (!strcmp(argv[3], "segment")) {
+            layout_flags = ARGON2_FLAG_LAYOUT_SEGMENT_MAJOR;
+        } else if (!strcmp(argv[3], "split")) {
+            layout_flags = ARGON2_FLAG_LAYOUT_SPLIT_LANES;
+        } else if (strcmp(argv[3], "lane")) {
+            fatal("wrong memory layout");
+        }
+    }
+
+    /* Memory digests instead of the memory, as in the .digest KATs */
+    if (argc > 4) {
+        if (strcmp(argv[4], "digest")) {
+            fatal("wrong output mode");
+        }
+        digest_kat = 1;
+    }
+
+    generate_testvectors(type, version, layout_flags);
     return ARGON2_OK;
 }
@@ -0,0 +1,484 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#if defined(__linux__) && !defined(ARGON2_AMALGAMATION)
+/* for MAP_ANONYMOUS, MAP_POPULATE, MADV_FREE and mincore() */
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "argon2.h"
+#include "mempool.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "thread.h"
+
+/* How often the background thread trims and pre-grows, in milliseconds */
+#define MEMPOOL_TICK_MS 100
+/* How much larger than requested an idle matrix may be and still be reused:
+ * one eighth */
+#define MEMPOOL_SLACK(size) ((size) / 8)
+
+#if !defined(_WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+typedef struct mempool_entry {
+    void *memory;
+    size_t size;
+    int in_use;
+    int advised;        /* handed back to the kernel since its last use */
+    size_t resident;    /* bytes counted in METRIC_MEMPOOL_RESIDENT */
+    uint64_t last_used; /* see metrics_now() */
+    struct mempool_entry *next;
+} mempool_entry;
+
+static struct {
+    int enabled;
+    argon2_mempool_config config;
+    mempool_entry *entries;
+    size_t retained;    /* bytes of idle matrices */
+    uint32_t in_use;    /* matrices handed out */
+    size_t last_size;   /* size of the most recent request */
+    uint32_t demand;    /* hashes running or waiting at the last tick */
+    int trimmer;        /* whether the background thread runs */
+} mempool;
+
+#if !defined(ARGON2_NO_THREADS)
+static argon2_mutex_t mempool_mutex = ARGON2_MUTEX_INITIALIZER;
+static argon2_cond_t mempool_cond = ARGON2_COND_INITIALIZER;
+#define MEMPOOL_LOCK() argon2_mutex_lock(&mempool_mutex)
+#define MEMPOOL_UNLOCK() argon2_mutex_unlock(&mempool_mutex)
+#else
+#define MEMPOOL_LOCK()
+#define MEMPOOL_UNLOCK()
+#endif
+
+/***************System memory*****************/
+
+static void *mempool_map(size_t size, int populate) {
+#if defined(_WIN32)
+    (void)populate;
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *memory;
+#if defined(MAP_POPULATE)
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#else
+    (void)populate;
+#endif
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+#endif
+}
+
+static void mempool_unmap(void *memory, size_t size) {
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+}
+
+/* Lets the kernel reclaim the pages of @memory, which stays mapped */
+static void mempool_advise(void *memory, size_t size) {
+#if defined(_WIN32)
+    VirtualAlloc(memory, size, MEM_RESET, PAGE_READWRITE);
+#elif defined(MADV_FREE)
+    madvise(memory, size, MADV_FREE);
+#else
+    madvise(memory, size, MADV_DONTNEED);
+#endif
+}
+
+#if !defined(ARGON2_NO_THREADS)
+static size_t mempool_resident_bytes(const mempool_entry *entry) {
+#if defined(__linux__)
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pages = (entry->size + page - 1) / page, i, resident = 0;
+    unsigned char *vec = malloc(pages);
+    if (vec == NULL || mincore(entry->memory, entry->size, vec) != 0) {
+        free(vec);
+        return entry->advised ? 0 : entry->size;
+    }
+    for (i = 0; i < pages; ++i) {
+        resident += vec[i] & 1;
+    }
+    free(vec);
+    return resident * page;
+#else
+    return entry->advised ? 0 : entry->size;
+#endif
+}
+#endif
+
+/***************Pool*****************/
+
+/* Sets how many bytes of @entry are resident in RAM; called with
+ * mempool_mutex held */
+static void mempool_count(mempool_entry *entry, size_t resident) {
+    metrics_add(METRIC_MEMPOOL_RESIDENT,
+                (int64_t)resident - (int64_t)entry->resident);
+    entry->resident = resident;
+}
+
+/* Unlinks @entry, which must be idle; called with mempool_mutex held */
+static void mempool_unlink(mempool_entry *entry) {
+    mempool_entry **link = &mempool.entries;
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    mempool_count(entry, 0);
+    mempool.retained -= entry->size;
+    metrics_add(METRIC_MEMPOOL_RETAINED, -(int64_t)entry->size);
+}
+
+/* Unmaps a list of unlinked entries; called without mempool_mutex held */
+static void mempool_release_list(mempool_entry *victims) {
+    while (victims != NULL) {
+        mempool_entry *next = victims->next;
+        mempool_unmap(victims->memory, victims->size);
+        free(victims);
+        victims = next;
+    }
+}
+
+/*
+ * Releases idle matrices unused for idle_ms, oldest first, while more than
+ * the low watermark is idle, and advises the kernel to reclaim the rest of
+ * the cold ones. Called with mempool_mutex held.
+ * @return The unlinked entries, to unmap with mempool_release_list()
+ */
+static mempool_entry *mempool_trim(uint64_t now) {
+    mempool_entry *victims = NULL, *entry;
+    uint64_t cold = (uint64_t)mempool.config.idle_ms * 1000;
+
+    if (!mempool.enabled || mempool.config.idle_ms == 0) {
+        return NULL;
+    }
+    while (mempool.retained > mempool.config.low_watermark) {
+        mempool_entry *oldest = NULL;
+        for (entry = mempool.entries; entry != NULL; entry = entry->next) {
+            if (!entry->in_use && now - entry->last_used >= cold &&
+                (oldest == NULL || entry->last_used < oldest->last_used)) {
+                oldest = entry;
+            }
+        }
+        if (oldest == NULL) {
+            break;
+        }
+        mempool_unlink(oldest);
+        oldest->next = victims;
+        victims = oldest;
+    }
+    for (entry = mempool.entries; entry != NULL; entry = entry->next) {
+        if (!entry->in_use && !entry->advised &&
+            now - entry->last_used >= cold) {
+            mempool_advise(entry->memory, entry->size);
+            entry->advised = 1;
+            if (!mempool.trimmer) {
+                /* Nothing will watch the kernel reclaim the pages */
+                mempool_count(entry, 0);
+            }
+        }
+    }
+    return victims;
+}
+
+/* Adds an idle or in-use entry; called with mempool_mutex held */
+static void mempool_insert(mempool_entry *entry) {
+    entry->next = mempool.entries;
+    mempool.entries = entry;
+    entry->resident = 0;
+    mempool_count(entry, entry->size);
+    if (!entry->in_use) {
+        mempool.retained += entry->size;
+        metrics_add(METRIC_MEMPOOL_RETAINED, (int64_t)entry->size);
+    }
+}
+
+#if !defined(ARGON2_NO_THREADS)
+
+/*
+ * Maps idle matrices of the most recent size when demand rose since the last
+ * tick: as many as the rise, minus the warm idle ones already there, within
+ * the high watermark. Called with mempool_mutex held, which it drops while
+ * mapping.
+ */
+static void mempool_pregrow(void) {
+    uint32_t demand = mempool.in_use + sched_waiting();
+    uint32_t rise = demand > mempool.demand ? demand - mempool.demand : 0;
+    size_t size = mempool.last_size;
+    mempool_entry *entry;
+
+    mempool.demand = demand;
+    if (!mempool.config.pregrow || rise == 0 || size == 0) {
+        return;
+    }
+    for (entry = mempool.entries; entry != NULL && rise > 0;
+         entry = entry->next) {
+        if (!entry->in_use && !entry->advised && entry->size >= size &&
+            entry->size - size <= MEMPOOL_SLACK(size)) {
+            --rise;
+        }
+    }
+    while (rise-- > 0 && mempool.enabled &&
+           mempool.retained + size <= mempool.config.high_watermark) {
+        entry = malloc(sizeof(*entry));
+        if (entry == NULL) {
+            return;
+        }
+        MEMPOOL_UNLOCK();
+        entry->memory = mempool_map(size, 1);
+        MEMPOOL_LOCK();
+        if (entry->memory == NULL) {
+            free(entry);
+            return;
+        }
+        entry->size = size;
+        entry->in_use = 0;
+        entry->advised = 0;
+        entry->last_used = metrics_now();
+        mempool_insert(entry);
+    }
+}
+
+/*
+ * Updates the resident bytes of the advised idle matrices, which the kernel
+ * reclaims at its own pace. Called with mempool_mutex held.
+ */
+static void mempool_measure(void) {
+    mempool_entry *entry;
+    for (entry = mempool.entries; entry != NULL; entry = entry->next) {
+        if (!entry->in_use && entry->advised && entry->resident != 0) {
+            mempool_count(entry, mempool_resident_bytes(entry));
+        }
+    }
+}
+
+#ifdef _WIN32
+static unsigned __stdcall mempool_trimmer(void *arg)
+#else
+static void *mempool_trimmer(void *arg)
+#endif
+{
+    (void)arg;
+    MEMPOOL_LOCK();
+    for (;;) {
+        mempool_entry *victims;
+        argon2_cond_wait(&mempool_cond, &mempool_mutex, MEMPOOL_TICK_MS);
+        victims = mempool_trim(metrics_now());
+        mempool_measure();
+        mempool_pregrow();
+        if (victims != NULL) {
+            MEMPOOL_UNLOCK();
+            mempool_release_list(victims);
+            MEMPOOL_LOCK();
+        }
+    }
+    return 0;
+}
+
+/* Starts the background thread if the configuration needs it and it does
+ * not run; called with mempool_mutex held */
+static void mempool_start(void) {
+    argon2_thread_handle_t handle;
+
+    if (mempool.enabled && !mempool.trimmer &&
+        (mempool.config.idle_ms != 0 || mempool.config.pregrow)) {
+        mempool.trimmer =
+            argon2_thread_create(&handle, &mempool_trimmer, NULL) == 0;
+    }
+}
+
+static void mempool_lock(void) { argon2_mutex_lock(&mempool_mutex); }
+
+static void mempool_unlock(void) { argon2_mutex_unlock(&mempool_mutex); }
+
+/*
+ * Starts over in a forked child, which only has the thread that called
+ * fork(): the matrices in use belong to hashes of the parent's threads and
+ * are unmapped, the idle ones stay. The background thread starts again on
+ * the next matrix acquired.
+ */
+static void mempool_forked(void) {
+    mempool_entry **link = &mempool.entries, *entry;
+
+    argon2_mutex_init(&mempool_mutex);
+    argon2_cond_init(&mempool_cond);
+    while ((entry = *link) != NULL) {
+        if (entry->in_use) {
+            *link = entry->next;
+            mempool_count(entry, 0);
+            mempool_unmap(entry->memory, entry->size);
+            free(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+    mempool.in_use = 0;
+    mempool.demand = 0;
+    mempool.trimmer = 0;
+}
+
+static argon2_once_t mempool_once = ARGON2_ONCE_INIT;
+
+static void mempool_register(void) {
+    /* The background thread asks the scheduler for the hashes waiting with
+     * mempool_mutex held */
+    sched_atfork();
+    argon2_thread_atfork(mempool_lock, mempool_unlock, mempool_forked);
+}
+
+static void mempool_atfork(void) {
+    argon2_thread_once(&mempool_once, mempool_register);
+}
+
+#else
+
+static void mempool_start(void) {}
+
+static void mempool_atfork(void) {}
+
+#endif /* ARGON2_NO_THREADS */
+
+void *mempool_acquire(size_t size) {
+    mempool_entry *entry, *best = NULL, *victims;
+    void *memory;
+
+    mempool_atfork();
+    MEMPOOL_LOCK();
+    if (!mempool.enabled) {
+        MEMPOOL_UNLOCK();
+        return NULL;
+    }
+    mempool_start();
+    mempool.last_size = size;
+    for (entry = mempool.entries; entry != NULL; entry = entry->next) {
+        if (!entry->in_use && entry->size >= size &&
+            entry->size - size <= MEMPOOL_SLACK(size) &&
+            (best == NULL || entry->size < best->size)) {
+            best = entry;
+        }
+    }
+    if (best != NULL) {
+        best->in_use = 1;
+        best->advised = 0;
+        mempool_count(best, best->size);
+        mempool.retained -= best->size;
+        metrics_add(METRIC_MEMPOOL_RETAINED, -(int64_t)best->size);
+        metrics_add(METRIC_MEMPOOL_HITS, 1);
+        ++mempool.in_use;
+        memory = best->memory;
+    } else {
+        MEMPOOL_UNLOCK();
+        entry = malloc(sizeof(*entry));
+        memory = entry != NULL ? mempool_map(size, 0) : NULL;
+        if (memory == NULL) {
+            free(entry);
+            return NULL;
+        }
+        entry->memory = memory;
+        entry->size = size;
+        entry->in_use = 1;
+        entry->advised = 0;
+        entry->last_used = 0;
+        MEMPOOL_LOCK();
+        mempool_insert(entry);
+        metrics_add(METRIC_MEMPOOL_MISSES, 1);
+        ++mempool.in_use;
+    }
+    victims = mempool.trimmer ? NULL : mempool_trim(metrics_now());
+    MEMPOOL_UNLOCK();
+    mempool_release_list(victims);
+    return memory;
+}
+
+int mempool_release(void *memory, size_t size) {
+    mempool_entry *entry, *victims = NULL;
+
+    MEMPOOL_LOCK();
+    for (entry = mempool.entries; entry != NULL; entry = entry->next) {
+        if (entry->memory == memory && entry->in_use) {
+            break;
+        }
+    }
+    if (entry == NULL) {
+        MEMPOOL_UNLOCK();
+        return 0;
+    }
+    (void)size;
+    entry->in_use = 0;
+    entry->last_used = metrics_now();
+    --mempool.in_use;
+    mempool.retained += entry->size;
+    metrics_add(METRIC_MEMPOOL_RETAINED, (int64_t)entry->size);
+    if (!mempool.enabled ||
+        mempool.retained > mempool.config.high_watermark) {
+        mempool_unlink(entry);
+        entry->next = NULL;
+        victims = entry;
+    } else if (!mempool.trimmer) {
+        victims = mempool_trim(entry->last_used);
+    }
+    MEMPOOL_UNLOCK();
+    mempool_release_list(victims);
+    return 1;
+}
+
+int argon2_mempool_configure(const argon2_mempool_config *config) {
+    mempool_entry *victims = NULL, *entry, *next;
+
+    if (config != NULL && config->low_watermark > config->high_watermark) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    mempool_atfork();
+    MEMPOOL_LOCK();
+    if (config == NULL) {
+        mempool.enabled = 0;
+        for (entry = mempool.entries; entry != NULL; entry = next) {
+            next = entry->next;
+            if (!entry->in_use) {
+                mempool_unlink(entry);
+                entry->next = victims;
+                victims = entry;
+            }
+        }
+    } else {
+        mempool.enabled = 1;
+        mempool.config = *config;
+        mempool_start();
+    }
+    MEMPOOL_UNLOCK();
+    mempool_release_list(victims);
+    return ARGON2_OK;
+}
@@ -0,0 +1,41 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_MEMPOOL_H
+#define ARGON2_MEMPOOL_H
+
+#include <stddef.h>
+
+#include "argon2.h"
+
+/*
+ * Takes a matrix of at least @size bytes from the pool configured with
+ * argon2_mempool_configure(), mapping a new one if no idle matrix fits
+ * @param size Size of the matrix in bytes
+ * @return The matrix, or NULL if the pool is off or mapping failed
+ */
+ARGON2_LOCAL void *mempool_acquire(size_t size);
+
+/*
+ * Gives a matrix back to the pool, which keeps it or unmaps it
+ * @param memory The matrix, already wiped
+ * @param size Its size in bytes, as passed to mempool_acquire()
+ * @return 1 if @memory came from the pool, 0 otherwise
+ */
+ARGON2_LOCAL int mempool_release(void *memory, size_t size);
+
+#endif
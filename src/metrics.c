@@ -0,0 +1,357 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#if !defined(_WIN32) && !defined(ARGON2_AMALGAMATION)
+/* for clock_gettime() */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "metrics.h"
+#include "thread.h"
+
+/* Number of counter shards, a power of two */
+#if defined(ARGON2_NO_THREADS)
+#define METRICS_SHARDS 1
+#else
+#define METRICS_SHARDS 16
+#endif
+
+/*
+ * Each shard ends with two sequence words: writes to a shard increment
+ * METRICS_BEGUN before touching its counters and METRICS_ENDED after, so a
+ * snapshot that finds them equal before and after reading the counters has
+ * seen no write halfway, see argon2_metrics_snapshot()
+ */
+#define METRICS_BEGUN METRIC_COUNT
+#define METRICS_ENDED (METRIC_COUNT + 1)
+/* Shards span whole cache lines, and are aligned on them where the compiler
+ * can, so that they never share one */
+#define METRICS_SHARD_WORDS ((METRIC_COUNT + 2 + 7) & ~7)
+/* Consistent copies attempted before counters are taken as they come */
+#define METRICS_RETRIES 16
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define METRICS_THREAD_LOCAL __declspec(thread)
+#define METRICS_ALIGNED __declspec(align(64))
+#define METRICS_ADD(p, v) _InterlockedExchangeAdd64((volatile __int64 *)(p), (__int64)(v))
+#define METRICS_LOAD(p) ((uint64_t)_InterlockedOr64((volatile __int64 *)(p), 0))
+/* Interlocked operations are full barriers already */
+#define METRICS_ADD_RELEASE(p, v) METRICS_ADD(p, v)
+#define METRICS_LOAD_ACQUIRE(p) METRICS_LOAD(p)
+#define METRICS_FENCE_RELEASE() ((void)0)
+#define METRICS_FENCE_ACQUIRE() ((void)0)
+#elif defined(__GNUC__) && !defined(ARGON2_NO_THREADS)
+#define METRICS_THREAD_LOCAL __thread
+#define METRICS_ALIGNED __attribute__((aligned(64)))
+/* Only the sequence words order the counters */
+#define METRICS_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define METRICS_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define METRICS_ADD_RELEASE(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELEASE)
+#define METRICS_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define METRICS_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define METRICS_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif !defined(ARGON2_NO_THREADS)
+/* Unknown compiler with threads: no atomics, so a lock guards every access */
+static argon2_mutex_t metrics_mutex = ARGON2_MUTEX_INITIALIZER;
+
+static uint64_t metrics_locked_add(uint64_t *p, uint64_t v) {
+    uint64_t old;
+    argon2_mutex_lock(&metrics_mutex);
+    old = *p;
+    *p = old + v;
+    argon2_mutex_unlock(&metrics_mutex);
+    return old;
+}
+
+static uint64_t metrics_locked_load(const uint64_t *p) {
+    uint64_t value;
+    argon2_mutex_lock(&metrics_mutex);
+    value = *p;
+    argon2_mutex_unlock(&metrics_mutex);
+    return value;
+}
+
+#define METRICS_ADD(p, v) metrics_locked_add((p), (v))
+#define METRICS_LOAD(p) metrics_locked_load(p)
+#else
+/* Single-threaded: plain accesses on a single shard */
+#define METRICS_ADD(p, v) (*(p) += (v))
+#define METRICS_LOAD(p) (*(p))
+#endif
+
+#if !defined(METRICS_ADD_RELEASE)
+/* The lock orders every access, or there is a single thread */
+#define METRICS_ADD_RELEASE(p, v) METRICS_ADD(p, v)
+#define METRICS_LOAD_ACQUIRE(p) METRICS_LOAD(p)
+#define METRICS_FENCE_RELEASE() ((void)0)
+#define METRICS_FENCE_ACQUIRE() ((void)0)
+#endif
+#if !defined(METRICS_ALIGNED)
+#define METRICS_ALIGNED
+#endif
+
+/* For copies torn after all: an asynchronous verification may start and
+ * complete on the shards of different threads */
+#define METRICS_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static METRICS_ALIGNED uint64_t metrics_shards[METRICS_SHARDS]
+                                              [METRICS_SHARD_WORDS];
+
+#if defined(METRICS_THREAD_LOCAL) && METRICS_SHARDS > 1
+static uint64_t metrics_next_shard;
+/* Shard of the current thread plus one, 0 until assigned */
+static METRICS_THREAD_LOCAL unsigned metrics_thread_shard;
+
+static uint64_t *metrics_shard(void) {
+    if (metrics_thread_shard == 0) {
+        uint64_t next = METRICS_ADD(&metrics_next_shard, 1);
+        metrics_thread_shard = (unsigned)(next % METRICS_SHARDS) + 1;
+    }
+    return metrics_shards[metrics_thread_shard - 1];
+}
+#else
+static uint64_t *metrics_shard(void) { return metrics_shards[0]; }
+#endif
+
+uint64_t metrics_now(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)(count.QuadPart / freq.QuadPart * 1000000 +
+                      count.QuadPart % freq.QuadPart * 1000000 /
+                          freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#else
+    return (uint64_t)clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+uint64_t metrics_cpu_time(void) {
+#if defined(_WIN32)
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel,
+                        &user)) {
+        return 0;
+    }
+    /* 100-nanosecond units */
+    return ((((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+            (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) *
+           100;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+void metrics_add_all(const enum argon2_metric *metrics, const int64_t *deltas,
+                     unsigned count) {
+    uint64_t *shard = metrics_shard();
+    unsigned i;
+
+    METRICS_ADD(&shard[METRICS_BEGUN], 1);
+    /* A snapshot that sees any of the counters below also sees BEGUN */
+    METRICS_FENCE_RELEASE();
+    for (i = 0; i < count; ++i) {
+        /* Gauges go down through unsigned wrap-around */
+        METRICS_ADD(&shard[metrics[i]], (uint64_t)deltas[i]);
+    }
+    METRICS_ADD_RELEASE(&shard[METRICS_ENDED], 1);
+}
+
+void metrics_add(enum argon2_metric metric, int64_t delta) {
+    metrics_add_all(&metric, &delta, 1);
+}
+
+int64_t metrics_load(enum argon2_metric metric) {
+    uint64_t sum = 0;
+    unsigned s;
+
+    for (s = 0; s < METRICS_SHARDS; ++s) {
+        sum += METRICS_LOAD(&metrics_shards[s][metric]);
+    }
+    return (int64_t)sum;
+}
+
+static int valid_type(argon2_type type) {
+    return type == Argon2_d || type == Argon2_i || type == Argon2_id;
+}
+
+uint64_t metrics_begin(argon2_metrics_op op, argon2_type type) {
+    if (valid_type(type)) {
+        metrics_add(op == METRICS_OP_HASH ? METRIC_HASHES_STARTED + type
+                                          : METRIC_VERIFIES_STARTED + type,
+                    1);
+    }
+    return metrics_now();
+}
+
+void metrics_end(argon2_metrics_op op, argon2_type type, int result,
+                 uint64_t started) {
+    static const int64_t ones[3] = {1, 1, 1};
+    enum argon2_metric counted[3];
+    uint64_t elapsed = metrics_now() - started;
+    unsigned bucket = 0, count = 0;
+
+    while (elapsed > 1 && bucket < ARGON2_METRICS_LATENCY_BUCKETS - 1) {
+        elapsed >>= 1;
+        ++bucket;
+    }
+
+    if (result != ARGON2_OK) {
+        if (result < 0 && result > -ARGON2_METRICS_ERRORS) {
+            counted[count++] = (enum argon2_metric)(METRIC_FAILURES - result);
+        } else {
+            /* Out-of-range codes share the slot of code 0 */
+            counted[count++] = METRIC_FAILURES;
+        }
+    }
+
+    if (op == METRICS_OP_HASH) {
+        counted[count++] = (enum argon2_metric)(METRIC_HASH_LATENCY + bucket);
+        if (valid_type(type)) {
+            counted[count++] =
+                (enum argon2_metric)(METRIC_HASHES_COMPLETED + type);
+        }
+    } else {
+        counted[count++] =
+            (enum argon2_metric)(METRIC_VERIFY_LATENCY + bucket);
+        if (valid_type(type)) {
+            counted[count++] =
+                (enum argon2_metric)(METRIC_VERIFIES_COMPLETED + type);
+        }
+    }
+    /* A snapshot sees the completion, its latency and its failure at once */
+    metrics_add_all(counted, ones, count);
+}
+
+/*
+ * Copies shard @s into @copy with no write of it halfway, unless writes keep
+ * coming through METRICS_RETRIES attempts
+ * @return The writes the copy has seen, or (uint64_t)-1 if it is torn
+ */
+static uint64_t metrics_copy_shard(unsigned s, uint64_t *copy) {
+    const uint64_t *shard = metrics_shards[s];
+    uint64_t ended = 0;
+    unsigned attempt;
+    int m;
+
+    for (attempt = 0; attempt < METRICS_RETRIES; ++attempt) {
+        ended = METRICS_LOAD_ACQUIRE(&shard[METRICS_ENDED]);
+        /* Completed counters before started ones: should the copy be torn
+         * after all, a start is seen whenever its completion is */
+        for (m = METRIC_COUNT - 1; m >= 0; --m) {
+            copy[m] = METRICS_LOAD(&shard[m]);
+        }
+        /* A write whose counters were seen has its BEGUN seen below */
+        METRICS_FENCE_ACQUIRE();
+        if (METRICS_LOAD(&shard[METRICS_BEGUN]) == ended) {
+            return ended;
+        }
+    }
+    return (uint64_t)-1;
+}
+
+/*
+ * Sums the shards into @sums. Each shard is copied with no write halfway;
+ * if no write began on any shard between its copy and the end, which is
+ * checked METRICS_RETRIES times at most, the sum is the state of all of
+ * them at that instant.
+ */
+static void metrics_copy(uint64_t *sums) {
+    uint64_t copy[METRIC_COUNT], seen[METRICS_SHARDS];
+    unsigned attempt, s;
+    int m, consistent = 0;
+
+    for (attempt = 0; attempt < METRICS_RETRIES && !consistent; ++attempt) {
+        memset(sums, 0, METRIC_COUNT * sizeof(*sums));
+        for (s = 0; s < METRICS_SHARDS; ++s) {
+            seen[s] = metrics_copy_shard(s, copy);
+            for (m = 0; m < METRIC_COUNT; ++m) {
+                sums[m] += copy[m];
+            }
+        }
+        consistent = 1;
+        for (s = 0; s < METRICS_SHARDS; ++s) {
+            if (METRICS_LOAD(&metrics_shards[s][METRICS_BEGUN]) != seen[s]) {
+                consistent = 0;
+            }
+        }
+    }
+}
+
+void argon2_metrics_snapshot(argon2_metrics *metrics) {
+    uint64_t sums[METRIC_COUNT];
+    unsigned i;
+
+    if (metrics == NULL) {
+        return;
+    }
+
+    metrics_copy(sums);
+
+    memset(metrics, 0, sizeof(*metrics));
+    for (i = 0; i < ARGON2_METRICS_TYPES; ++i) {
+        metrics->hashes_started[i] = sums[METRIC_HASHES_STARTED + i];
+        metrics->hashes_completed[i] =
+            METRICS_MIN(sums[METRIC_HASHES_COMPLETED + i],
+                        metrics->hashes_started[i]);
+        metrics->verifies_started[i] = sums[METRIC_VERIFIES_STARTED + i];
+        metrics->verifies_completed[i] =
+            METRICS_MIN(sums[METRIC_VERIFIES_COMPLETED + i],
+                        metrics->verifies_started[i]);
+    }
+    for (i = 0; i < ARGON2_METRICS_ERRORS; ++i) {
+        metrics->failures[i] = sums[METRIC_FAILURES + i];
+    }
+    metrics->bytes_allocated = (int64_t)sums[METRIC_BYTES_ALLOCATED];
+    metrics->pool_occupancy = (int64_t)sums[METRIC_POOL_OCCUPANCY];
+    metrics->queue_depth = (int64_t)sums[METRIC_QUEUE_DEPTH];
+    metrics->lock_failures = sums[METRIC_LOCK_FAILURES];
+    metrics->sched_running = (int64_t)sums[METRIC_SCHED_RUNNING];
+    metrics->sched_limit = (int64_t)sums[METRIC_SCHED_LIMIT];
+    metrics->pool_steals = sums[METRIC_POOL_STEALS];
+    metrics->mempool_retained = (int64_t)sums[METRIC_MEMPOOL_RETAINED];
+    metrics->mempool_resident = (int64_t)sums[METRIC_MEMPOOL_RESIDENT];
+    metrics->mempool_hits = sums[METRIC_MEMPOOL_HITS];
+    metrics->mempool_misses = sums[METRIC_MEMPOOL_MISSES];
+    metrics->memory_pressure = (int64_t)sums[METRIC_MEMORY_PRESSURE];
+    metrics->pressure_throttles = sums[METRIC_PRESSURE_THROTTLES];
+    metrics->upgrades_pending = (int64_t)sums[METRIC_UPGRADES_PENDING];
+    metrics->verify_coalesced = sums[METRIC_VERIFY_COALESCED];
+    metrics->verify_batches = sums[METRIC_VERIFY_BATCHES];
+    metrics->verify_batched = sums[METRIC_VERIFY_BATCHED];
+    for (i = 0; i < ARGON2_METRICS_LATENCY_BUCKETS; ++i) {
+        metrics->hash_latency[i] = sums[METRIC_HASH_LATENCY + i];
+        metrics->verify_latency[i] = sums[METRIC_VERIFY_LATENCY + i];
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_METRICS_H
+#define ARGON2_METRICS_H
+
+#include "argon2.h"
+
+/*
+ * Library-wide metrics registry. Every counter is sharded: each thread adds
+ * to the shard it was assigned on first use, so concurrent hashes touch
+ * different cache lines, and argon2_metrics_snapshot() sums the shards.
+ * Writes to a shard are bracketed by a sequence count, for the snapshot to
+ * tell a consistent copy from a torn one.
+ */
+
+/* Counter indices; per-type and per-bucket counters occupy consecutive slots */
+enum argon2_metric {
+    METRIC_HASHES_STARTED = 0,
+    METRIC_HASHES_COMPLETED = METRIC_HASHES_STARTED + ARGON2_METRICS_TYPES,
+    METRIC_VERIFIES_STARTED = METRIC_HASHES_COMPLETED + ARGON2_METRICS_TYPES,
+    METRIC_VERIFIES_COMPLETED = METRIC_VERIFIES_STARTED + ARGON2_METRICS_TYPES,
+    METRIC_FAILURES = METRIC_VERIFIES_COMPLETED + ARGON2_METRICS_TYPES,
+    METRIC_BYTES_ALLOCATED = METRIC_FAILURES + ARGON2_METRICS_ERRORS,
+    METRIC_POOL_OCCUPANCY,
+    METRIC_QUEUE_DEPTH,
+    METRIC_LOCK_FAILURES,
+    METRIC_SCHED_RUNNING,
+    METRIC_SCHED_LIMIT,
+    METRIC_POOL_STEALS,
+    METRIC_MEMPOOL_RETAINED,
+    METRIC_MEMPOOL_RESIDENT,
+    METRIC_MEMPOOL_HITS,
+    METRIC_MEMPOOL_MISSES,
+    METRIC_MEMORY_PRESSURE,
+    METRIC_PRESSURE_THROTTLES,
+    METRIC_UPGRADES_PENDING,
+    METRIC_VERIFY_COALESCED,
+    METRIC_VERIFY_BATCHES,
+    METRIC_VERIFY_BATCHED,
+    /* Hashes of tenant 0 admitted without the scheduler lock, see
+     * sched_admit(): their share of argon2_tenant_metrics */
+    METRIC_TENANT0_RUNNING,
+    METRIC_TENANT0_MEMORY,
+    METRIC_TENANT0_ADMITTED,
+    METRIC_TENANT0_CPU_TIME,
+    METRIC_TENANT0_ALLOCATED,
+    METRIC_TENANT0_BLOCKS,
+    METRIC_HASH_LATENCY,
+    METRIC_VERIFY_LATENCY =
+        METRIC_HASH_LATENCY + ARGON2_METRICS_LATENCY_BUCKETS,
+    METRIC_COUNT = METRIC_VERIFY_LATENCY + ARGON2_METRICS_LATENCY_BUCKETS
+};
+
+/* Kinds of operations timed by metrics_begin() and metrics_end() */
+typedef enum Argon2_metrics_op {
+    METRICS_OP_HASH = 0,
+    METRICS_OP_VERIFY = 1
+} argon2_metrics_op;
+
+/*
+ * Returns a monotonic timestamp in microseconds
+ */
+ARGON2_LOCAL uint64_t metrics_now(void);
+
+/*
+ * Returns the CPU time consumed so far by the calling thread in nanoseconds,
+ * or 0 where the system does not measure it
+ */
+ARGON2_LOCAL uint64_t metrics_cpu_time(void);
+
+/*
+ * Adds @delta to counter or gauge @metric with an atomic increment on the
+ * calling thread's shard
+ */
+ARGON2_LOCAL void metrics_add(enum argon2_metric metric, int64_t delta);
+
+/*
+ * Adds @deltas[i] to @metrics[i] for the @count metrics given, which
+ * argon2_metrics_snapshot() sees all at once or not at all
+ */
+ARGON2_LOCAL void metrics_add_all(const enum argon2_metric *metrics,
+                                  const int64_t *deltas, unsigned count);
+
+/*
+ * Returns the sum of counter or gauge @metric over the shards
+ */
+ARGON2_LOCAL int64_t metrics_load(enum argon2_metric metric);
+
+/*
+ * Counts an operation as started
+ * @param op Operation kind
+ * @param type Argon2 type of the operation
+ * @return Timestamp to pass on to metrics_end()
+ */
+ARGON2_LOCAL uint64_t metrics_begin(argon2_metrics_op op, argon2_type type);
+
+/*
+ * Counts an operation as completed, records its latency and, if @result is
+ * not ARGON2_OK, a failure with that error code
+ * @param started Value returned by the matching metrics_begin()
+ */
+ARGON2_LOCAL void metrics_end(argon2_metrics_op op, argon2_type type,
+                              int result, uint64_t started);
+
+#endif
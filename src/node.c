@@ -0,0 +1,181 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2-node.h"
+
+/*
+ * Hashing node: serves argon2_client requests until SIGINT or SIGTERM, see
+ * argon2_server_start()
+ */
+
+#define PORT_DEF 7420
+#define BATCH_DEF 8
+
+static void usage(const char *cmd) {
+    printf("Usage:  %s [-h] [-l address] [-p port] [-m log2(memory)] "
+           "[-t iterations] [-n lanes] [-k connections] [-T tenant] [-a] "
+           "[-c concurrency] [-b window]\n",
+           cmd);
+    printf("Parameters:\n");
+    printf("\t-l address\tListens on this address (default 127.0.0.1); "
+           "requests are\n\t\t\tneither authenticated nor encrypted\n");
+    printf("\t-p N\t\tListens on TCP port N, 0 for any (default %d)\n",
+           PORT_DEF);
+    printf("\t-m N\t\tRefuses hashes of more than 2^N KiB (default 20)\n");
+    printf("\t-t N\t\tRefuses hashes of more than N iterations "
+           "(default 16)\n");
+    printf("\t-n N\t\tRefuses hashes of more than N lanes (default 16)\n");
+    printf("\t-k N\t\tServes at most N connections at once "
+           "(default 256)\n");
+    printf("\t-T N\t\tAccounts requests to tenant N (default 0)\n");
+    printf("\t-a\t\tAccounts requests to the tenant they name instead; "
+           "only for\n\t\t\tclients trusted to name it\n");
+    printf("\t-c N\t\tRuns at most N hashes at once, queuing the others "
+           "(default one per processor, no queue)\n");
+    printf("\t-b N\t\tBatches verifications arriving within N "
+           "microseconds (default no batching)\n");
+    printf("\t-h\t\tPrint %s usage\n", cmd);
+}
+
+static void fatal(const char *error) {
+    fprintf(stderr, "Error: %s\n", error);
+    exit(1);
+}
+
+static unsigned long number(const char *arg, const char *option) {
+    char *end;
+    unsigned long value;
+
+    if (arg == NULL) {
+        fprintf(stderr, "Error: missing %s argument\n", option);
+        exit(1);
+    }
+    value = strtoul(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value > UINT32_MAX) {
+        fprintf(stderr, "Error: bad %s argument\n", option);
+        exit(1);
+    }
+    return value;
+}
+
+int main(int argc, char *argv[]) {
+    argon2_server *server;
+    argon2_server_config config;
+    argon2_sched_config sched;
+    argon2_batch_config batch;
+    argon2_metrics metrics;
+    uint64_t hashes = 0, verifies = 0;
+    sigset_t signals;
+    int i, received, result;
+
+    memset(&config, 0, sizeof(config));
+    config.port = PORT_DEF;
+    memset(&sched, 0, sizeof(sched));
+    memset(&batch, 0, sizeof(batch));
+    for (i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "-h")) {
+            usage(argv[0]);
+            return 0;
+        } else if (!strcmp(a, "-l")) {
+            if (value == NULL) {
+                fatal("missing -l argument");
+            }
+            config.address = value;
+            ++i;
+        } else if (!strcmp(a, "-p")) {
+            config.port = (unsigned)number(value, "-p");
+            if (config.port > 65535) {
+                fatal("bad -p argument");
+            }
+            ++i;
+        } else if (!strcmp(a, "-m")) {
+            unsigned long m_cost = number(value, "-m");
+            if (m_cost > 31) {
+                fatal("bad -m argument");
+            }
+            config.max_m_cost = (uint32_t)1 << m_cost;
+            ++i;
+        } else if (!strcmp(a, "-t")) {
+            config.max_t_cost = (uint32_t)number(value, "-t");
+            ++i;
+        } else if (!strcmp(a, "-n")) {
+            config.max_lanes = (uint32_t)number(value, "-n");
+            ++i;
+        } else if (!strcmp(a, "-k")) {
+            config.max_connections = (uint32_t)number(value, "-k");
+            ++i;
+        } else if (!strcmp(a, "-T")) {
+            config.tenant = (uint32_t)number(value, "-T");
+            ++i;
+        } else if (!strcmp(a, "-a")) {
+            config.trust_tenants = 1;
+        } else if (!strcmp(a, "-c")) {
+            sched.max_concurrency = (uint32_t)number(value, "-c");
+            ++i;
+        } else if (!strcmp(a, "-b")) {
+            batch.window_us = (uint32_t)number(value, "-b");
+            batch.max_batch = BATCH_DEF;
+            ++i;
+        } else {
+            fatal("unknown argument");
+        }
+    }
+
+    /* The library threads started from here on leave these signals to
+     * sigwait(); writes to closed connections return an error instead */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (sched.max_concurrency != 0 && argon2_sched_configure(&sched) != 0) {
+        fatal("cannot configure admission control");
+    }
+    if (batch.max_batch != 0 && argon2_batch_configure(&batch) != 0) {
+        fatal("cannot configure batching");
+    }
+    result = argon2_server_start(&server, &config);
+    if (result != ARGON2_OK) {
+        fatal(argon2_error_message(result));
+    }
+    printf("Listening on port %u\n", argon2_server_port(server));
+    fflush(stdout);
+
+    sigwait(&signals, &received);
+    argon2_server_stop(server);
+
+    argon2_metrics_snapshot(&metrics);
+    for (i = 0; i < ARGON2_METRICS_TYPES; ++i) {
+        hashes += metrics.hashes_completed[i];
+        verifies += metrics.verifies_completed[i];
+    }
+    printf("Served %lu hashes and %lu verifications\n",
+           (unsigned long)hashes, (unsigned long)verifies);
+    return 0;
+}
@@ -25,19 +25,37 @@
 #include "blake2/blake2.h"
 #include "blake2/blamka-round-opt.h"
 
+#ifdef ACCESS_TRACE
+#include "access.h"
+#endif
+
+/* SIMD word the state of the compression function is held in */
+#if defined(__AVX512F__)
+typedef __m512i state_word;
+#define STATE_WORDS ARGON2_512BIT_WORDS_IN_BLOCK
+#elif defined(__AVX2__)
+typedef __m256i state_word;
+#define STATE_WORDS ARGON2_HWORDS_IN_BLOCK
+#else
+typedef __m128i state_word;
+#define STATE_WORDS ARGON2_OWORDS_IN_BLOCK
+#endif
+
 /*
- * Function fills a new memory block and optionally XORs the old block over the new one.
- * Memory must be initialized.
+ * First half of filling a block: XORs the reference block (and, with
+ * @with_xor, the block to be overwritten) into @state and runs the
+ * permutation. fill_block_store() completes the block.
  * @param state Pointer to the just produced block. Content will be updated(!)
  * @param ref_block Pointer to the reference block
  * @param next_block Pointer to the block to be XORed over. May coincide with @ref_block
  * @param with_xor Whether to XOR into the new block (1) or just overwrite (0)
+ * @param block_XY Where to keep the input of the permutation
  * @pre all block pointers must be valid
  */
 #if defined(__AVX512F__)
-static void fill_block(__m512i *state, const block *ref_block,
-                       block *next_block, int with_xor) {
-    __m512i block_XY[ARGON2_512BIT_WORDS_IN_BLOCK];
+static void fill_block_mix(__m512i *state, const block *ref_block,
+                           const block *next_block, int with_xor,
+                           __m512i *block_XY) {
     unsigned int i;
 
     if (with_xor) {
@@ -65,16 +83,32 @@ static void fill_block(__m512i *state, const block *ref_block,
             state[2 * 0 + i], state[2 * 1 + i], state[2 * 2 + i], state[2 * 3 + i],
             state[2 * 4 + i], state[2 * 5 + i], state[2 * 6 + i], state[2 * 7 + i]);
     }
+}
+
+/* Second half of filling a block: the final XOR, and the stores */
+static void fill_block_store(__m512i *state, const __m512i *block_XY,
+                             block *next_block) {
+    unsigned int i;
 
     for (i = 0; i < ARGON2_512BIT_WORDS_IN_BLOCK; i++) {
         state[i] = _mm512_xor_si512(state[i], block_XY[i]);
         _mm512_storeu_si512((__m512i *)next_block->v + i, state[i]);
     }
 }
+
+/* First 64-bit word of the block fill_block_store() is about to store */
+static uint64_t fill_block_word0(const __m512i *state,
+                                 const __m512i *block_XY) {
+    uint64_t word;
+    _mm_storel_epi64((__m128i *)&word,
+                     _mm512_castsi512_si128(
+                         _mm512_xor_si512(state[0], block_XY[0])));
+    return word;
+}
 #elif defined(__AVX2__)
-static void fill_block(__m256i *state, const block *ref_block,
-                       block *next_block, int with_xor) {
-    __m256i block_XY[ARGON2_HWORDS_IN_BLOCK];
+static void fill_block_mix(__m256i *state, const block *ref_block,
+                           const block *next_block, int with_xor,
+                           __m256i *block_XY) {
     unsigned int i;
 
     if (with_xor) {
@@ -100,16 +134,30 @@ static void fill_block(__m256i *state, const block *ref_block,
         BLAKE2_ROUND_2(state[ 0 + i], state[ 4 + i], state[ 8 + i], state[12 + i],
                        state[16 + i], state[20 + i], state[24 + i], state[28 + i]);
     }
+}
+
+static void fill_block_store(__m256i *state, const __m256i *block_XY,
+                             block *next_block) {
+    unsigned int i;
 
     for (i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {
         state[i] = _mm256_xor_si256(state[i], block_XY[i]);
         _mm256_storeu_si256((__m256i *)next_block->v + i, state[i]);
     }
 }
+
+static uint64_t fill_block_word0(const __m256i *state,
+                                 const __m256i *block_XY) {
+    uint64_t word;
+    _mm_storel_epi64((__m128i *)&word,
+                     _mm256_castsi256_si128(
+                         _mm256_xor_si256(state[0], block_XY[0])));
+    return word;
+}
 #else
-static void fill_block(__m128i *state, const block *ref_block,
-                       block *next_block, int with_xor) {
-    __m128i block_XY[ARGON2_OWORDS_IN_BLOCK];
+static void fill_block_mix(__m128i *state, const block *ref_block,
+                           const block *next_block, int with_xor,
+                           __m128i *block_XY) {
     unsigned int i;
 
     if (with_xor) {
@@ -137,26 +185,55 @@ static void fill_block(__m128i *state, const block *ref_block,
             state[8 * 3 + i], state[8 * 4 + i], state[8 * 5 + i],
             state[8 * 6 + i], state[8 * 7 + i]);
     }
+}
+
+static void fill_block_store(__m128i *state, const __m128i *block_XY,
+                             block *next_block) {
+    unsigned int i;
 
     for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {
         state[i] = _mm_xor_si128(state[i], block_XY[i]);
         _mm_storeu_si128((__m128i *)next_block->v + i, state[i]);
     }
 }
+
+static uint64_t fill_block_word0(const __m128i *state,
+                                 const __m128i *block_XY) {
+    uint64_t word;
+    _mm_storel_epi64((__m128i *)&word, _mm_xor_si128(state[0], block_XY[0]));
+    return word;
+}
 #endif
 
+/*
+ * Function fills a new memory block and optionally XORs the old block over the new one.
+ * Memory must be initialized.
+ * @param state Pointer to the just produced block. Content will be updated(!)
+ * @param ref_block Pointer to the reference block
+ * @param next_block Pointer to the block to be XORed over. May coincide with @ref_block
+ * @param with_xor Whether to XOR into the new block (1) or just overwrite (0)
+ * @pre all block pointers must be valid
+ */
+static void fill_block(state_word *state, const block *ref_block,
+                       block *next_block, int with_xor) {
+    state_word block_XY[STATE_WORDS];
+
+    fill_block_mix(state, ref_block, next_block, with_xor, block_XY);
+    fill_block_store(state, block_XY, next_block);
+}
+
+/* Starts fetching a block from memory into the cache */
+static void prefetch_block(const block *b) {
+    unsigned int i;
+    for (i = 0; i < ARGON2_BLOCK_SIZE; i += 64) {
+        _mm_prefetch((const char *)b->v + i, _MM_HINT_T0);
+    }
+}
+
 static void next_addresses(block *address_block, block *input_block) {
     /*Temporary zero-initialized blocks*/
-#if defined(__AVX512F__)
-    __m512i zero_block[ARGON2_512BIT_WORDS_IN_BLOCK];
-    __m512i zero2_block[ARGON2_512BIT_WORDS_IN_BLOCK];
-#elif defined(__AVX2__)
-    __m256i zero_block[ARGON2_HWORDS_IN_BLOCK];
-    __m256i zero2_block[ARGON2_HWORDS_IN_BLOCK];
-#else
-    __m128i zero_block[ARGON2_OWORDS_IN_BLOCK];
-    __m128i zero2_block[ARGON2_OWORDS_IN_BLOCK];
-#endif
+    state_word zero_block[STATE_WORDS];
+    state_word zero2_block[STATE_WORDS];
 
     memset(zero_block, 0, sizeof(zero_block));
     memset(zero2_block, 0, sizeof(zero2_block));
@@ -171,21 +248,45 @@ static void next_addresses(block *address_block, block *input_block) {
     fill_block(zero2_block, address_block, address_block, 0);
 }
 
+/*
+ * Locates the reference block of the block at @position->index
+ * @param pseudo_rand Pseudo-random value of the block, from the address
+ * block or from the first word of the previous block
+ */
+static block *reference_block(const argon2_instance_t *instance,
+                              const argon2_position_t *position,
+                              uint64_t pseudo_rand) {
+    uint64_t ref_index, ref_lane;
+
+    /* 1.2.2 Computing the lane of the reference block */
+    ref_lane = ((pseudo_rand >> 32)) % instance->lanes;
+
+    if ((position->pass == 0) && (position->slice == 0)) {
+        /* Can not reference other lanes yet */
+        ref_lane = position->lane;
+    }
+
+    /* 1.2.3 Computing the number of possible reference block within the
+     * lane.
+     */
+    ref_index = index_alpha(instance, position, pseudo_rand & 0xFFFFFFFF,
+                            ref_lane == position->lane);
+#ifdef ACCESS_TRACE
+    access_block(instance, position, (uint32_t)ref_lane, (uint32_t)ref_index);
+#endif
+
+    return block_at(instance, (uint32_t)ref_lane, (uint32_t)ref_index);
+}
+
 void fill_segment(const argon2_instance_t *instance,
                   argon2_position_t position) {
-    block *ref_block = NULL, *curr_block = NULL;
+    block *ref_block = NULL, *curr_block = NULL, *prev_block = NULL;
     block address_block, input_block;
-    uint64_t pseudo_rand, ref_index, ref_lane;
-    uint32_t prev_offset, curr_offset;
+    uint32_t curr_index;
     uint32_t starting_index, i;
-#if defined(__AVX512F__)
-    __m512i state[ARGON2_512BIT_WORDS_IN_BLOCK];
-#elif defined(__AVX2__)
-    __m256i state[ARGON2_HWORDS_IN_BLOCK];
-#else
-    __m128i state[ARGON2_OWORDS_IN_BLOCK];
-#endif
-    int data_independent_addressing;
+    state_word state[STATE_WORDS];
+    state_word block_XY[STATE_WORDS];
+    int data_independent_addressing, with_xor;
 
     if (instance == NULL) {
         return;
@@ -197,6 +298,7 @@ void fill_segment(const argon2_instance_t *instance,
          (position.slice < ARGON2_SYNC_POINTS / 2));
 
     if (data_independent_addressing) {
+        init_block_value(&address_block, 0);
         init_block_value(&input_block, 0);
 
         input_block.v[0] = position.pass;
@@ -218,66 +320,65 @@ void fill_segment(const argon2_instance_t *instance,
         }
     }
 
-    /* Offset of the current block */
-    curr_offset = position.lane * instance->lane_length +
-                  position.slice * instance->segment_length + starting_index;
+    /* version 1.2.1 and earlier overwrite rather than XOR, and so does the
+     * first pass */
+    with_xor = ARGON2_VERSION_10 != instance->version && 0 != position.pass;
 
-    if (0 == curr_offset % instance->lane_length) {
+    /* Current block and the one before it in the lane. Only the blocks of
+     * a segment are known to be contiguous, whatever the layout */
+    curr_index = position.slice * instance->segment_length + starting_index;
+    curr_block = block_at(instance, position.lane, curr_index);
+    if (0 == curr_index) {
         /* Last block in this lane */
-        prev_offset = curr_offset + instance->lane_length - 1;
+        prev_block =
+            block_at(instance, position.lane, instance->lane_length - 1);
     } else {
         /* Previous block */
-        prev_offset = curr_offset - 1;
+        prev_block = block_at(instance, position.lane, curr_index - 1);
     }
 
-    memcpy(state, ((instance->memory + prev_offset)->v), ARGON2_BLOCK_SIZE);
-
-    for (i = starting_index; i < instance->segment_length;
-         ++i, ++curr_offset, ++prev_offset) {
-        /*1.1 Rotating prev_offset if needed */
-        if (curr_offset % instance->lane_length == 1) {
-            prev_offset = curr_offset - 1;
-        }
+    memcpy(state, prev_block->v, ARGON2_BLOCK_SIZE);
 
-        /* 1.2 Computing the index of the reference block */
-        /* 1.2.1 Taking pseudo-random value from the previous block */
-        if (data_independent_addressing) {
+    if (data_independent_addressing) {
+        for (i = starting_index; i < instance->segment_length;
+             ++i, curr_block++) {
+            /* 1.2 Computing the index of the reference block */
+            /* 1.2.1 Taking pseudo-random value from the address block */
             if (i % ARGON2_ADDRESSES_IN_BLOCK == 0) {
                 next_addresses(&address_block, &input_block);
             }
-            pseudo_rand = address_block.v[i % ARGON2_ADDRESSES_IN_BLOCK];
-        } else {
-            pseudo_rand = instance->memory[prev_offset].v[0];
-        }
-
-        /* 1.2.2 Computing the lane of the reference block */
-        ref_lane = ((pseudo_rand >> 32)) % instance->lanes;
+            position.index = i;
+            ref_block = reference_block(
+                instance, &position,
+                address_block.v[i % ARGON2_ADDRESSES_IN_BLOCK]);
 
-        if ((position.pass == 0) && (position.slice == 0)) {
-            /* Can not reference other lanes yet */
-            ref_lane = position.lane;
+            /* 2 Creating a new block */
+            fill_block(state, ref_block, curr_block, with_xor);
         }
+        return;
+    }
 
-        /* 1.2.3 Computing the number of possible reference block within the
-         * lane.
-         */
-        position.index = i;
-        ref_index = index_alpha(instance, &position, pseudo_rand & 0xFFFFFFFF,
-                                ref_lane == position.lane);
-
-        /* 2 Creating a new block */
-        ref_block =
-            instance->memory + instance->lane_length * ref_lane + ref_index;
-        curr_block = instance->memory + curr_offset;
-        if (ARGON2_VERSION_10 == instance->version) {
-            /* version 1.2.1 and earlier: overwrite, not XOR */
-            fill_block(state, ref_block, curr_block, 0);
-        } else {
-            if(0 == position.pass) {
-                fill_block(state, ref_block, curr_block, 0);
-            } else {
-                fill_block(state, ref_block, curr_block, 1);
-            }
+    /*
+     * Data-dependent addressing: the pseudo-random value of a block is the
+     * first word of the block before it. It is taken from the registers as
+     * soon as the permutation is done, and the next reference block
+     * prefetched, before the new block is stored: its cache misses then
+     * overlap with the stores instead of following them.
+     */
+    position.index = starting_index;
+    ref_block = reference_block(instance, &position, prev_block->v[0]);
+    for (i = starting_index; i < instance->segment_length;
+         ++i, curr_block++) {
+        block *next_ref_block = NULL;
+
+        fill_block_mix(state, ref_block, curr_block, with_xor, block_XY);
+        if (i + 1 < instance->segment_length) {
+            position.index = i + 1;
+            next_ref_block = reference_block(
+                instance, &position, fill_block_word0(state, block_XY));
+            prefetch_block(next_ref_block);
         }
+        fill_block_store(state, block_XY, curr_block);
+        ref_block = next_ref_block;
     }
 }
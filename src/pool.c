@@ -0,0 +1,614 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#if !defined(_WIN32) && defined(__linux__)
+#if !defined(ARGON2_AMALGAMATION)
+/* for sched_getaffinity() */
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "core.h"
+#include "metrics.h"
+#include "pool.h"
+#include "thread.h"
+#include "trace.h"
+
+/* L2 cache size assumed when the system does not report it, in KiB */
+#define POOL_DEFAULT_L2 256
+/* Segment blocks handed out at once: about 100 us of work, which keeps the
+ * locking and wake-ups per task negligible when segments are short */
+#define POOL_TASK_BLOCKS 256
+/* Tasks a worker must have left for an idle one to steal from it */
+#define POOL_STEAL_IMBALANCE 2
+
+#if !defined(ARGON2_NO_THREADS)
+
+/* A processor the pool may run on */
+typedef struct pool_cpu {
+    unsigned cpu;     /* processor number */
+    unsigned core;    /* lowest-numbered SMT sibling, identifies the core */
+    unsigned sibling; /* rank among the siblings of its core */
+} pool_cpu;
+
+/*
+ * The lanes of one slice of one hash. Each hash gets its own window of
+ * @width consecutive ranks in the job's placement, starting at @base and
+ * wrapping around, chosen on its first slice where the fewest other jobs
+ * run. Lane l belongs to the worker at position l % width of the window, so
+ * that in every slice of every pass it runs on the same worker and core,
+ * where the blocks it wrote last are still cached. Workers fill their own
+ * lanes front to back. An idle worker of the window steals from the back of
+ * the largest share with at least POOL_STEAL_IMBALANCE tasks left, or with
+ * its owner held up by another job; any other idle worker only steals in the
+ * latter case, standing in for the owner. A task is @batch lanes of one
+ * share, POOL_TASK_BLOCKS blocks in all when segments are short.
+ */
+typedef struct pool_job {
+    argon2_instance_t *instance;
+    uint32_t pass;
+    uint8_t slice;
+    argon2_placement placement; /* PACK or SPREAD */
+    uint32_t base;              /* rank of the first worker of the window */
+    uint32_t width;             /* workers allowed to take lanes */
+    uint32_t batch;             /* lanes per task */
+    uint32_t *front, *back;     /* per rank, lanes taken from either end */
+    uint32_t unclaimed;         /* lanes not handed out yet */
+    uint32_t pending;           /* lanes not filled yet */
+    struct pool_job *next;
+} pool_job;
+
+typedef struct pool_worker {
+    argon2_thread_handle_t handle;
+    unsigned cpu;
+    /* position in the order of each placement: a worker owns lanes of a job
+     * if its rank in the job's placement falls in the job's window */
+    uint32_t rank[ARGON2_PLACEMENT_SPREAD + 1];
+    uint32_t load; /* jobs in progress whose window it is in */
+    pool_job *job; /* job of the lane being filled, NULL when idle */
+    argon2_cond_t wake;
+} pool_worker;
+
+static argon2_mutex_t pool_mutex = ARGON2_MUTEX_INITIALIZER;
+static argon2_cond_t pool_done = ARGON2_COND_INITIALIZER;
+
+static struct {
+    int state; /* 0 until started, then 1, or -1 if no worker started */
+    argon2_placement placement;
+    uint32_t l2_kib;
+    uint32_t nworkers;
+    uint32_t next_base; /* where the search for the next window starts */
+    pool_worker *workers;
+    uint32_t *order[ARGON2_PLACEMENT_SPREAD + 1]; /* worker index by rank */
+    pool_job *head, *tail; /* jobs with lanes left to hand out */
+} pool;
+
+/* Reads the first number in a sysfs file, and the character following it */
+static int read_number(const char *path, unsigned *value, char *suffix) {
+    FILE *f = fopen(path, "r");
+    int ok;
+    if (f == NULL) {
+        return 0;
+    }
+    *suffix = '\n';
+    ok = fscanf(f, "%u%c", value, suffix) >= 1;
+    fclose(f);
+    return ok;
+}
+
+/* Size of the level 2 data or unified cache of cpu0: the cache index of
+ * each level varies between processors, so the levels are looked up */
+static uint32_t pool_l2_kib(void) {
+    unsigned index, level, size;
+    char unit, path[64], type[16];
+
+    for (index = 0; index < 8; ++index) {
+        FILE *f;
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%u/level",
+                index);
+        if (!read_number(path, &level, &unit)) {
+            break;
+        }
+        if (level != 2) {
+            continue;
+        }
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%u/type",
+                index);
+        f = fopen(path, "r");
+        if (f == NULL) {
+            continue;
+        }
+        type[0] = '\0';
+        if (fscanf(f, "%15s", type) != 1) {
+            type[0] = '\0';
+        }
+        fclose(f);
+        if (strcmp(type, "Instruction") == 0) {
+            continue;
+        }
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%u/size",
+                index);
+        if (read_number(path, &size, &unit) && size != 0) {
+            return unit == 'M' ? size * 1024 : size;
+        }
+    }
+    return POOL_DEFAULT_L2;
+}
+
+/*
+ * Lists the processors the process may run on, with the core each belongs
+ * to. Without topology information every processor is its own core.
+ * @param cpus Output, a malloc'ed array
+ * @return Number of processors, 0 on failure
+ */
+static size_t pool_topology(pool_cpu **cpus) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    size_t n = 0;
+    unsigned cpu;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+    *cpus = malloc(CPU_COUNT(&allowed) * sizeof(pool_cpu));
+    if (*cpus == NULL) {
+        return 0;
+    }
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        char path[64];
+        char sep;
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        (*cpus)[n].cpu = cpu;
+        sprintf(path,
+                "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list",
+                cpu);
+        if (!read_number(path, &(*cpus)[n].core, &sep)) {
+            (*cpus)[n].core = cpu;
+        }
+        (*cpus)[n].sibling = 0;
+        ++n;
+    }
+    return n;
+#else
+    size_t n = argon2_thread_cpus(), i;
+    *cpus = malloc(n * sizeof(pool_cpu));
+    if (*cpus == NULL) {
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        (*cpus)[i].cpu = (*cpus)[i].core = (unsigned)i;
+        (*cpus)[i].sibling = 0;
+    }
+    return n;
+#endif
+}
+
+/* Resolves ARGON2_PLACEMENT_AUTO; called with pool_mutex held */
+static argon2_placement pool_placement(uint32_t lane_kib) {
+    if (pool.placement != ARGON2_PLACEMENT_AUTO) {
+        return pool.placement;
+    }
+    if (pool.l2_kib == 0) {
+        pool.l2_kib = pool_l2_kib();
+    }
+    return lane_kib <= pool.l2_kib ? ARGON2_PLACEMENT_SPREAD
+                                   : ARGON2_PLACEMENT_PACK;
+}
+
+/* Worker at position @k of the window of @job */
+static pool_worker *pool_owner(const pool_job *job, uint32_t k) {
+    return &pool.workers[pool.order[job->placement]
+                                   [(job->base + k) % pool.nworkers]];
+}
+
+/* Position of @worker in the window of @job, @job->width or more if outside */
+static uint32_t pool_position(const pool_job *job, const pool_worker *worker) {
+    return (worker->rank[job->placement] + pool.nworkers - job->base) %
+           pool.nworkers;
+}
+
+/*
+ * Picks the window of a hash of @width lanes at a time: the one whose
+ * workers are in the fewest jobs, the first found from where the last
+ * window ended on ties. Called with pool_mutex held.
+ * @return The rank of the first worker of the window
+ */
+static uint32_t pool_window(argon2_placement placement, uint32_t width) {
+    uint32_t best = 0, best_load = 0, b, k;
+
+    for (b = 0; b < pool.nworkers; ++b) {
+        uint32_t base = (pool.next_base + b) % pool.nworkers, load = 0;
+        for (k = 0; k < width; ++k) {
+            load += pool.workers[pool.order[placement]
+                                           [(base + k) % pool.nworkers]]
+                        .load;
+        }
+        if (b == 0 || load < best_load) {
+            best = base;
+            best_load = load;
+        }
+    }
+    pool.next_base = (best + width) % pool.nworkers;
+    return best;
+}
+
+/* Lanes of position @k's share of @job not handed out yet */
+static uint32_t pool_left(const pool_job *job, uint32_t k) {
+    uint32_t share = (job->instance->lanes - k + job->width - 1) / job->width;
+    return share - job->front[k] - job->back[k];
+}
+
+/*
+ * Hands the next task to @self: its own lanes in any job first, otherwise
+ * stolen ones. Called with pool_mutex held.
+ * @param lane Output, the first lane of the task; the others follow in steps
+ * of the job's width
+ * @param count Output, the number of lanes in the task
+ * @return The job of the task, NULL if there is nothing to do
+ */
+static pool_job *pool_take(pool_worker *self, uint32_t *lane,
+                           uint32_t *count) {
+    pool_job *job, *victim_job = NULL;
+    uint32_t victim = 0, most = 0, k;
+
+    for (job = pool.head; job != NULL; job = job->next) {
+        uint32_t own = pool_position(job, self);
+        if (own < job->width && pool_left(job, own) > 0) {
+            *count = pool_left(job, own) < job->batch ? pool_left(job, own)
+                                                      : job->batch;
+            *lane = own + job->front[own] * job->width;
+            job->front[own] += *count;
+            break;
+        }
+        for (k = 0; k < job->width; ++k) {
+            uint32_t left = pool_left(job, k);
+            const pool_job *owner_job = pool_owner(job, k)->job;
+            if (left > most &&
+                ((own < job->width &&
+                  left >= POOL_STEAL_IMBALANCE * job->batch) ||
+                 (owner_job != NULL && owner_job != job))) {
+                victim_job = job;
+                victim = k;
+                most = left;
+            }
+        }
+    }
+    if (job == NULL) {
+        if (victim_job == NULL) {
+            return NULL;
+        }
+        job = victim_job;
+        *count = most < job->batch ? most : job->batch;
+        *lane = victim + (job->front[victim] + most - *count) * job->width;
+        job->back[victim] += *count;
+        metrics_add(METRIC_POOL_STEALS, *count);
+    }
+
+    job->unclaimed -= *count;
+    if (job->unclaimed == 0) {
+        pool_job **link = &pool.head;
+        pool_job *prev = NULL;
+        while (*link != job) {
+            prev = *link;
+            link = &(*link)->next;
+        }
+        *link = job->next;
+        if (pool.tail == job) {
+            pool.tail = prev;
+        }
+    }
+    return job;
+}
+
+#ifdef _WIN32
+static unsigned __stdcall pool_worker_main(void *arg)
+#else
+static void *pool_worker_main(void *arg)
+#endif
+{
+    pool_worker *self = arg;
+
+    argon2_thread_pin(self->cpu);
+    argon2_mutex_lock(&pool_mutex);
+    for (;;) {
+        argon2_position_t position;
+        uint32_t count, i;
+        pool_job *job = pool_take(self, &position.lane, &count);
+        uint64_t cpu_started;
+
+        self->job = job;
+        if (job == NULL) {
+            argon2_cond_wait(&self->wake, &pool_mutex, 0);
+            continue;
+        }
+        position.pass = job->pass;
+        position.slice = job->slice;
+        argon2_mutex_unlock(&pool_mutex);
+
+        metrics_add(METRIC_POOL_OCCUPANCY, 1);
+        cpu_started = metrics_cpu_time();
+        for (i = 0; i < count; ++i, position.lane += job->width) {
+            position.index = 0;
+            ARGON2_PROBE3(segment__start, position.pass, position.slice,
+                          position.lane);
+            fill_segment(job->instance, position);
+            ARGON2_PROBE3(segment__done, position.pass, position.slice,
+                          position.lane);
+        }
+        metrics_add(METRIC_POOL_OCCUPANCY, -1);
+
+        argon2_mutex_lock(&pool_mutex);
+        /* Charged to the hash before it can see the job done */
+        job->instance->cpu_time += metrics_cpu_time() - cpu_started;
+        job->pending -= count;
+        if (job->pending == 0) {
+            argon2_cond_broadcast(&pool_done);
+        }
+    }
+    return 0;
+}
+
+static void pool_lock(void) { argon2_mutex_lock(&pool_mutex); }
+
+static void pool_unlock(void) { argon2_mutex_unlock(&pool_mutex); }
+
+/*
+ * Forgets the workers in a forked child, which only has the thread that
+ * called fork(): the pool restarts on the next hash that needs it. The
+ * parent held pool_mutex across fork(), so no worker was in the middle of
+ * updating the pool.
+ */
+static void pool_forked(void) {
+    argon2_mutex_init(&pool_mutex);
+    argon2_cond_init(&pool_done);
+    free(pool.workers);
+    free(pool.order[ARGON2_PLACEMENT_PACK]);
+    free(pool.order[ARGON2_PLACEMENT_SPREAD]);
+    pool.workers = NULL;
+    pool.order[ARGON2_PLACEMENT_PACK] = NULL;
+    pool.order[ARGON2_PLACEMENT_SPREAD] = NULL;
+    pool.nworkers = 0;
+    pool.next_base = 0;
+    pool.head = pool.tail = NULL;
+    pool.state = 0;
+}
+
+static argon2_once_t pool_once = ARGON2_ONCE_INIT;
+
+static void pool_atfork(void) {
+    argon2_thread_atfork(pool_lock, pool_unlock, pool_forked);
+}
+
+/*
+ * Starts one worker pinned to each processor the process may run on, and
+ * orders them: PACK walks the cores filling every SMT sibling, SPREAD takes
+ * the first sibling of every core before any second one. Called with
+ * pool_mutex held, which the workers wait for before taking any job.
+ * @return Whether at least one worker runs
+ */
+static int pool_start(void) {
+    pool_cpu *cpus = NULL;
+    size_t n, i, j;
+
+    if (pool.state != 0) {
+        return pool.state > 0;
+    }
+    pool.state = -1;
+
+    n = pool_topology(&cpus);
+    if (n == 0) {
+        return 0;
+    }
+    pool.workers = calloc(n, sizeof(pool_worker));
+    pool.order[ARGON2_PLACEMENT_PACK] = calloc(n, sizeof(uint32_t));
+    pool.order[ARGON2_PLACEMENT_SPREAD] = calloc(n, sizeof(uint32_t));
+    if (pool.workers == NULL || pool.order[ARGON2_PLACEMENT_PACK] == NULL ||
+        pool.order[ARGON2_PLACEMENT_SPREAD] == NULL) {
+        free(pool.workers);
+        free(pool.order[ARGON2_PLACEMENT_PACK]);
+        free(pool.order[ARGON2_PLACEMENT_SPREAD]);
+        pool.workers = NULL;
+        pool.order[ARGON2_PLACEMENT_PACK] = NULL;
+        pool.order[ARGON2_PLACEMENT_SPREAD] = NULL;
+        free(cpus);
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        pool_worker *worker = &pool.workers[pool.nworkers];
+        worker->cpu = cpus[i].cpu;
+        if (argon2_cond_init(&worker->wake) != 0 ||
+            argon2_thread_create(&worker->handle, &pool_worker_main,
+                                 worker) != 0) {
+            continue;
+        }
+        cpus[pool.nworkers++] = cpus[i];
+    }
+
+    /* Rank the workers that did start */
+    for (i = 0; i < pool.nworkers; ++i) {
+        cpus[i].sibling = 0;
+        for (j = 0; j < i; ++j) {
+            cpus[i].sibling += cpus[j].core == cpus[i].core;
+        }
+    }
+    for (i = 0; i < pool.nworkers; ++i) {
+        uint32_t pack = 0, spread = 0;
+        for (j = 0; j < pool.nworkers; ++j) {
+            pack += cpus[j].core < cpus[i].core ||
+                    (cpus[j].core == cpus[i].core &&
+                     cpus[j].sibling < cpus[i].sibling);
+            spread += cpus[j].sibling < cpus[i].sibling ||
+                      (cpus[j].sibling == cpus[i].sibling &&
+                       cpus[j].core < cpus[i].core);
+        }
+        pool.workers[i].rank[ARGON2_PLACEMENT_PACK] = pack;
+        pool.workers[i].rank[ARGON2_PLACEMENT_SPREAD] = spread;
+        pool.order[ARGON2_PLACEMENT_PACK][pack] = (uint32_t)i;
+        pool.order[ARGON2_PLACEMENT_SPREAD][spread] = (uint32_t)i;
+    }
+    free(cpus);
+
+    if (pool.nworkers > 0) {
+        pool.state = 1;
+    }
+    return pool.state > 0;
+}
+
+int pool_fill_slice(argon2_instance_t *instance, uint32_t pass,
+                    uint8_t slice) {
+    pool_job job;
+    uint32_t i;
+    int held;
+
+    /* A slice that makes a single task is not worth a hand-off */
+    if ((uint64_t)instance->lanes * instance->segment_length <=
+        POOL_TASK_BLOCKS) {
+        argon2_position_t position;
+        position.pass = pass;
+        position.slice = slice;
+        for (position.lane = 0; position.lane < instance->lanes;
+             ++position.lane) {
+            position.index = 0;
+            ARGON2_PROBE3(segment__start, position.pass, position.slice,
+                          position.lane);
+            fill_segment(instance, position);
+            ARGON2_PROBE3(segment__done, position.pass, position.slice,
+                          position.lane);
+        }
+        return ARGON2_OK;
+    }
+
+    argon2_thread_once(&pool_once, pool_atfork);
+    argon2_mutex_lock(&pool_mutex);
+    if (!pool_start()) {
+        argon2_mutex_unlock(&pool_mutex);
+        return ARGON2_THREAD_FAIL;
+    }
+
+    job.instance = instance;
+    job.pass = pass;
+    job.slice = slice;
+    job.placement = pool_placement(instance->lane_length);
+    job.width = instance->threads < pool.nworkers ? instance->threads
+                                                  : pool.nworkers;
+    job.front = calloc(2 * job.width, sizeof(uint32_t));
+    if (job.front == NULL) {
+        argon2_mutex_unlock(&pool_mutex);
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    /* The window stays the same in every slice, for the lanes to stay on
+     * their workers */
+    if (instance->pool_base == 0 || instance->pool_base > pool.nworkers) {
+        instance->pool_base = pool_window(job.placement, job.width) + 1;
+    }
+    job.base = instance->pool_base - 1;
+    job.back = job.front + job.width;
+    job.batch = instance->segment_length < POOL_TASK_BLOCKS
+                    ? POOL_TASK_BLOCKS / instance->segment_length
+                    : 1;
+    job.unclaimed = job.pending = instance->lanes;
+    job.next = NULL;
+    if (pool.tail != NULL) {
+        pool.tail->next = &job;
+    } else {
+        pool.head = &job;
+    }
+    pool.tail = &job;
+
+    /* Wake the owners, and the idle workers outside the window if an owner
+     * is held up by another job */
+    held = 0;
+    for (i = 0; i < job.width; ++i) {
+        pool_worker *owner = pool_owner(&job, i);
+        ++owner->load;
+        held |= owner->job != NULL;
+        argon2_cond_broadcast(&owner->wake);
+    }
+    for (i = 0; held && i < pool.nworkers; ++i) {
+        if (pool.workers[i].job == NULL &&
+            pool_position(&job, &pool.workers[i]) >= job.width) {
+            argon2_cond_broadcast(&pool.workers[i].wake);
+        }
+    }
+    while (job.pending != 0) {
+        argon2_cond_wait(&pool_done, &pool_mutex, 0);
+    }
+    for (i = 0; i < job.width; ++i) {
+        --pool_owner(&job, i)->load;
+    }
+    argon2_mutex_unlock(&pool_mutex);
+    free(job.front);
+    return ARGON2_OK;
+}
+
+int argon2_set_placement(argon2_placement placement) {
+    switch (placement) {
+    case ARGON2_PLACEMENT_AUTO:
+    case ARGON2_PLACEMENT_PACK:
+    case ARGON2_PLACEMENT_SPREAD:
+        break;
+    default:
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    argon2_mutex_lock(&pool_mutex);
+    pool.placement = placement;
+    argon2_mutex_unlock(&pool_mutex);
+    return ARGON2_OK;
+}
+
+argon2_placement argon2_placement_for(uint32_t m_cost, uint32_t lanes) {
+    argon2_placement placement;
+    argon2_mutex_lock(&pool_mutex);
+    placement = pool_placement(lanes ? m_cost / lanes : m_cost);
+    argon2_mutex_unlock(&pool_mutex);
+    return placement;
+}
+
+#else /* ARGON2_NO_THREADS */
+
+int argon2_set_placement(argon2_placement placement) {
+    (void)placement;
+    return ARGON2_THREAD_FAIL;
+}
+
+argon2_placement argon2_placement_for(uint32_t m_cost, uint32_t lanes) {
+    (void)m_cost;
+    (void)lanes;
+    return ARGON2_PLACEMENT_AUTO;
+}
+
+#endif /* ARGON2_NO_THREADS */
+
+const char *argon2_placement2string(argon2_placement placement) {
+    switch (placement) {
+    case ARGON2_PLACEMENT_AUTO:
+        return "auto";
+    case ARGON2_PLACEMENT_PACK:
+        return "pack";
+    case ARGON2_PLACEMENT_SPREAD:
+        return "spread";
+    }
+    return NULL;
+}
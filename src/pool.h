@@ -0,0 +1,40 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_POOL_H
+#define ARGON2_POOL_H
+
+#include "core.h"
+
+#if !defined(ARGON2_NO_THREADS)
+
+/*
+ * Fills the segments of all lanes of one slice on the process-wide worker
+ * pool, on at most instance->threads workers placed according to the
+ * argon2_set_placement() policy. The pool is started on first use.
+ * @param instance Pointer to the current instance
+ * @param pass Pass number
+ * @param slice Slice number
+ * @return ARGON2_OK once every segment is filled, or ARGON2_THREAD_FAIL if no
+ * worker could be started
+ */
+ARGON2_LOCAL int pool_fill_slice(argon2_instance_t *instance, uint32_t pass,
+                                 uint8_t slice);
+
+#endif /* ARGON2_NO_THREADS */
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "thread.h"
+
+/* Polling period when none is configured, in milliseconds */
+#define PRESSURE_INTERVAL 1000
+/* Cgroup v2 hierarchy, where memory.pressure lives next to the other
+ * controller files of each cgroup */
+#define PRESSURE_CGROUP_ROOT "/sys/fs/cgroup"
+#define PRESSURE_SYSTEM "/proc/pressure/memory"
+
+#if !defined(ARGON2_NO_THREADS)
+
+static argon2_mutex_t pressure_mutex = ARGON2_MUTEX_INITIALIZER;
+static argon2_cond_t pressure_cond = ARGON2_COND_INITIALIZER;
+
+static struct {
+    int enabled;
+    argon2_pressure_config config;
+    char path[512];
+    int watcher;           /* whether the watcher thread runs */
+    uint32_t pressure;     /* last reading */
+    argon2_sched_throttle level;
+} pressure;
+
+/*
+ * Reads the "some avg10" figure of a PSI file
+ * @param path PSI file
+ * @param value Where to store the pressure, in hundredths of a percent
+ * @return 0 on success, -1 if the file cannot be read or parsed
+ */
+static int pressure_read(const char *path, uint32_t *value) {
+    char line[128];
+    unsigned int whole, hundredths;
+    int result = -1;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "some avg10=%u.%2u", &whole, &hundredths) == 2) {
+            *value = whole * 100 + hundredths;
+            result = 0;
+            break;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+/*
+ * Finds the memory.pressure file of the cgroup v2 the process belongs to,
+ * falling back to the system-wide one
+ * @param path Where to store the path
+ * @param size Size of @path
+ */
+static void pressure_locate(char *path, size_t size) {
+    char line[512];
+    uint32_t value;
+    FILE *file = fopen("/proc/self/cgroup", "r");
+
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file) != NULL) {
+            /* the unified hierarchy is listed as "0::/path" */
+            if (strncmp(line, "0::", 3) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                if (strlen(PRESSURE_CGROUP_ROOT) + strlen(line + 3) +
+                        strlen("/memory.pressure") < size) {
+                    sprintf(path, "%s%s/memory.pressure",
+                            PRESSURE_CGROUP_ROOT,
+                            strcmp(line + 3, "/") == 0 ? "" : line + 3);
+                    if (pressure_read(path, &value) == 0) {
+                        fclose(file);
+                        return;
+                    }
+                }
+                break;
+            }
+        }
+        fclose(file);
+    }
+    strcpy(path, PRESSURE_SYSTEM);
+}
+
+/*
+ * Moves between throttling levels: up as soon as a threshold is crossed,
+ * down once pressure is below 3/4 of the threshold of the current level.
+ * Called with pressure_mutex held.
+ */
+static argon2_sched_throttle pressure_level(uint32_t value) {
+    uint32_t slow = pressure.config.slow_threshold;
+    uint32_t stop = pressure.config.stop_threshold;
+    argon2_sched_throttle level = pressure.level;
+
+    if (stop != 0 && value > stop) {
+        return ARGON2_SCHED_STOP;
+    }
+    if (level == ARGON2_SCHED_STOP &&
+        (stop == 0 || (uint64_t)value * 4 < (uint64_t)stop * 3)) {
+        level = ARGON2_SCHED_SLOW;
+    }
+    if (slow != 0 && value > slow) {
+        return level > ARGON2_SCHED_SLOW ? level : ARGON2_SCHED_SLOW;
+    }
+    if (level == ARGON2_SCHED_SLOW &&
+        (slow == 0 || (uint64_t)value * 4 < (uint64_t)slow * 3)) {
+        level = ARGON2_SCHED_NORMAL;
+    }
+    return level;
+}
+
+/* Takes one reading and applies it; called with pressure_mutex held */
+static void pressure_poll(void) {
+    uint32_t value = 0;
+    argon2_sched_throttle level;
+
+    /* A file that went away means no information, hence no throttling */
+    if (pressure_read(pressure.path, &value) != 0) {
+        value = 0;
+    }
+    metrics_add(METRIC_MEMORY_PRESSURE,
+                (int64_t)value - (int64_t)pressure.pressure);
+    pressure.pressure = value;
+
+    level = pressure_level(value);
+    if (level != pressure.level) {
+        if (level > pressure.level) {
+            metrics_add(METRIC_PRESSURE_THROTTLES, 1);
+        }
+        pressure.level = level;
+        sched_throttle(level);
+    }
+}
+
+#ifdef _WIN32
+static unsigned __stdcall pressure_watcher(void *arg)
+#else
+static void *pressure_watcher(void *arg)
+#endif
+{
+    (void)arg;
+    argon2_mutex_lock(&pressure_mutex);
+    for (;;) {
+        if (pressure.enabled) {
+            pressure_poll();
+            argon2_cond_wait(&pressure_cond, &pressure_mutex,
+                             pressure.config.interval_ms);
+        } else {
+            argon2_cond_wait(&pressure_cond, &pressure_mutex, 0);
+        }
+    }
+    return 0;
+}
+
+static void pressure_lock(void) { argon2_mutex_lock(&pressure_mutex); }
+
+static void pressure_unlock(void) { argon2_mutex_unlock(&pressure_mutex); }
+
+/*
+ * Turns the watching off in a forked child, which only has the thread that
+ * called fork(): without the watcher thread, a throttle inherited from the
+ * parent would never be lifted. The child configures it again if it wants
+ * it.
+ */
+static void pressure_forked(void) {
+    argon2_mutex_init(&pressure_mutex);
+    argon2_cond_init(&pressure_cond);
+    pressure.watcher = 0;
+    if (pressure.enabled) {
+        pressure.enabled = 0;
+        metrics_add(METRIC_MEMORY_PRESSURE, -(int64_t)pressure.pressure);
+        pressure.pressure = 0;
+        pressure.level = ARGON2_SCHED_NORMAL;
+        sched_throttle(ARGON2_SCHED_NORMAL);
+    }
+}
+
+static argon2_once_t pressure_once = ARGON2_ONCE_INIT;
+
+static void pressure_register(void) {
+    /* The scheduler is throttled with pressure_mutex held, and its handler
+     * resets it before this one runs in the child */
+    sched_atfork();
+    argon2_thread_atfork(pressure_lock, pressure_unlock, pressure_forked);
+}
+
+int argon2_pressure_configure(const argon2_pressure_config *config) {
+    char path[sizeof(pressure.path)];
+    uint32_t value;
+    argon2_thread_handle_t handle;
+    int result = ARGON2_OK;
+
+    if (config != NULL) {
+        if (config->path != NULL) {
+            if (strlen(config->path) >= sizeof(path)) {
+                return ARGON2_PRESSURE_UNAVAILABLE;
+            }
+            strcpy(path, config->path);
+        } else {
+            pressure_locate(path, sizeof(path));
+        }
+        if (pressure_read(path, &value) != 0) {
+            return ARGON2_PRESSURE_UNAVAILABLE;
+        }
+    }
+
+    argon2_thread_once(&pressure_once, pressure_register);
+    argon2_mutex_lock(&pressure_mutex);
+    if (config == NULL) {
+        pressure.enabled = 0;
+        metrics_add(METRIC_MEMORY_PRESSURE, -(int64_t)pressure.pressure);
+        pressure.pressure = 0;
+        pressure.level = ARGON2_SCHED_NORMAL;
+        sched_throttle(ARGON2_SCHED_NORMAL);
+    } else {
+        pressure.config = *config;
+        if (pressure.config.interval_ms == 0) {
+            pressure.config.interval_ms = PRESSURE_INTERVAL;
+        }
+        strcpy(pressure.path, path);
+        pressure.enabled = 1;
+        /* Apply the new thresholds at once rather than after a period */
+        pressure_poll();
+        if (!pressure.watcher) {
+            if (argon2_thread_create(&handle, &pressure_watcher, NULL) == 0) {
+                pressure.watcher = 1;
+            } else {
+                pressure.enabled = 0;
+                pressure.level = ARGON2_SCHED_NORMAL;
+                sched_throttle(ARGON2_SCHED_NORMAL);
+                result = ARGON2_THREAD_FAIL;
+            }
+        }
+    }
+    argon2_cond_broadcast(&pressure_cond);
+    argon2_mutex_unlock(&pressure_mutex);
+    return result;
+}
+
+#else /* ARGON2_NO_THREADS */
+
+int argon2_pressure_configure(const argon2_pressure_config *config) {
+    (void)config;
+    return ARGON2_THREAD_FAIL;
+}
+
+#endif /* ARGON2_NO_THREADS */
@@ -26,6 +26,9 @@
 #include "blake2/blake2-impl.h"
 #include "blake2/blake2.h"
 
+#ifdef ACCESS_TRACE
+#include "access.h"
+#endif
 
 /*
  * Function fills a new memory block and optionally XORs the old block over the new one.
@@ -89,10 +92,10 @@ static void next_addresses(block *address_block, block *input_block,
 
 void fill_segment(const argon2_instance_t *instance,
                   argon2_position_t position) {
-    block *ref_block = NULL, *curr_block = NULL;
+    block *ref_block = NULL, *curr_block = NULL, *prev_block = NULL;
     block address_block, input_block, zero_block;
     uint64_t pseudo_rand, ref_index, ref_lane;
-    uint32_t prev_offset, curr_offset;
+    uint32_t curr_index;
     uint32_t starting_index;
     uint32_t i;
     int data_independent_addressing;
@@ -129,25 +132,21 @@ void fill_segment(const argon2_instance_t *instance,
         }
     }
 
-    /* Offset of the current block */
-    curr_offset = position.lane * instance->lane_length +
-                  position.slice * instance->segment_length + starting_index;
-
-    if (0 == curr_offset % instance->lane_length) {
+    /* Current block and the one before it in the lane. Only the blocks of
+     * a segment are known to be contiguous, whatever the layout */
+    curr_index = position.slice * instance->segment_length + starting_index;
+    curr_block = block_at(instance, position.lane, curr_index);
+    if (0 == curr_index) {
         /* Last block in this lane */
-        prev_offset = curr_offset + instance->lane_length - 1;
+        prev_block =
+            block_at(instance, position.lane, instance->lane_length - 1);
     } else {
         /* Previous block */
-        prev_offset = curr_offset - 1;
+        prev_block = block_at(instance, position.lane, curr_index - 1);
     }
 
     for (i = starting_index; i < instance->segment_length;
-         ++i, ++curr_offset, ++prev_offset) {
-        /*1.1 Rotating prev_offset if needed */
-        if (curr_offset % instance->lane_length == 1) {
-            prev_offset = curr_offset - 1;
-        }
-
+         ++i, prev_block = curr_block++) {
         /* 1.2 Computing the index of the reference block */
         /* 1.2.1 Taking pseudo-random value from the previous block */
         if (data_independent_addressing) {
@@ -156,7 +155,7 @@ void fill_segment(const argon2_instance_t *instance,
             }
             pseudo_rand = address_block.v[i % ARGON2_ADDRESSES_IN_BLOCK];
         } else {
-            pseudo_rand = instance->memory[prev_offset].v[0];
+            pseudo_rand = prev_block->v[0];
         }
 
         /* 1.2.2 Computing the lane of the reference block */
@@ -173,21 +172,21 @@ void fill_segment(const argon2_instance_t *instance,
         position.index = i;
         ref_index = index_alpha(instance, &position, pseudo_rand & 0xFFFFFFFF,
                                 ref_lane == position.lane);
+#ifdef ACCESS_TRACE
+        access_block(instance, &position, (uint32_t)ref_lane,
+                     (uint32_t)ref_index);
+#endif
 
         /* 2 Creating a new block */
-        ref_block =
-            instance->memory + instance->lane_length * ref_lane + ref_index;
-        curr_block = instance->memory + curr_offset;
+        ref_block = block_at(instance, (uint32_t)ref_lane, (uint32_t)ref_index);
         if (ARGON2_VERSION_10 == instance->version) {
             /* version 1.2.1 and earlier: overwrite, not XOR */
-            fill_block(instance->memory + prev_offset, ref_block, curr_block, 0);
+            fill_block(prev_block, ref_block, curr_block, 0);
         } else {
             if(0 == position.pass) {
-                fill_block(instance->memory + prev_offset, ref_block,
-                           curr_block, 0);
+                fill_block(prev_block, ref_block, curr_block, 0);
             } else {
-                fill_block(instance->memory + prev_offset, ref_block,
-                           curr_block, 1);
+                fill_block(prev_block, ref_block, curr_block, 1);
             }
         }
     }
@@ -0,0 +1,916 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "core.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "thread.h"
+
+/* Shortest throughput measurement window, in microseconds */
+#define SCHED_WINDOW 100000
+/* Throughput gain, in percent, for which one more concurrent hash pays off */
+#define SCHED_GAIN 5
+/* Measurement windows to stay at the saturation point before probing again */
+#define SCHED_HOLD 50
+/* Memory traffic per block computed: the reference block and (after the first
+ * pass) the overwritten block are read, the new block is written */
+#define SCHED_BYTES_PER_BLOCK (3 * ARGON2_BLOCK_SIZE)
+/* Deficit round-robin credit of a tenant of weight 1 per turn, in blocks
+ * computed: a 4 MiB single-pass hash */
+#define SCHED_QUANTUM 4096
+/* Initial buckets of the tenant table, a power of two; the table doubles
+ * whenever tenants outnumber its buckets twice */
+#define SCHED_TENANT_BUCKETS 64
+/* Tenants without configuration tracked apart; the hashes of any others are
+ * accounted to tenant 0, so that tenant ids coming from the network cannot
+ * grow the table without bound */
+#define SCHED_TENANTS_MAX 4096
+
+#if !defined(ARGON2_NO_THREADS)
+
+static argon2_mutex_t sched_mutex = ARGON2_MUTEX_INITIALIZER;
+static argon2_cond_t sched_cond = ARGON2_COND_INITIALIZER;
+
+/* A tenant, its admitted hashes and its queue of waiting ones */
+typedef struct Argon2_sched_tenant {
+    uint32_t id;
+    argon2_tenant_config config;
+    int configured;   /* whether argon2_tenant_configure() set it */
+    uint32_t running; /* hashes admitted and not released */
+    uint64_t memory;  /* blocks they hold */
+    argon2_sched_ticket *head, *tail; /* waiting, in arrival order */
+    uint64_t deficit; /* deficit round-robin credit, in blocks computed */
+    int turn;         /* whether it was credited since it came first */
+    struct Argon2_sched_tenant *next_active; /* in the round-robin order */
+    struct Argon2_sched_tenant *next;        /* in its bucket */
+    argon2_tenant_metrics metrics;
+} argon2_sched_tenant;
+
+static struct {
+    int enabled;
+    argon2_sched_config config;
+
+    uint32_t limit;    /* how many hashes may run, as last published */
+    uint32_t adaptive; /* limit found by hill climbing */
+    uint32_t running;
+    uint32_t waiting;  /* hashes queued across tenants */
+
+    uint64_t window_start;  /* current measurement window */
+    uint64_t window_blocks; /* blocks completed in it */
+    int window_saturated;   /* whether some hash had to wait in it */
+    uint64_t throughput;    /* blocks/s of the last window that counted */
+    int probing;            /* whether the limit was just raised */
+    uint32_t hold;          /* windows left before the next probe */
+    uint64_t hash_rate;     /* blocks/s of a single hash, moving average */
+
+    argon2_sched_throttle throttle; /* set by the memory pressure watcher */
+
+    /* Tenants with hashes waiting, the one whose turn it is first */
+    argon2_sched_tenant *active, *active_tail;
+    uint32_t active_count;
+    argon2_sched_tenant tenant0; /* hashes without a tenant */
+    argon2_sched_tenant **tenants; /* table of the others, by id */
+    uint32_t buckets;              /* size of the table */
+    uint32_t tenant_count;         /* tenants in it */
+    uint32_t unconfigured;         /* those without configuration */
+} sched;
+
+/* Whether hashes of tenant 0 are granted without sched_mutex: nothing can
+ * hold them back while admission control is off and tenant 0 has no caps,
+ * which is the default. Their counts go to the METRIC_TENANT0_* shards
+ * instead of the tenant, and they do not count against caps set while they
+ * run. Written with sched_mutex held. */
+static int sched_gate = 1;
+
+static void sched_update_gate(void) {
+    argon2_atomic_store(&sched_gate,
+                        !sched.enabled &&
+                            sched.tenant0.config.max_concurrency == 0 &&
+                            sched.tenant0.config.max_memory == 0);
+}
+
+/* Grants @ticket at once, without sched_mutex, if sched_gate allows it
+ * @return Whether it was granted */
+static int sched_fast(argon2_sched_ticket *ticket, uint32_t memory_blocks) {
+    static const enum argon2_metric admitted[3] = {
+        METRIC_TENANT0_RUNNING, METRIC_TENANT0_MEMORY, METRIC_TENANT0_ADMITTED};
+    int64_t deltas[3];
+
+    if (ticket->tenant_id != 0 || !argon2_atomic_load(&sched_gate)) {
+        return 0;
+    }
+    ticket->tenant = &sched.tenant0;
+    ticket->blocks = memory_blocks;
+    ticket->fast = 1;
+    ticket->granted = 1;
+    deltas[0] = 1;
+    deltas[1] = (int64_t)memory_blocks;
+    deltas[2] = 1;
+    /* One sequenced write to the shard rather than three */
+    metrics_add_all(admitted, deltas, 3);
+    return 1;
+}
+
+/* Doubles the tenant table, or creates it; on failure the table keeps its
+ * size and chains grow longer. Called with sched_mutex held. */
+static void sched_grow(void) {
+    uint32_t buckets = sched.buckets ? sched.buckets * 2 : SCHED_TENANT_BUCKETS;
+    argon2_sched_tenant **tenants = calloc(buckets, sizeof(*tenants));
+    argon2_sched_tenant *tenant, *next;
+    uint32_t i;
+
+    if (tenants == NULL) {
+        return;
+    }
+    for (i = 0; i < sched.buckets; ++i) {
+        for (tenant = sched.tenants[i]; tenant != NULL; tenant = next) {
+            next = tenant->next;
+            tenant->next = tenants[tenant->id & (buckets - 1)];
+            tenants[tenant->id & (buckets - 1)] = tenant;
+        }
+    }
+    free(sched.tenants);
+    sched.tenants = tenants;
+    sched.buckets = buckets;
+}
+
+/*
+ * Finds tenant @id; called with sched_mutex held
+ * @param create 0 to only look it up, 1 to create it unless there are
+ * SCHED_TENANTS_MAX tenants without configuration already, 2 to create it
+ * regardless
+ * @return The tenant, or NULL if it was not found or created
+ */
+static argon2_sched_tenant *sched_tenant(uint32_t id, int create) {
+    argon2_sched_tenant *tenant;
+    argon2_sched_tenant **bucket;
+
+    if (id == 0) {
+        tenant = &sched.tenant0;
+        if (tenant->config.weight == 0) {
+            tenant->config.weight = 1;
+        }
+        return tenant;
+    }
+    if (sched.buckets != 0) {
+        tenant = sched.tenants[id & (sched.buckets - 1)];
+        for (; tenant != NULL; tenant = tenant->next) {
+            if (tenant->id == id) {
+                return tenant;
+            }
+        }
+    }
+    if (create == 0 ||
+        (create == 1 && sched.unconfigured >= SCHED_TENANTS_MAX)) {
+        return NULL;
+    }
+    if (sched.tenant_count >= sched.buckets * 2) {
+        sched_grow();
+        if (sched.buckets == 0) {
+            return NULL;
+        }
+    }
+    tenant = calloc(1, sizeof(*tenant));
+    if (tenant != NULL) {
+        bucket = &sched.tenants[id & (sched.buckets - 1)];
+        tenant->id = id;
+        tenant->config.weight = 1;
+        tenant->next = *bucket;
+        *bucket = tenant;
+        ++sched.tenant_count;
+        ++sched.unconfigured;
+    }
+    return tenant;
+}
+
+/* Reasons for a waiting hash not to start */
+enum { SCHED_FITS = 0, SCHED_TENANT_FULL = 1, SCHED_LIMIT_FULL = 2 };
+
+/* Checks the caps of its tenant, then the limit; called with sched_mutex
+ * held */
+static int sched_fits(const argon2_sched_ticket *ticket) {
+    const argon2_sched_tenant *tenant = ticket->tenant;
+
+    /* A tenant's first hash always fits its caps, however large */
+    if (tenant->running > 0 &&
+        ((tenant->config.max_concurrency != 0 &&
+          tenant->running >= tenant->config.max_concurrency) ||
+         (tenant->config.max_memory != 0 &&
+          tenant->memory + ticket->blocks > tenant->config.max_memory))) {
+        return SCHED_TENANT_FULL;
+    }
+    if (ticket->limited && sched.running >= sched.limit) {
+        return SCHED_LIMIT_FULL;
+    }
+    return SCHED_FITS;
+}
+
+/* Lets a hash start; called with sched_mutex held */
+static void sched_grant(argon2_sched_ticket *ticket, uint64_t now) {
+    argon2_sched_tenant *tenant = ticket->tenant;
+
+    ticket->granted = 1;
+    ticket->started = now;
+    if (ticket->limited) {
+        ++sched.running;
+        metrics_add(METRIC_SCHED_RUNNING, 1);
+        ticket->admitted = 1;
+    }
+    ++tenant->running;
+    tenant->memory += ticket->blocks;
+    ++tenant->metrics.running;
+    tenant->metrics.memory += (int64_t)ticket->blocks;
+    ++tenant->metrics.admitted;
+}
+
+/* Takes the first hash off the queue of its tenant and grants it, moving it
+ * to @ready if it was submitted; called with sched_mutex held */
+static void sched_dequeue(argon2_sched_tenant *tenant, uint64_t now,
+                          argon2_sched_ticket ***ready) {
+    argon2_sched_ticket *ticket = tenant->head;
+
+    tenant->head = ticket->next;
+    if (tenant->head == NULL) {
+        tenant->tail = NULL;
+    }
+    --sched.waiting;
+    metrics_add(METRIC_QUEUE_DEPTH, -1);
+    --tenant->metrics.queued;
+    ticket->usage.queue_time = now - ticket->queued;
+    tenant->metrics.queue_time += ticket->usage.queue_time;
+    sched_grant(ticket, now);
+
+    if (ticket->ready != NULL) {
+        ticket->next = NULL;
+        **ready = ticket;
+        *ready = &ticket->next;
+    }
+}
+
+/* Takes @tenant, which follows @prev (NULL if first), out of the
+ * round-robin order once its queue is empty; called with sched_mutex held */
+static void sched_deactivate(argon2_sched_tenant *tenant,
+                             argon2_sched_tenant *prev) {
+    if (prev == NULL) {
+        sched.active = tenant->next_active;
+    } else {
+        prev->next_active = tenant->next_active;
+    }
+    if (sched.active_tail == tenant) {
+        sched.active_tail = prev;
+    }
+    tenant->next_active = NULL;
+    tenant->deficit = 0;
+    tenant->turn = 0;
+    --sched.active_count;
+}
+
+/* Moves the first tenant to the back of the round-robin order; called with
+ * sched_mutex held */
+static void sched_rotate(void) {
+    argon2_sched_tenant *tenant = sched.active;
+
+    tenant->turn = 0;
+    if (tenant->next_active != NULL) {
+        sched.active = tenant->next_active;
+        tenant->next_active = NULL;
+        sched.active_tail->next_active = tenant;
+        sched.active_tail = tenant;
+    }
+}
+
+/*
+ * Credits at once the rounds in which no tenant could start its next hash:
+ * after a whole round without any, every tenant able to start gets the
+ * quanta that the one closest to its next hash still lacks, less the one
+ * its next turn brings. Called with sched_mutex held.
+ */
+static void sched_skip_rounds(void) {
+    argon2_sched_tenant *tenant;
+    uint64_t rounds = (uint64_t)-1, quantum, need;
+
+    for (tenant = sched.active; tenant != NULL; tenant = tenant->next_active) {
+        if (sched_fits(tenant->head) == SCHED_FITS &&
+            tenant->head->cost > tenant->deficit) {
+            quantum = (uint64_t)SCHED_QUANTUM * tenant->config.weight;
+            need = (tenant->head->cost - tenant->deficit + quantum - 1) /
+                   quantum;
+            if (need < rounds) {
+                rounds = need;
+            }
+        }
+    }
+    if (rounds == (uint64_t)-1) {
+        return;
+    }
+    for (tenant = sched.active; tenant != NULL; tenant = tenant->next_active) {
+        if (sched_fits(tenant->head) == SCHED_FITS) {
+            tenant->deficit +=
+                (rounds - 1) * SCHED_QUANTUM * tenant->config.weight;
+        }
+    }
+}
+
+/*
+ * Admits waiting hashes while they fit, by deficit round-robin: the tenant
+ * whose turn it is is credited SCHED_QUANTUM times its weight, and its
+ * hashes start in order while their cost (blocks computed) is covered; then
+ * the next tenant's turn comes. Tenants held back by their own caps are
+ * skipped. Once the head is held back by the limit, only the hashes of
+ * other tenants that do not count against it can start, out of turn.
+ * Called with sched_mutex held.
+ * @return Submitted hashes admitted, for sched_ready()
+ */
+static argon2_sched_ticket *sched_dispatch(void) {
+    argon2_sched_ticket *ready = NULL, **last = &ready;
+    argon2_sched_tenant *tenant, *prev, *next;
+    uint32_t skipped = 0, rotated = 0;
+    uint64_t now = metrics_now();
+    int granted = 0;
+
+    while ((tenant = sched.active) != NULL) {
+        int fits = sched_fits(tenant->head);
+
+        if (fits == SCHED_TENANT_FULL) {
+            if (++skipped >= sched.active_count) {
+                break;
+            }
+            sched_rotate();
+            continue;
+        }
+        if (fits == SCHED_LIMIT_FULL) {
+            for (prev = tenant, tenant = tenant->next_active;
+                 tenant != NULL; tenant = next) {
+                next = tenant->next_active;
+                while (tenant->head != NULL &&
+                       sched_fits(tenant->head) == SCHED_FITS) {
+                    tenant->deficit -= tenant->deficit < tenant->head->cost
+                                           ? tenant->deficit
+                                           : tenant->head->cost;
+                    sched_dequeue(tenant, now, &last);
+                    granted = 1;
+                }
+                if (tenant->head == NULL) {
+                    sched_deactivate(tenant, prev);
+                } else {
+                    prev = tenant;
+                }
+            }
+            break;
+        }
+
+        if (!tenant->turn) {
+            tenant->deficit +=
+                (uint64_t)SCHED_QUANTUM * tenant->config.weight;
+            tenant->turn = 1;
+        }
+        if (tenant->head->cost > tenant->deficit) {
+            sched_rotate();
+            if (++rotated + skipped >= sched.active_count) {
+                sched_skip_rounds();
+                rotated = 0;
+                skipped = 0;
+            }
+            continue;
+        }
+        tenant->deficit -= tenant->head->cost;
+        sched_dequeue(tenant, now, &last);
+        granted = 1;
+        skipped = 0;
+        rotated = 0;
+        if (tenant->head == NULL) {
+            sched_deactivate(tenant, NULL);
+        }
+    }
+
+    if (granted) {
+        argon2_cond_broadcast(&sched_cond);
+    }
+    return ready;
+}
+
+/* Hands admitted submissions on; called without sched_mutex */
+static void sched_ready(argon2_sched_ticket *ready) {
+    argon2_sched_ticket *next;
+    for (; ready != NULL; ready = next) {
+        next = ready->next;
+        ready->ready(ready);
+    }
+}
+
+/* Recomputes the limit; called with sched_mutex held */
+static void sched_update_limit(void) {
+    uint32_t limit = sched.config.max_concurrency;
+
+    if (sched.config.adaptive && sched.adaptive < limit) {
+        limit = sched.adaptive;
+    }
+
+    if (sched.config.bandwidth_cap && sched.hash_rate) {
+        uint64_t cap = (uint64_t)sched.config.bandwidth_cap * 1000000 /
+                       SCHED_BYTES_PER_BLOCK; /* in blocks/s */
+        uint64_t fits = cap / sched.hash_rate;
+        if (fits < limit) {
+            limit = fits > 0 ? (uint32_t)fits : 1;
+        }
+    }
+
+    if (sched.throttle == ARGON2_SCHED_STOP) {
+        limit = 0;
+    } else if (sched.throttle == ARGON2_SCHED_SLOW && limit > 1) {
+        limit = 1;
+    }
+
+    if (limit != sched.limit) {
+        metrics_add(METRIC_SCHED_LIMIT, (int64_t)limit - (int64_t)sched.limit);
+        sched.limit = limit;
+    }
+}
+
+/*
+ * Hill climbing on the aggregate block throughput: raise the limit while one
+ * more concurrent hash brings at least SCHED_GAIN percent, step back once it
+ * does not, and probe again after SCHED_HOLD windows. Only windows in which
+ * hashes had to wait say anything about the limit, the others are skipped.
+ */
+static void sched_adapt(uint64_t throughput) {
+    if (sched.hold > 0) {
+        if (--sched.hold > 0) {
+            return;
+        }
+    } else if (sched.probing &&
+               throughput * 100 < sched.throughput * (100 + SCHED_GAIN)) {
+        /* Saturated: the last slot added did not pay off */
+        if (sched.adaptive > 1) {
+            --sched.adaptive;
+        }
+        sched.probing = 0;
+        sched.hold = SCHED_HOLD;
+        return;
+    }
+
+    sched.throughput = throughput;
+    if (sched.adaptive < sched.config.max_concurrency) {
+        ++sched.adaptive;
+        sched.probing = 1;
+    } else {
+        sched.probing = 0;
+        sched.hold = SCHED_HOLD;
+    }
+}
+
+/*
+ * Grants the hash of @ticket at once if nothing can hold it back, else
+ * queues it and admits what fits; called with sched_mutex held
+ * @return Submitted hashes admitted, for sched_ready()
+ */
+static argon2_sched_ticket *sched_enter(argon2_sched_ticket *ticket,
+                                        uint32_t memory_blocks,
+                                        uint32_t passes) {
+    argon2_sched_tenant *tenant = sched_tenant(ticket->tenant_id, 1);
+    argon2_sched_ticket *ready;
+
+    /* Past SCHED_TENANTS_MAX, or without memory for its entry, a tenant is
+     * accounted to tenant 0 */
+    if (tenant == NULL) {
+        tenant = sched_tenant(0, 1);
+    }
+    ticket->tenant = tenant;
+    ticket->blocks = memory_blocks;
+    ticket->cost = (uint64_t)memory_blocks * passes;
+    /* memory_blocks equals m_cost rounded down to whole segments */
+    ticket->limited =
+        sched.enabled && memory_blocks >= sched.config.dram_threshold;
+
+    if (!ticket->limited && tenant->config.max_concurrency == 0 &&
+        tenant->config.max_memory == 0) {
+        sched_grant(ticket, metrics_now());
+        ticket->next = NULL;
+        return ticket->ready != NULL ? ticket : NULL;
+    }
+
+    ticket->queued = metrics_now();
+    ticket->next = NULL;
+    if (tenant->tail != NULL) {
+        tenant->tail->next = ticket;
+    } else {
+        tenant->head = ticket;
+        if (sched.active_tail != NULL) {
+            sched.active_tail->next_active = tenant;
+        } else {
+            sched.active = tenant;
+        }
+        sched.active_tail = tenant;
+        ++sched.active_count;
+    }
+    tenant->tail = ticket;
+    ++sched.waiting;
+    metrics_add(METRIC_QUEUE_DEPTH, 1);
+    ++tenant->metrics.queued;
+
+    ready = sched_dispatch();
+    if (!ticket->granted) {
+        ++tenant->metrics.delayed;
+        if (ticket->limited) {
+            sched.window_saturated = 1;
+        }
+    }
+    return ready;
+}
+
+/* Admits every waiting hash, without counting them against the limit:
+ * hashes queued under a previous configuration just go ahead. Called with
+ * sched_mutex held. */
+static argon2_sched_ticket *sched_flush(void) {
+    argon2_sched_ticket *ready = NULL, **last = &ready;
+    argon2_sched_tenant *tenant;
+    uint64_t now = metrics_now();
+
+    while ((tenant = sched.active) != NULL) {
+        while (tenant->head != NULL) {
+            tenant->head->limited = 0;
+            sched_dequeue(tenant, now, &last);
+        }
+        sched_deactivate(tenant, NULL);
+    }
+    argon2_cond_broadcast(&sched_cond);
+    return ready;
+}
+
+static void sched_lock(void) { argon2_mutex_lock(&sched_mutex); }
+
+static void sched_unlock(void) { argon2_mutex_unlock(&sched_mutex); }
+
+/* Drops the hashes of @tenant admitted or queued in the parent of a forked
+ * child, whose threads are gone */
+static void sched_forget(argon2_sched_tenant *tenant) {
+    tenant->running = 0;
+    tenant->memory = 0;
+    tenant->head = tenant->tail = NULL;
+    tenant->deficit = 0;
+    tenant->turn = 0;
+    tenant->next_active = NULL;
+    tenant->metrics.running = 0;
+    tenant->metrics.memory = 0;
+    tenant->metrics.queued = 0;
+}
+
+/*
+ * Starts over in a forked child, which only has the thread that called
+ * fork(): the hashes the parent admitted or queued are the parent's, and
+ * their slots and queue entries are dropped. The configuration and the
+ * tenants stay.
+ */
+static void sched_forked(void) {
+    argon2_sched_tenant *tenant;
+    uint32_t i;
+
+    argon2_mutex_init(&sched_mutex);
+    argon2_cond_init(&sched_cond);
+    metrics_add(METRIC_SCHED_RUNNING, -(int64_t)sched.running);
+    metrics_add(METRIC_QUEUE_DEPTH, -(int64_t)sched.waiting);
+    sched.running = 0;
+    sched.waiting = 0;
+    sched.active = sched.active_tail = NULL;
+    sched.active_count = 0;
+    sched_forget(&sched.tenant0);
+    metrics_add(METRIC_TENANT0_RUNNING,
+                -metrics_load(METRIC_TENANT0_RUNNING));
+    metrics_add(METRIC_TENANT0_MEMORY, -metrics_load(METRIC_TENANT0_MEMORY));
+    for (i = 0; i < sched.buckets; ++i) {
+        for (tenant = sched.tenants[i]; tenant != NULL; tenant = tenant->next) {
+            sched_forget(tenant);
+        }
+    }
+}
+
+static argon2_once_t sched_once = ARGON2_ONCE_INIT;
+
+static void sched_register(void) {
+    argon2_thread_atfork(sched_lock, sched_unlock, sched_forked);
+}
+
+void sched_atfork(void) { argon2_thread_once(&sched_once, sched_register); }
+
+void sched_ticket(argon2_sched_ticket *ticket, uint32_t tenant) {
+    memset(ticket, 0, sizeof(*ticket));
+    ticket->tenant_id = tenant;
+}
+
+void sched_admit(argon2_sched_ticket *ticket,
+                 const argon2_instance_t *instance) {
+    argon2_sched_ticket *ready;
+
+    if (ticket->granted) {
+        return;
+    }
+
+    sched_atfork();
+    if (sched_fast(ticket, instance->memory_blocks)) {
+        return;
+    }
+    argon2_mutex_lock(&sched_mutex);
+    ready = sched_enter(ticket, instance->memory_blocks, instance->passes);
+    while (!ticket->granted) {
+        argon2_cond_wait(&sched_cond, &sched_mutex, 0);
+    }
+    argon2_mutex_unlock(&sched_mutex);
+    sched_ready(ready);
+}
+
+void sched_submit(argon2_sched_ticket *ticket, uint32_t memory_blocks,
+                  uint32_t passes,
+                  void (*ready)(argon2_sched_ticket *ticket)) {
+    argon2_sched_ticket *admitted;
+
+    ticket->ready = ready;
+    sched_atfork();
+    if (sched_fast(ticket, memory_blocks)) {
+        ready(ticket);
+        return;
+    }
+    argon2_mutex_lock(&sched_mutex);
+    admitted = sched_enter(ticket, memory_blocks, passes);
+    argon2_mutex_unlock(&sched_mutex);
+
+    sched_ready(admitted);
+}
+
+/* Adds what the hashes of @ticket took to its tenant; called with
+ * sched_mutex held */
+static void sched_charge(const argon2_sched_ticket *ticket) {
+    argon2_tenant_metrics *metrics = &ticket->tenant->metrics;
+    metrics->cpu_time += ticket->usage.cpu_time;
+    metrics->allocated += ticket->usage.memory;
+    metrics->blocks += ticket->usage.blocks;
+}
+
+void sched_exempt(argon2_sched_ticket *ticket) {
+    sched_atfork();
+    argon2_mutex_lock(&sched_mutex);
+    ticket->tenant = sched_tenant(ticket->tenant_id, 1);
+    if (ticket->tenant == NULL) {
+        ticket->tenant = sched_tenant(0, 1);
+    }
+    argon2_mutex_unlock(&sched_mutex);
+    ticket->exempt = 1;
+    ticket->granted = 1;
+    ticket->started = metrics_now();
+}
+
+void sched_release(argon2_sched_ticket *ticket) {
+    static const enum argon2_metric released[5] = {
+        METRIC_TENANT0_RUNNING, METRIC_TENANT0_MEMORY, METRIC_TENANT0_CPU_TIME,
+        METRIC_TENANT0_ALLOCATED, METRIC_TENANT0_BLOCKS};
+    argon2_sched_tenant *tenant = ticket->tenant;
+    argon2_sched_ticket *ready;
+    int64_t deltas[5];
+    uint64_t now, rate;
+
+    if (!ticket->granted) {
+        return;
+    }
+    if (ticket->fast) {
+        ticket->granted = 0;
+        ticket->fast = 0;
+        deltas[0] = -1;
+        deltas[1] = -(int64_t)ticket->blocks;
+        deltas[2] = (int64_t)ticket->usage.cpu_time;
+        deltas[3] = (int64_t)ticket->usage.memory;
+        deltas[4] = (int64_t)ticket->usage.blocks;
+        metrics_add_all(released, deltas, 5);
+        return;
+    }
+    if (ticket->exempt) {
+        argon2_mutex_lock(&sched_mutex);
+        ticket->granted = 0;
+        sched_charge(ticket);
+        argon2_mutex_unlock(&sched_mutex);
+        return;
+    }
+
+    now = metrics_now();
+    rate = ticket->cost * 1000000 / (now - ticket->started + 1);
+
+    argon2_mutex_lock(&sched_mutex);
+    ticket->granted = 0;
+    --tenant->running;
+    tenant->memory -= ticket->blocks;
+    --tenant->metrics.running;
+    tenant->metrics.memory -= (int64_t)ticket->blocks;
+    sched_charge(ticket);
+
+    if (ticket->admitted) {
+        ticket->admitted = 0;
+        --sched.running;
+        metrics_add(METRIC_SCHED_RUNNING, -1);
+
+        sched.hash_rate =
+            sched.hash_rate ? (sched.hash_rate * 7 + rate) / 8 : rate;
+        sched.window_blocks += ticket->cost;
+        if (now - sched.window_start >= SCHED_WINDOW) {
+            if (sched.window_saturated && sched.config.adaptive) {
+                sched_adapt(sched.window_blocks * 1000000 /
+                            (now - sched.window_start));
+            }
+            sched.window_start = now;
+            sched.window_blocks = 0;
+            sched.window_saturated = 0;
+        }
+
+        if (sched.enabled) {
+            sched_update_limit();
+        }
+    }
+    ready = sched_dispatch();
+    argon2_mutex_unlock(&sched_mutex);
+    sched_ready(ready);
+}
+
+uint32_t sched_waiting(void) {
+    uint32_t waiting;
+    argon2_mutex_lock(&sched_mutex);
+    waiting = sched.waiting;
+    argon2_mutex_unlock(&sched_mutex);
+    return waiting;
+}
+
+void sched_throttle(argon2_sched_throttle throttle) {
+    argon2_sched_ticket *ready = NULL;
+
+    argon2_mutex_lock(&sched_mutex);
+    sched.throttle = throttle;
+    if (sched.enabled) {
+        sched_update_limit();
+        ready = sched_dispatch();
+    }
+    argon2_mutex_unlock(&sched_mutex);
+    sched_ready(ready);
+}
+
+int argon2_sched_configure(const argon2_sched_config *config) {
+    argon2_sched_ticket *ready;
+
+    sched_atfork();
+    argon2_mutex_lock(&sched_mutex);
+    ready = sched_flush();
+    if (config == NULL) {
+        sched.enabled = 0;
+        metrics_add(METRIC_SCHED_LIMIT, -(int64_t)sched.limit);
+        sched.limit = 0;
+    } else {
+        sched.enabled = 1;
+        sched.config = *config;
+        if (sched.config.max_concurrency == 0) {
+            sched.config.max_concurrency = argon2_thread_cpus();
+        }
+        /* Adaptive search starts from a single hash at a time */
+        sched.adaptive = 1;
+        sched.throughput = 0;
+        sched.probing = 0;
+        sched.hold = 0;
+        sched.hash_rate = 0;
+        sched.window_start = metrics_now();
+        sched.window_blocks = 0;
+        sched.window_saturated = 0;
+        sched_update_limit();
+    }
+    sched_update_gate();
+    argon2_mutex_unlock(&sched_mutex);
+    sched_ready(ready);
+    return ARGON2_OK;
+}
+
+int argon2_tenant_configure(uint32_t tenant,
+                            const argon2_tenant_config *config) {
+    argon2_sched_tenant *entry;
+    argon2_sched_ticket *ready = NULL;
+    int result = ARGON2_OK;
+
+    sched_atfork();
+    argon2_mutex_lock(&sched_mutex);
+    entry = sched_tenant(tenant, 2);
+    if (entry == NULL) {
+        result = ARGON2_MEMORY_ALLOCATION_ERROR;
+    } else {
+        if (config != NULL) {
+            entry->config = *config;
+        } else {
+            memset(&entry->config, 0, sizeof(entry->config));
+        }
+        /* Tenant 0 is not in the table */
+        if (entry != &sched.tenant0 && entry->configured != (config != NULL)) {
+            entry->configured = config != NULL;
+            if (entry->configured) {
+                --sched.unconfigured;
+            } else {
+                ++sched.unconfigured;
+            }
+        }
+        if (entry->config.weight == 0) {
+            entry->config.weight = 1;
+        }
+        if (entry == &sched.tenant0) {
+            sched_update_gate();
+        }
+        /* Raised caps may let waiting hashes in */
+        ready = sched_dispatch();
+    }
+    argon2_mutex_unlock(&sched_mutex);
+    sched_ready(ready);
+    return result;
+}
+
+int argon2_tenant_snapshot(uint32_t tenant, argon2_tenant_metrics *metrics) {
+    argon2_sched_tenant *entry;
+
+    argon2_mutex_lock(&sched_mutex);
+    entry = sched_tenant(tenant, 0);
+    if (entry != NULL) {
+        *metrics = entry->metrics;
+        if (tenant == 0) {
+            metrics->running += metrics_load(METRIC_TENANT0_RUNNING);
+            metrics->memory += metrics_load(METRIC_TENANT0_MEMORY);
+            metrics->admitted +=
+                (uint64_t)metrics_load(METRIC_TENANT0_ADMITTED);
+            metrics->cpu_time +=
+                (uint64_t)metrics_load(METRIC_TENANT0_CPU_TIME);
+            metrics->allocated +=
+                (uint64_t)metrics_load(METRIC_TENANT0_ALLOCATED);
+            metrics->blocks += (uint64_t)metrics_load(METRIC_TENANT0_BLOCKS);
+        }
+    } else {
+        memset(metrics, 0, sizeof(*metrics));
+    }
+    argon2_mutex_unlock(&sched_mutex);
+    return ARGON2_OK;
+}
+
+#else /* ARGON2_NO_THREADS */
+
+void sched_ticket(argon2_sched_ticket *ticket, uint32_t tenant) {
+    memset(ticket, 0, sizeof(*ticket));
+    ticket->tenant_id = tenant;
+}
+
+void sched_admit(argon2_sched_ticket *ticket,
+                 const argon2_instance_t *instance) {
+    (void)ticket;
+    (void)instance;
+}
+
+void sched_submit(argon2_sched_ticket *ticket, uint32_t memory_blocks,
+                  uint32_t passes,
+                  void (*ready)(argon2_sched_ticket *ticket)) {
+    (void)memory_blocks;
+    (void)passes;
+    ready(ticket);
+}
+
+void sched_atfork(void) {}
+
+void sched_exempt(argon2_sched_ticket *ticket) { (void)ticket; }
+
+void sched_release(argon2_sched_ticket *ticket) { (void)ticket; }
+
+uint32_t sched_waiting(void) { return 0; }
+
+void sched_throttle(argon2_sched_throttle throttle) { (void)throttle; }
+
+int argon2_sched_configure(const argon2_sched_config *config) {
+    (void)config;
+    return ARGON2_THREAD_FAIL;
+}
+
+int argon2_tenant_configure(uint32_t tenant,
+                            const argon2_tenant_config *config) {
+    (void)tenant;
+    (void)config;
+    return ARGON2_THREAD_FAIL;
+}
+
+int argon2_tenant_snapshot(uint32_t tenant, argon2_tenant_metrics *metrics) {
+    (void)tenant;
+    memset(metrics, 0, sizeof(*metrics));
+    return ARGON2_THREAD_FAIL;
+}
+
+#endif /* ARGON2_NO_THREADS */
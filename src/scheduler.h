@@ -0,0 +1,131 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_SCHED_H
+#define ARGON2_SCHED_H
+
+#include "core.h"
+
+struct Argon2_sched_tenant;
+
+/*
+ * Admission of one hash, on behalf of a tenant. The ticket is also the
+ * queue entry of a hash waiting for admission, so it must stay in place
+ * from sched_admit() or sched_submit() until admitted.
+ */
+typedef struct Argon2_sched_ticket {
+    uint32_t tenant_id; /* tenant the hash is accounted to */
+    int granted;        /* whether the hash may start */
+    int admitted;       /* whether the hash counts against the limit */
+    int limited;        /* whether it has to wait for the limit */
+    int exempt;         /* granted outside admission, see sched_exempt() */
+    int fast;           /* granted without the scheduler lock */
+    uint64_t started;   /* when it was granted, see metrics_now() */
+    uint64_t queued;    /* when it started waiting */
+    uint64_t blocks;    /* memory held, in blocks (KiB) */
+    uint64_t cost;      /* blocks to compute */
+    argon2_cost usage;  /* what its hashes took, charged on release */
+    struct Argon2_sched_tenant *tenant;
+    void (*ready)(struct Argon2_sched_ticket *ticket); /* see sched_submit() */
+    struct Argon2_sched_ticket *next; /* in the queue of its tenant */
+} argon2_sched_ticket;
+
+/*
+ * Prepares a ticket for a hash of @tenant
+ */
+ARGON2_LOCAL void sched_ticket(argon2_sched_ticket *ticket, uint32_t tenant);
+
+/*
+ * Waits until the hash described by @instance may start, following the
+ * configuration of argon2_sched_configure() and argon2_tenant_configure().
+ * Returns at once if @ticket was admitted ahead by sched_submit().
+ * @param ticket Ticket prepared by sched_ticket(), to hand to sched_release()
+ * @param instance Pointer to the instance about to be initialized
+ */
+ARGON2_LOCAL void sched_admit(argon2_sched_ticket *ticket,
+                              const argon2_instance_t *instance);
+
+/*
+ * Queues a hash for admission without waiting: @ready is called once it is
+ * admitted, outside the scheduler lock, from whichever thread admits it
+ * (possibly the caller, before returning)
+ * @param ticket Ticket prepared by sched_ticket(), left in place until then
+ * @param memory_blocks Memory blocks the hash will use
+ * @param passes Number of passes of the hash
+ */
+ARGON2_LOCAL void sched_submit(argon2_sched_ticket *ticket,
+                               uint32_t memory_blocks, uint32_t passes,
+                               void (*ready)(argon2_sched_ticket *ticket));
+
+/*
+ * Registers the fork handlers of the scheduler, once: a forked child drops
+ * the hashes its parent had admitted or queued. Modules that call the
+ * scheduler with a lock of their own held call it before registering their
+ * handlers, for fork() to take their lock before the scheduler's.
+ */
+ARGON2_LOCAL void sched_atfork(void);
+
+/*
+ * Grants @ticket at once without counting it against the limit or the caps
+ * of its tenant, for hashes on idle-priority threads: starved by the
+ * kernel, they must not hold a slot that foreground hashes wait for. Its
+ * usage is still charged to the tenant by sched_release().
+ * @param ticket Ticket prepared by sched_ticket()
+ */
+ARGON2_LOCAL void sched_exempt(argon2_sched_ticket *ticket);
+
+/*
+ * Lets the next hash in, and accounts the blocks computed on @ticket to the
+ * throughput measurement; does nothing unless the ticket was admitted
+ * @param ticket Pointer to the ticket passed to sched_admit() or
+ * sched_submit()
+ */
+ARGON2_LOCAL void sched_release(argon2_sched_ticket *ticket);
+
+/*
+ * argon2_ctx() on behalf of @ticket, admitted ahead or not (defined in
+ * argon2.c)
+ */
+ARGON2_LOCAL int hash_ticket(argon2_context *context, argon2_type type,
+                             argon2_sched_ticket *ticket);
+
+/*
+ * argon2_verify() on behalf of @ticket, admitted ahead or not, in @matrix
+ * as argon2_ctx_with_memory() would unless it is NULL (defined in argon2.c)
+ */
+ARGON2_LOCAL int verify_ticket(const char *encoded, const void *pwd,
+                               const size_t pwdlen, argon2_type type,
+                               argon2_sched_ticket *ticket, void *matrix,
+                               size_t matrix_len);
+
+/* Returns the number of hashes waiting for admission */
+ARGON2_LOCAL uint32_t sched_waiting(void);
+
+/* Throttling levels, see argon2_pressure_configure() */
+typedef enum Argon2_sched_throttle {
+    ARGON2_SCHED_NORMAL = 0,
+    ARGON2_SCHED_SLOW = 1, /* one admission-controlled hash at a time */
+    ARGON2_SCHED_STOP = 2  /* no new admission-controlled hash */
+} argon2_sched_throttle;
+
+/*
+ * Caps the admission limit on top of argon2_sched_configure()
+ * @param throttle Throttling level
+ */
+ARGON2_LOCAL void sched_throttle(argon2_sched_throttle throttle);
+
+#endif
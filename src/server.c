@@ -0,0 +1,546 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2-node.h"
+#include "wire.h"
+
+#if defined(ARGON2_WIRE)
+
+#include "core.h"
+#include "encoding.h"
+#include "scheduler.h"
+#include "tasks.h"
+#include "thread.h"
+#include "blake2/blake2-impl.h"
+
+/* Requests of a connection running at once; past that its reader stops
+ * reading, which pushes back on the client through TCP flow control */
+#define SERVER_PIPELINE 256
+/* How often the acceptor looks for a stop and for closed connections */
+#define SERVER_POLL_MS 100
+/* How long a response may wait for the client to read: past that the
+ * connection is dropped rather than hold the worker that answers */
+#define SERVER_SEND_MS 2000
+/* Defaults of argon2_server_config */
+#define SERVER_ADDRESS_DEF "127.0.0.1"
+#define SERVER_M_COST_DEF (1 << 20)
+#define SERVER_T_COST_DEF 16
+#define SERVER_LANES_DEF 16
+#define SERVER_CONNECTIONS_DEF 256
+
+typedef struct server_conn {
+    struct Argon2_server *server;
+    int fd;
+    uint32_t running; /* requests received and not answered yet */
+    int reading;      /* whether the reader thread still runs */
+    int failed;       /* a response could not be sent; the others are
+                         dropped. Guarded by write_mutex. */
+    argon2_mutex_t write_mutex;
+    argon2_thread_handle_t reader;
+    struct server_conn *next;
+} server_conn;
+
+struct Argon2_server {
+    int listener;
+    unsigned port;
+    int stopping;
+    uint32_t max_m_cost, max_t_cost, max_lanes; /* largest costs served */
+    uint32_t max_connections;
+    uint32_t tenant;   /* of every request, unless trust_tenants */
+    int trust_tenants; /* the tenant of a request is the one it names */
+    argon2_thread_handle_t acceptor;
+    server_conn *conns;
+    uint32_t connections; /* length of conns */
+    argon2_mutex_t mutex;
+    argon2_cond_t cond; /* a request was answered, or a reader ended */
+};
+
+/* A request being served */
+typedef struct server_request {
+    argon2_task task; /* WIRE_HASH requests run as tasks once admitted */
+    argon2_sched_ticket ticket;
+    server_conn *conn;
+    uint32_t id;
+    argon2_type type;
+    uint32_t tenant;
+    uint32_t t_cost, m_cost, lanes, hashlen, saltlen, pwdlen;
+    uint8_t *data; /* salt then password */
+} server_request;
+
+/* Sends the response to @request and frees it */
+static void server_respond(server_request *request, int result,
+                           const char *encoded) {
+    server_conn *conn = request->conn;
+    argon2_server *server = conn->server;
+    uint8_t frame[4 + WIRE_FRAME_MAX];
+    size_t body = encoded != NULL ? strlen(encoded) : 0;
+
+    store32(frame, (uint32_t)(WIRE_RESPONSE_HEADER + body));
+    store32(frame + 4, request->id);
+    store32(frame + 8, (uint32_t)result);
+    memcpy(frame + 12, encoded, body);
+
+    argon2_mutex_lock(&conn->write_mutex);
+    if (!conn->failed &&
+        wire_send(conn->fd, frame, 4 + WIRE_RESPONSE_HEADER + body) != 0) {
+        /* The client is gone or does not read: end the reader as well, and
+         * let the requests in flight finish without waiting on it */
+        conn->failed = 1;
+        wire_shutdown(conn->fd);
+    }
+    argon2_mutex_unlock(&conn->write_mutex);
+
+    if (request->data != NULL) {
+        clear_internal_memory(request->data,
+                              request->saltlen + request->pwdlen);
+        free(request->data);
+    }
+    free(request);
+
+    argon2_mutex_lock(&server->mutex);
+    --conn->running;
+    argon2_cond_broadcast(&server->cond);
+    argon2_mutex_unlock(&server->mutex);
+}
+
+static void server_verified(int result, void *arg) {
+    server_respond((server_request *)arg, result, NULL);
+}
+
+/* Hashes on behalf of the ticket of @request */
+static int server_hash_ticket(server_request *request, char *encoded,
+                              size_t encoded_len) {
+    argon2_context context;
+    uint8_t *out;
+    int result;
+
+    if (request->hashlen < ARGON2_MIN_OUTLEN) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    if (argon2_encodedlen(request->t_cost, request->m_cost, request->lanes,
+                          request->saltlen, request->hashlen,
+                          request->type) > encoded_len) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+    out = malloc(request->hashlen);
+    if (out == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+
+    memset(&context, 0, sizeof(context));
+    context.out = out;
+    context.outlen = request->hashlen;
+    context.salt = request->data;
+    context.saltlen = request->saltlen;
+    context.pwd = request->data + request->saltlen;
+    context.pwdlen = request->pwdlen;
+    context.t_cost = request->t_cost;
+    context.m_cost = request->m_cost;
+    context.lanes = request->lanes;
+    context.threads = request->lanes;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    context.version = ARGON2_VERSION_NUMBER;
+
+    result = hash_ticket(&context, request->type, &request->ticket);
+    if (result == ARGON2_OK &&
+        encode_string(encoded, encoded_len, &context, request->type) !=
+            ARGON2_OK) {
+        result = ARGON2_ENCODING_FAIL;
+    }
+    clear_internal_memory(out, request->hashlen);
+    free(out);
+    return result;
+}
+
+static void server_hash(argon2_task *task) {
+    server_request *request = (server_request *)task;
+    char encoded[WIRE_FRAME_MAX - WIRE_RESPONSE_HEADER + 1];
+    int result = server_hash_ticket(request, encoded, sizeof(encoded));
+
+    sched_release(&request->ticket);
+    server_respond(request, result, result == ARGON2_OK ? encoded : NULL);
+}
+
+/* Starts an admitted hash on a worker, or failing any, right here */
+static void server_ready(argon2_sched_ticket *ticket) {
+    server_request *request = (server_request *)((uint8_t *)ticket -
+                                                 offsetof(server_request,
+                                                          ticket));
+
+    if (tasks_submit(TASKS_FOREGROUND, &request->task) != 0) {
+        server_hash(&request->task);
+    }
+}
+
+/* Refuses costs above the caps of @server, which the network must not be
+ * able to exceed */
+static int server_check(const argon2_server *server, uint32_t t_cost,
+                        uint32_t m_cost, uint32_t lanes) {
+    if (m_cost > server->max_m_cost) {
+        return ARGON2_MEMORY_TOO_MUCH;
+    }
+    if (t_cost > server->max_t_cost) {
+        return ARGON2_TIME_TOO_LARGE;
+    }
+    if (lanes > server->max_lanes) {
+        return ARGON2_LANES_TOO_MANY;
+    }
+    return ARGON2_OK;
+}
+
+/* Checks the costs of the hash to verify against @encoded before anything is
+ * queued for it */
+static int server_check_encoded(const argon2_server *server,
+                                const char *encoded, argon2_type type) {
+    argon2_context ctx;
+    size_t encoded_len = strlen(encoded);
+    uint8_t *scratch = malloc(encoded_len + 1);
+    int result;
+
+    if (scratch == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    /* Salt and tag are decoded into the same scratch buffer and dropped */
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.salt = scratch;
+    ctx.saltlen = (uint32_t)encoded_len;
+    ctx.out = scratch;
+    ctx.outlen = (uint32_t)encoded_len;
+    result = decode_string(&ctx, encoded, type);
+    if (result == ARGON2_OK) {
+        result = server_check(server, ctx.t_cost, ctx.m_cost, ctx.lanes);
+    }
+    clear_internal_memory(scratch, encoded_len);
+    free(scratch);
+    return result;
+}
+
+/*
+ * Parses the request in @frame and starts serving it
+ * @return 0, or -1 for a malformed frame, which ends the connection
+ */
+static int server_dispatch(server_conn *conn, const uint8_t *frame,
+                           size_t len) {
+    char encoded[WIRE_FRAME_MAX + 1];
+    server_request *request;
+    const uint8_t *body = frame + WIRE_REQUEST_HEADER;
+    size_t rest;
+    uint32_t op, encoded_len;
+    int result;
+
+    if (len < WIRE_REQUEST_HEADER) {
+        return -1;
+    }
+    rest = len - WIRE_REQUEST_HEADER;
+    request = calloc(1, sizeof(*request));
+    if (request == NULL) {
+        return -1;
+    }
+    request->conn = conn;
+    request->id = load32(frame);
+    op = load32(frame + 4);
+    request->type = (argon2_type)load32(frame + 8);
+    /* Anyone who can connect can name any tenant, so the tenant named is
+     * only taken from peers the server was told to trust */
+    request->tenant = conn->server->trust_tenants ? load32(frame + 12)
+                                                  : conn->server->tenant;
+
+    argon2_mutex_lock(&conn->server->mutex);
+    ++conn->running;
+    argon2_mutex_unlock(&conn->server->mutex);
+
+    if (argon2_type2string(request->type, 0) == NULL) {
+        server_respond(request, ARGON2_INCORRECT_TYPE, NULL);
+        return 0;
+    }
+
+    switch (op) {
+    case WIRE_VERIFY:
+        if (rest < 4 || load32(body) > rest - 4) {
+            break;
+        }
+        encoded_len = load32(body);
+        memcpy(encoded, body + 4, encoded_len);
+        encoded[encoded_len] = '\0';
+        result = server_check_encoded(conn->server, encoded, request->type);
+        if (result != ARGON2_OK) {
+            server_respond(request, result, NULL);
+            return 0;
+        }
+        result = argon2_verify_async_tenant(
+            encoded, body + 4 + encoded_len, rest - 4 - encoded_len,
+            request->type, request->tenant, server_verified, request);
+        if (result != ARGON2_OK) {
+            server_respond(request, result, NULL);
+        }
+        return 0;
+
+    case WIRE_HASH:
+        if (rest < 20 || load32(body + 16) > rest - 20) {
+            break;
+        }
+        request->t_cost = load32(body);
+        request->m_cost = load32(body + 4);
+        request->lanes = load32(body + 8);
+        request->hashlen = load32(body + 12);
+        request->saltlen = load32(body + 16);
+        request->pwdlen = (uint32_t)(rest - 20 - request->saltlen);
+        result = server_check(conn->server, request->t_cost, request->m_cost,
+                              request->lanes);
+        if (result != ARGON2_OK) {
+            server_respond(request, result, NULL);
+            return 0;
+        }
+        request->data = malloc(rest - 20 + 1);
+        if (request->data == NULL) {
+            server_respond(request, ARGON2_MEMORY_ALLOCATION_ERROR, NULL);
+            return 0;
+        }
+        memcpy(request->data, body + 20, rest - 20);
+        request->task.run = server_hash;
+        /* The hash takes a worker once admitted, as verifications do */
+        sched_ticket(&request->ticket, request->tenant);
+        sched_submit(&request->ticket,
+                     (uint32_t)(argon2_memory_required(request->m_cost,
+                                                       request->lanes) /
+                                ARGON2_BLOCK_SIZE),
+                     request->t_cost, server_ready);
+        return 0;
+
+    default:
+        server_respond(request, ARGON2_INCORRECT_PARAMETER, NULL);
+        return 0;
+    }
+
+    /* Lengths past the end of the frame */
+    server_respond(request, ARGON2_DECODING_FAIL, NULL);
+    return -1;
+}
+
+static void *server_read(void *arg) {
+    server_conn *conn = (server_conn *)arg;
+    argon2_server *server = conn->server;
+    uint8_t frame[WIRE_FRAME_MAX];
+    long len;
+    int result;
+
+    for (;;) {
+        argon2_mutex_lock(&server->mutex);
+        while (conn->running >= SERVER_PIPELINE) {
+            argon2_cond_wait(&server->cond, &server->mutex, 0);
+        }
+        argon2_mutex_unlock(&server->mutex);
+
+        len = wire_recv(conn->fd, frame);
+        if (len < 0) {
+            break;
+        }
+        result = server_dispatch(conn, frame, (size_t)len);
+        clear_internal_memory(frame, (size_t)len);
+        if (result != 0) {
+            break;
+        }
+    }
+
+    argon2_mutex_lock(&server->mutex);
+    conn->reading = 0;
+    argon2_cond_broadcast(&server->cond);
+    argon2_mutex_unlock(&server->mutex);
+    return NULL;
+}
+
+/* Frees the connections whose reader ended and whose requests are all
+ * answered. Called with server->mutex held. */
+static void server_reap(argon2_server *server) {
+    server_conn **link = &server->conns, *conn;
+
+    while ((conn = *link) != NULL) {
+        if (conn->reading || conn->running != 0) {
+            link = &conn->next;
+            continue;
+        }
+        *link = conn->next;
+        --server->connections;
+        argon2_thread_join(conn->reader);
+        wire_close(conn->fd);
+        argon2_mutex_destroy(&conn->write_mutex);
+        free(conn);
+    }
+}
+
+static void *server_accept(void *arg) {
+    argon2_server *server = (argon2_server *)arg;
+    server_conn *conn;
+    int fd;
+
+    for (;;) {
+        argon2_mutex_lock(&server->mutex);
+        server_reap(server);
+        if (server->stopping) {
+            argon2_mutex_unlock(&server->mutex);
+            return NULL;
+        }
+        argon2_mutex_unlock(&server->mutex);
+
+        fd = wire_accept(server->listener, SERVER_POLL_MS);
+        if (fd < 0) {
+            continue;
+        }
+        /* Each connection has a thread: past the cap, new ones are closed
+         * at once */
+        argon2_mutex_lock(&server->mutex);
+        if (server->connections >= server->max_connections) {
+            argon2_mutex_unlock(&server->mutex);
+            wire_close(fd);
+            continue;
+        }
+        argon2_mutex_unlock(&server->mutex);
+        wire_send_timeout(fd, SERVER_SEND_MS);
+        conn = calloc(1, sizeof(*conn));
+        if (conn == NULL || argon2_mutex_init(&conn->write_mutex) != 0) {
+            free(conn);
+            wire_close(fd);
+            continue;
+        }
+        conn->server = server;
+        conn->fd = fd;
+        conn->reading = 1;
+
+        argon2_mutex_lock(&server->mutex);
+        if (server->stopping ||
+            argon2_thread_create(&conn->reader, &server_read, conn) != 0) {
+            argon2_mutex_unlock(&server->mutex);
+            argon2_mutex_destroy(&conn->write_mutex);
+            free(conn);
+            wire_close(fd);
+            continue;
+        }
+        conn->next = server->conns;
+        server->conns = conn;
+        ++server->connections;
+        argon2_mutex_unlock(&server->mutex);
+    }
+}
+
+int argon2_server_start(argon2_server **server,
+                        const argon2_server_config *config) {
+    argon2_server_config defaults;
+    argon2_server *s;
+
+    if (server == NULL) {
+        return ARGON2_MISSING_ARGS;
+    }
+    if (config == NULL) {
+        memset(&defaults, 0, sizeof(defaults));
+        config = &defaults;
+    }
+    s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    s->max_m_cost = config->max_m_cost ? config->max_m_cost : SERVER_M_COST_DEF;
+    s->max_t_cost = config->max_t_cost ? config->max_t_cost : SERVER_T_COST_DEF;
+    s->max_lanes = config->max_lanes ? config->max_lanes : SERVER_LANES_DEF;
+    s->max_connections = config->max_connections ? config->max_connections
+                                                 : SERVER_CONNECTIONS_DEF;
+    s->tenant = config->tenant;
+    s->trust_tenants = config->trust_tenants;
+    if (argon2_mutex_init(&s->mutex) != 0) {
+        free(s);
+        return ARGON2_THREAD_FAIL;
+    }
+    if (argon2_cond_init(&s->cond) != 0) {
+        argon2_mutex_destroy(&s->mutex);
+        free(s);
+        return ARGON2_THREAD_FAIL;
+    }
+    s->listener = wire_listen(config->address != NULL ? config->address
+                                                      : SERVER_ADDRESS_DEF,
+                              config->port, &s->port);
+    if (s->listener < 0) {
+        argon2_cond_destroy(&s->cond);
+        argon2_mutex_destroy(&s->mutex);
+        free(s);
+        return ARGON2_NETWORK_FAIL;
+    }
+    if (argon2_thread_create(&s->acceptor, &server_accept, s) != 0) {
+        wire_close(s->listener);
+        argon2_cond_destroy(&s->cond);
+        argon2_mutex_destroy(&s->mutex);
+        free(s);
+        return ARGON2_THREAD_FAIL;
+    }
+    *server = s;
+    return ARGON2_OK;
+}
+
+unsigned argon2_server_port(const argon2_server *server) {
+    return server != NULL ? server->port : 0;
+}
+
+void argon2_server_stop(argon2_server *server) {
+    server_conn *conn;
+
+    if (server == NULL) {
+        return;
+    }
+    argon2_mutex_lock(&server->mutex);
+    server->stopping = 1;
+    argon2_mutex_unlock(&server->mutex);
+    argon2_thread_join(server->acceptor);
+    wire_close(server->listener);
+
+    /* Readers stop at the next frame; requests in flight are answered */
+    argon2_mutex_lock(&server->mutex);
+    for (conn = server->conns; conn != NULL; conn = conn->next) {
+        wire_shutdown(conn->fd);
+    }
+    for (;;) {
+        server_reap(server);
+        if (server->conns == NULL) {
+            break;
+        }
+        argon2_cond_wait(&server->cond, &server->mutex, 0);
+    }
+    argon2_mutex_unlock(&server->mutex);
+
+    argon2_cond_destroy(&server->cond);
+    argon2_mutex_destroy(&server->mutex);
+    free(server);
+}
+
+#else /* ARGON2_WIRE */
+
+int argon2_server_start(argon2_server **server,
+                        const argon2_server_config *config) {
+    (void)server;
+    (void)config;
+    return ARGON2_NETWORK_FAIL;
+}
+
+unsigned argon2_server_port(const argon2_server *server) {
+    (void)server;
+    return 0;
+}
+
+void argon2_server_stop(argon2_server *server) { (void)server; }
+
+#endif /* ARGON2_WIRE */
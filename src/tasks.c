@@ -0,0 +1,142 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stddef.h>
+
+#include "tasks.h"
+#include "thread.h"
+
+#if !defined(ARGON2_NO_THREADS)
+
+static argon2_mutex_t tasks_mutex = ARGON2_MUTEX_INITIALIZER;
+static argon2_cond_t tasks_cond = ARGON2_COND_INITIALIZER;
+
+static struct {
+    argon2_task *head, *tail; /* FIFO of pending tasks */
+    unsigned workers;         /* threads started, at most one per processor */
+    unsigned idle;            /* threads waiting for a task */
+} tasks[TASKS_CLASSES];
+
+/* Class of task each worker serves, passed through the thread argument */
+static argon2_tasks_class tasks_classes[TASKS_CLASSES] = {TASKS_FOREGROUND,
+                                                          TASKS_BACKGROUND};
+
+#ifdef _WIN32
+static unsigned __stdcall tasks_worker(void *arg)
+#else
+static void *tasks_worker(void *arg)
+#endif
+{
+    argon2_tasks_class cls = *(argon2_tasks_class *)arg;
+    argon2_task *task;
+
+    /* Best effort: without it background tasks merely compete with others */
+    if (cls == TASKS_BACKGROUND) {
+        argon2_thread_lower_priority();
+    }
+
+    argon2_mutex_lock(&tasks_mutex);
+    for (;;) {
+        while (tasks[cls].head == NULL) {
+            ++tasks[cls].idle;
+            argon2_cond_wait(&tasks_cond, &tasks_mutex, 0);
+            --tasks[cls].idle;
+        }
+        task = tasks[cls].head;
+        tasks[cls].head = task->next;
+        if (tasks[cls].head == NULL) {
+            tasks[cls].tail = NULL;
+        }
+        argon2_mutex_unlock(&tasks_mutex);
+        task->run(task);
+        argon2_mutex_lock(&tasks_mutex);
+    }
+    return 0;
+}
+
+static void tasks_lock(void) { argon2_mutex_lock(&tasks_mutex); }
+
+static void tasks_unlock(void) { argon2_mutex_unlock(&tasks_mutex); }
+
+/*
+ * Forgets the workers in a forked child, which only has the thread that
+ * called fork(), and the tasks its parent queued for them: they are the
+ * parent's to run. Workers start again on the next task submitted.
+ */
+static void tasks_forked(void) {
+    argon2_task *task, *next;
+    unsigned cls;
+
+    argon2_mutex_init(&tasks_mutex);
+    argon2_cond_init(&tasks_cond);
+    for (cls = 0; cls < TASKS_CLASSES; ++cls) {
+        for (task = tasks[cls].head; task != NULL; task = next) {
+            next = task->next;
+            if (task->forget != NULL) {
+                task->forget(task);
+            }
+        }
+        tasks[cls].head = tasks[cls].tail = NULL;
+        tasks[cls].workers = 0;
+        tasks[cls].idle = 0;
+    }
+}
+
+static argon2_once_t tasks_once = ARGON2_ONCE_INIT;
+
+static void tasks_atfork(void) {
+    argon2_thread_atfork(tasks_lock, tasks_unlock, tasks_forked);
+}
+
+int tasks_submit(argon2_tasks_class cls, argon2_task *task) {
+    argon2_thread_handle_t handle;
+    int result = 0;
+
+    task->next = NULL;
+    argon2_thread_once(&tasks_once, tasks_atfork);
+    argon2_mutex_lock(&tasks_mutex);
+    /* Start a worker unless one is idle or the processors are all covered */
+    if (tasks[cls].idle == 0 && tasks[cls].workers < argon2_thread_cpus()) {
+        if (argon2_thread_create(&handle, &tasks_worker,
+                                 &tasks_classes[cls]) == 0) {
+            ++tasks[cls].workers;
+        }
+    }
+    if (tasks[cls].workers == 0) {
+        result = -1;
+    } else {
+        if (tasks[cls].tail != NULL) {
+            tasks[cls].tail->next = task;
+        } else {
+            tasks[cls].head = task;
+        }
+        tasks[cls].tail = task;
+        argon2_cond_broadcast(&tasks_cond);
+    }
+    argon2_mutex_unlock(&tasks_mutex);
+    return result;
+}
+
+#else /* ARGON2_NO_THREADS */
+
+int tasks_submit(argon2_tasks_class cls, argon2_task *task) {
+    (void)cls;
+    task->run(task);
+    return 0;
+}
+
+#endif /* ARGON2_NO_THREADS */
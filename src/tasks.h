@@ -0,0 +1,52 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_TASKS_H
+#define ARGON2_TASKS_H
+
+#include "argon2.h"
+
+/*
+ * Work handed off the caller's thread: rehashes of
+ * argon2_verify_and_upgrade(), verifications of argon2_verify_async(). Each
+ * class of task has its own FIFO and its own workers, started on demand up
+ * to one per processor and kept for later tasks.
+ */
+typedef enum Argon2_tasks_class {
+    TASKS_FOREGROUND = 0, /* normal priority */
+    TASKS_BACKGROUND = 1, /* lowest scheduling priority */
+    TASKS_CLASSES
+} argon2_tasks_class;
+
+/* A task; users embed it as the first member of their own structure */
+typedef struct Argon2_task {
+    void (*run)(struct Argon2_task *task); /* runs the task and frees it */
+    /* frees it without running it, in a child forked while it was queued;
+     * NULL if its memory is reclaimed otherwise */
+    void (*forget)(struct Argon2_task *task);
+    struct Argon2_task *next;
+} argon2_task;
+
+/*
+ * Queues @task on the workers of @cls. In builds without threads, runs it
+ * before returning. A child forked meanwhile starts workers of its own and
+ * forgets the tasks queued by its parent.
+ * @return 0 on success, -1 if no worker could be started
+ */
+ARGON2_LOCAL int tasks_submit(argon2_tasks_class cls, argon2_task *task);
+
+#endif
@@ -15,6 +15,23 @@
  * software. If not, they may be obtained at the above URLs.
  */
 
+#if !defined(_WIN32)
+/* for fork(), kill() and waitpid() in checkpointtest() and placementtest(),
+ * and sockets and threads in nodetest() */
+#define _POSIX_C_SOURCE 200112L
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if !defined(ARGON2_NO_THREADS)
+#include <pthread.h>
+#endif
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -23,6 +40,7 @@
 #include <assert.h>
 
 #include "argon2.h"
+#include "argon2-node.h"
 
 #define OUT_LEN 32
 #define ENCODED_LEN 108
@@ -64,6 +82,1605 @@ void hashtest(uint32_t version, uint32_t t, uint32_t m, uint32_t p, char *pwd,
     printf("PASS\n");
 }
 
+/* Test harness will assert:
+ * argon2_ctx_with_memory() fills the caller-supplied matrix and matches
+ * argon2_hash() output
+ * argon2_hash() without a raw hash buffer still produces the encoded hash
+ */
+void memorytest(uint32_t version) {
+    static uint64_t matrix[256 * 1024 / sizeof(uint64_t)];
+    unsigned char out[OUT_LEN];
+    unsigned char hex_out[OUT_LEN * 2 + 4];
+    char encoded[ENCODED_LEN];
+    argon2_context context;
+    int ret, i;
+
+    assert(argon2_memory_required(1 << 8, 2) == sizeof(matrix));
+    assert(argon2_memory_required(10, 1) == 8 * 1024);
+    assert(argon2_memory_required(4, 1) == 0);
+    assert(argon2_memory_required(1 << 8, 0) == 0);
+    printf("Compute required matrix size: PASS\n");
+
+    memset(&context, 0, sizeof(context));
+    context.out = out;
+    context.outlen = OUT_LEN;
+    context.pwd = (uint8_t *)"password";
+    context.pwdlen = strlen("password");
+    context.salt = (uint8_t *)"somesalt";
+    context.saltlen = strlen("somesalt");
+    context.t_cost = 2;
+    context.m_cost = 1 << 8;
+    context.lanes = 2;
+    context.threads = 2;
+    context.version = version;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+
+    ret = argon2_ctx_with_memory(&context, Argon2_i, matrix, sizeof(matrix));
+    assert(ret == ARGON2_OK);
+    for (i = 0; i < OUT_LEN; ++i)
+        sprintf((char *)(hex_out + i * 2), "%02x", out[i]);
+    assert(memcmp(hex_out, "4ff5ce2769a1d7f4c8a491df09d41a9f"
+                           "be90e5eb02155a13e4c01e20cd4eab61",
+                  OUT_LEN * 2) == 0);
+    printf("Hash into a caller-supplied matrix: PASS\n");
+
+    context.flags = ARGON2_FLAG_LOCK_MEMORY;
+    memset(out, 0, OUT_LEN);
+    ret = argon2_ctx(&context, Argon2_i);
+    assert(ret == ARGON2_OK);
+    for (i = 0; i < OUT_LEN; ++i)
+        sprintf((char *)(hex_out + i * 2), "%02x", out[i]);
+    assert(memcmp(hex_out, "4ff5ce2769a1d7f4c8a491df09d41a9f"
+                           "be90e5eb02155a13e4c01e20cd4eab61",
+                  OUT_LEN * 2) == 0);
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    printf("Hash with locked memory: PASS\n");
+
+    ret = argon2_ctx_with_memory(&context, Argon2_i, matrix,
+                                 sizeof(matrix) - 1);
+    assert(ret == ARGON2_MATRIX_MISMATCH);
+    ret = argon2_ctx_with_memory(&context, Argon2_i, NULL, sizeof(matrix));
+    assert(ret == ARGON2_MATRIX_MISMATCH);
+    printf("Fail on a short matrix: PASS\n");
+
+    ret = argon2i_hash_encoded(2, 1 << 8, 2, "password", strlen("password"),
+                               "somesalt", strlen("somesalt"), OUT_LEN,
+                               encoded, ENCODED_LEN);
+    assert(ret == ARGON2_OK);
+    assert(strcmp(encoded, "$argon2i$v=19$m=256,t=2,p=2$c29tZXNhbHQ"
+                           "$T/XOJ2mh1/TIpJHfCdQan76Q5esCFVoT5MAeIM1Oq2E") == 0);
+    printf("Encode without a raw hash buffer: PASS\n");
+}
+
+#if !defined(_WIN32) && !defined(ARGON2_NO_THREADS)
+/* Hashes completed less their latency samples, over every type and bucket */
+static int64_t metrics_unsampled(const argon2_metrics *metrics) {
+    int64_t unsampled = 0;
+    int i;
+
+    for (i = 0; i < ARGON2_METRICS_TYPES; ++i) {
+        unsampled += (int64_t)metrics->hashes_completed[i];
+    }
+    for (i = 0; i < ARGON2_METRICS_LATENCY_BUCKETS; ++i) {
+        unsampled -= (int64_t)metrics->hash_latency[i];
+    }
+    return unsampled;
+}
+
+static void *metrics_hasher(void *arg) {
+    unsigned char out[OUT_LEN];
+    int i;
+
+    for (i = 0; i < 200; ++i) {
+        assert(argon2_hash(1, 8, 1, "password", strlen("password"), "somesalt",
+                           strlen("somesalt"), out, OUT_LEN, NULL, 0,
+                           Argon2_id, *(uint32_t *)arg) == ARGON2_OK);
+    }
+    return NULL;
+}
+#endif
+
+/* Test harness will assert:
+ * argon2_metrics_snapshot() reflects hashes, verifications and failures
+ * snapshots taken while hashes complete see each completion whole
+ */
+void metricstest(uint32_t version) {
+    argon2_metrics before, after;
+    unsigned char out[OUT_LEN];
+    char encoded[ENCODED_LEN];
+    uint64_t latencies;
+    int ret, i;
+
+    argon2_metrics_snapshot(&before);
+    ret = argon2_hash(2, 1 << 8, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), out, OUT_LEN, encoded,
+                      ENCODED_LEN, Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    ret = argon2_verify(encoded, "passwore", strlen("passwore"), Argon2_id);
+    assert(ret == ARGON2_VERIFY_MISMATCH);
+    ret = argon2_hash(2, 1, 1, "password", strlen("password"), "somesalt",
+                      strlen("somesalt"), out, OUT_LEN, NULL, 0, Argon2_d,
+                      version);
+    assert(ret == ARGON2_MEMORY_TOO_LITTLE);
+    argon2_metrics_snapshot(&after);
+
+    assert(after.hashes_started[Argon2_id] ==
+           before.hashes_started[Argon2_id] + 2);
+    assert(after.hashes_completed[Argon2_id] ==
+           before.hashes_completed[Argon2_id] + 2);
+    assert(after.verifies_started[Argon2_id] ==
+           before.verifies_started[Argon2_id] + 1);
+    assert(after.verifies_completed[Argon2_id] ==
+           before.verifies_completed[Argon2_id] + 1);
+    assert(after.hashes_completed[Argon2_d] ==
+           before.hashes_completed[Argon2_d] + 1);
+    assert(after.failures[-ARGON2_VERIFY_MISMATCH] ==
+           before.failures[-ARGON2_VERIFY_MISMATCH] + 1);
+    assert(after.failures[-ARGON2_MEMORY_TOO_LITTLE] ==
+           before.failures[-ARGON2_MEMORY_TOO_LITTLE] + 1);
+    assert(after.bytes_allocated == before.bytes_allocated);
+    assert(after.pool_occupancy == 0);
+
+    latencies = 0;
+    for (i = 0; i < ARGON2_METRICS_LATENCY_BUCKETS; ++i) {
+        latencies += after.hash_latency[i] - before.hash_latency[i];
+    }
+    assert(latencies == 3);
+    printf("Count hashes, verifications and failures: PASS\n");
+
+#if !defined(_WIN32) && !defined(ARGON2_NO_THREADS)
+    {
+        pthread_t threads[4];
+        int64_t unsampled = metrics_unsampled(&after);
+
+        for (i = 0; i < 4; ++i) {
+            assert(pthread_create(&threads[i], NULL, metrics_hasher,
+                                  &version) == 0);
+        }
+        for (i = 0; i < 2000; ++i) {
+            argon2_metrics_snapshot(&after);
+            assert(metrics_unsampled(&after) == unsampled);
+        }
+        for (i = 0; i < 4; ++i) {
+            assert(pthread_join(threads[i], NULL) == 0);
+        }
+        argon2_metrics_snapshot(&after);
+        assert(metrics_unsampled(&after) == unsampled);
+    }
+    printf("Snapshot metrics while hashes complete: PASS\n");
+#endif
+}
+
+/* Test harness will assert:
+ * admission-controlled hashes still produce the expected output
+ * the scheduler gauges follow argon2_sched_configure()
+ */
+void schedtest(uint32_t version) {
+    argon2_sched_config config;
+    argon2_metrics metrics;
+    unsigned char out[OUT_LEN];
+    unsigned char hex_out[OUT_LEN * 2 + 4];
+    int ret, i;
+
+    config.dram_threshold = 1 << 8;
+    config.max_concurrency = 1;
+    config.bandwidth_cap = 0;
+    config.adaptive = 1;
+    ret = argon2_sched_configure(&config);
+#if defined(ARGON2_NO_THREADS)
+    assert(ret == ARGON2_THREAD_FAIL);
+    return;
+#endif
+    assert(ret == ARGON2_OK);
+    argon2_metrics_snapshot(&metrics);
+    assert(metrics.sched_limit == 1);
+
+    ret = argon2_hash(2, 1 << 8, 2, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), out, OUT_LEN, NULL, 0,
+                      Argon2_i, version);
+    assert(ret == ARGON2_OK);
+    for (i = 0; i < OUT_LEN; ++i)
+        sprintf((char *)(hex_out + i * 2), "%02x", out[i]);
+    assert(memcmp(hex_out, "4ff5ce2769a1d7f4c8a491df09d41a9f"
+                           "be90e5eb02155a13e4c01e20cd4eab61",
+                  OUT_LEN * 2) == 0);
+    argon2_metrics_snapshot(&metrics);
+    assert(metrics.sched_running == 0);
+    assert(metrics.queue_depth == 0);
+    printf("Hash under admission control: PASS\n");
+
+    ret = argon2_sched_configure(NULL);
+    assert(ret == ARGON2_OK);
+    argon2_metrics_snapshot(&metrics);
+    assert(metrics.sched_limit == 0);
+    printf("Turn admission control off: PASS\n");
+}
+
+/* Writes a PSI file reporting @avg10 as the "some avg10" figure */
+static void write_pressure(const char *path, const char *avg10) {
+    FILE *file = fopen(path, "w");
+    assert(file != NULL);
+    fprintf(file, "some avg10=%s avg60=0.00 avg300=0.00 total=0\n"
+                  "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n",
+            avg10);
+    fclose(file);
+}
+
+/* Waits up to ten seconds for the admission limit to reach @limit */
+static int64_t wait_sched_limit(int64_t limit) {
+    argon2_metrics metrics;
+    time_t deadline = time(NULL) + 10;
+    do {
+        argon2_metrics_snapshot(&metrics);
+    } while (metrics.sched_limit != limit && time(NULL) < deadline);
+    return metrics.sched_limit;
+}
+
+/* Test harness will assert:
+ * a missing pressure file is reported
+ * pressure above the thresholds serializes, then queues admissions
+ * admission resumes as pressure subsides
+ */
+void pressuretest(uint32_t version) {
+    const char *path = "pressure.test";
+    argon2_pressure_config config;
+    argon2_sched_config sched;
+    argon2_metrics metrics;
+    unsigned char out[OUT_LEN];
+    int ret;
+
+    memset(&config, 0, sizeof(config));
+    config.path = "/nonexistent/memory.pressure";
+    config.slow_threshold = 1000;
+    config.stop_threshold = 5000;
+    config.interval_ms = 10;
+    ret = argon2_pressure_configure(&config);
+#if defined(ARGON2_NO_THREADS)
+    assert(ret == ARGON2_THREAD_FAIL);
+    (void)path;
+    (void)sched;
+    (void)metrics;
+    (void)out;
+    (void)version;
+    return;
+#endif
+    assert(ret == ARGON2_PRESSURE_UNAVAILABLE);
+    printf("Fail on missing pressure file: PASS\n");
+
+    sched.dram_threshold = 1 << 8;
+    sched.max_concurrency = 4;
+    sched.bandwidth_cap = 0;
+    sched.adaptive = 0;
+    ret = argon2_sched_configure(&sched);
+    assert(ret == ARGON2_OK);
+
+    write_pressure(path, "60.00");
+    config.path = path;
+    ret = argon2_pressure_configure(&config);
+    assert(ret == ARGON2_OK);
+    argon2_metrics_snapshot(&metrics);
+    assert(metrics.memory_pressure == 6000);
+    assert(metrics.pressure_throttles >= 1);
+    assert(metrics.sched_limit == 0);
+    printf("Queue hashes above the stop threshold: PASS\n");
+
+    /* Below 3/4 of the stop threshold but above the slow one */
+    write_pressure(path, "20.00");
+    assert(wait_sched_limit(1) == 1);
+    ret = argon2_hash(2, 1 << 8, 2, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), out, OUT_LEN, NULL, 0,
+                      Argon2_i, version);
+    assert(ret == ARGON2_OK);
+    printf("Serialize hashes above the slow threshold: PASS\n");
+
+    write_pressure(path, "5.00");
+    assert(wait_sched_limit(4) == 4);
+    printf("Resume as pressure subsides: PASS\n");
+
+    ret = argon2_pressure_configure(NULL);
+    assert(ret == ARGON2_OK);
+    argon2_metrics_snapshot(&metrics);
+    assert(metrics.memory_pressure == 0);
+    ret = argon2_sched_configure(NULL);
+    assert(ret == ARGON2_OK);
+    remove(path);
+}
+
+static char upgraded[128];
+static int upgrade_result = 1;
+
+static void upgrade_done(int result, const char *encoded, void *arg) {
+    assert(arg == (void *)upgraded);
+    if (result == ARGON2_OK) {
+        assert(strlen(encoded) < sizeof(upgraded));
+        strcpy(upgraded, encoded);
+    }
+    upgrade_result = result;
+}
+
+/* Test harness will assert:
+ * a wrong password is reported at once and never rehashed
+ * a hash already made with the new parameters is left alone
+ * a matching password is rehashed with the new parameters in the background
+ * rehashes are charged to tenant 0 but never wait for admission
+ */
+void upgradetest(uint32_t version) {
+    argon2_upgrade_params params;
+    argon2_sched_config sched;
+    argon2_tenant_metrics before, after;
+    argon2_metrics metrics;
+    char encoded[128];
+    time_t deadline;
+    int ret;
+
+    ret = argon2_hash(2, 1 << 8, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, encoded,
+                      sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+
+    params.type = Argon2_id;
+    params.version = ARGON2_VERSION_13;
+    params.t_cost = 3;
+    params.m_cost = 1 << 9;
+    params.parallelism = 2;
+    params.salt = (const uint8_t *)"diffsalt";
+    params.saltlen = strlen("diffsalt");
+    params.hashlen = OUT_LEN;
+
+    ret = argon2_verify_and_upgrade(encoded, "wrong", strlen("wrong"),
+                                    Argon2_id, &params, upgrade_done,
+                                    upgraded);
+    assert(ret == ARGON2_VERIFY_MISMATCH);
+    assert(upgrade_result == 1);
+    printf("Never upgrade on mismatch: PASS\n");
+
+    ret = argon2_verify_and_upgrade(encoded, "password", strlen("password"),
+                                    Argon2_id, &params, upgrade_done,
+                                    upgraded);
+    assert(ret == ARGON2_OK);
+    deadline = time(NULL) + 10;
+    do {
+        argon2_metrics_snapshot(&metrics);
+    } while (metrics.upgrades_pending != 0 && time(NULL) < deadline);
+    assert(metrics.upgrades_pending == 0);
+    assert(upgrade_result == ARGON2_OK);
+    assert(strncmp(upgraded, "$argon2id$v=19$m=512,t=3,p=2$",
+                   strlen("$argon2id$v=19$m=512,t=3,p=2$")) == 0);
+    ret = argon2_verify(upgraded, "password", strlen("password"), Argon2_id);
+    assert(ret == ARGON2_OK);
+    printf("Upgrade off the caller's path: PASS\n");
+
+    upgrade_result = 1;
+    ret = argon2_verify_and_upgrade(upgraded, "password", strlen("password"),
+                                    Argon2_id, &params, upgrade_done,
+                                    upgraded);
+    assert(ret == ARGON2_OK);
+    assert(upgrade_result == 1);
+    printf("Leave current hashes alone: PASS\n");
+
+    /* The rehash is above the DRAM threshold, the verification is not */
+    sched.dram_threshold = 1 << 9;
+    sched.max_concurrency = 1;
+    sched.bandwidth_cap = 0;
+    sched.adaptive = 0;
+    argon2_sched_configure(&sched);
+    argon2_tenant_snapshot(0, &before);
+    upgrade_result = 1;
+    ret = argon2_verify_and_upgrade(encoded, "password", strlen("password"),
+                                    Argon2_id, &params, upgrade_done,
+                                    upgraded);
+    assert(ret == ARGON2_OK);
+    deadline = time(NULL) + 10;
+    do {
+        argon2_metrics_snapshot(&metrics);
+    } while (metrics.upgrades_pending != 0 && time(NULL) < deadline);
+    assert(upgrade_result == ARGON2_OK);
+    argon2_tenant_snapshot(0, &after);
+    argon2_sched_configure(NULL);
+#if !defined(ARGON2_NO_THREADS)
+    /* Only the verification was admitted, but both are charged */
+    assert(after.admitted == before.admitted + 1);
+    assert(after.blocks == before.blocks + 2 * (1 << 8) + 3 * (1 << 9));
+#else
+    (void)after;
+#endif
+    printf("Rehash outside admission control: PASS\n");
+}
+
+/* Test harness will assert:
+ * a checkpointed hash gives the plain output and leaves no file behind
+ * a computation killed after a pass boundary resumes to the same output
+ * a checkpoint cannot be resumed with other inputs
+ * a hash whose checkpoint cannot be written releases its memory
+ */
+void checkpointtest(uint32_t version) {
+    const char *path = "checkpoint.test";
+    unsigned char out[OUT_LEN];
+    unsigned char expected[OUT_LEN];
+    argon2_context context;
+    argon2_metrics before, after;
+    FILE *file;
+    int ret;
+#if !defined(_WIN32)
+    time_t deadline;
+    pid_t child;
+#endif
+
+    memset(&context, 0, sizeof(context));
+    context.out = expected;
+    context.outlen = OUT_LEN;
+    context.pwd = (uint8_t *)"password";
+    context.pwdlen = strlen("password");
+    context.salt = (uint8_t *)"somesalt";
+    context.saltlen = strlen("somesalt");
+    context.t_cost = 10;
+    context.m_cost = 1 << 13;
+    context.lanes = 2;
+    context.threads = 2;
+    context.version = version;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    ret = argon2_ctx(&context, Argon2_id);
+    assert(ret == ARGON2_OK);
+
+    context.out = out;
+    ret = argon2_ctx_checkpoint(&context, Argon2_id, path);
+    assert(ret == ARGON2_OK);
+    assert(memcmp(out, expected, OUT_LEN) == 0);
+    assert(fopen(path, "rb") == NULL);
+    printf("Hash with checkpoints: PASS\n");
+
+    ret = argon2_resume(path, &context);
+    assert(ret == ARGON2_CHECKPOINT_FAIL);
+    printf("Fail on missing checkpoint: PASS\n");
+
+    argon2_metrics_snapshot(&before);
+    ret = argon2_ctx_checkpoint(&context, Argon2_id,
+                                "no-such-directory/checkpoint.test");
+    assert(ret == ARGON2_CHECKPOINT_FAIL);
+    argon2_metrics_snapshot(&after);
+    assert(after.bytes_allocated == before.bytes_allocated);
+    printf("Release the memory of a failed checkpoint: PASS\n");
+
+#if !defined(_WIN32)
+    fflush(stdout);
+    child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        argon2_ctx_checkpoint(&context, Argon2_id, path);
+        _exit(0);
+    }
+    /* Checkpoints appear whole, by rename: kill the child at the first */
+    deadline = time(NULL) + 30;
+    while ((file = fopen(path, "rb")) == NULL && time(NULL) < deadline) {
+    }
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    assert(file != NULL);
+    fclose(file);
+
+    context.pwd = (uint8_t *)"passwore";
+    ret = argon2_resume(path, &context);
+    assert(ret == ARGON2_CHECKPOINT_MISMATCH);
+    printf("Refuse a checkpoint of other inputs: PASS\n");
+
+    context.pwd = (uint8_t *)"password";
+    memset(out, 0, OUT_LEN);
+    ret = argon2_resume(path, &context);
+    assert(ret == ARGON2_OK);
+    assert(memcmp(out, expected, OUT_LEN) == 0);
+    assert(fopen(path, "rb") == NULL);
+    printf("Resume a killed computation: PASS\n");
+#else
+    (void)file;
+#endif
+}
+
+static volatile int verified[5];
+
+static void verify_done(int result, void *arg) {
+    *(volatile int *)arg = result;
+}
+
+/* Test harness will assert:
+ * every asynchronous request gets its own result
+ * identical requests in flight share one verification
+ */
+void asynctest(uint32_t version) {
+    argon2_metrics before, after;
+    char encoded[128];
+    time_t deadline;
+    int ret, i, pending;
+
+    ret = argon2_hash(2, 1 << 16, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, encoded,
+                      sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+
+    argon2_metrics_snapshot(&before);
+    for (i = 0; i < 5; ++i) {
+        verified[i] = 1;
+    }
+    for (i = 0; i < 4; ++i) {
+        ret = argon2_verify_async(encoded, "password", strlen("password"),
+                                  Argon2_id, verify_done,
+                                  (void *)&verified[i]);
+        assert(ret == ARGON2_OK);
+    }
+    ret = argon2_verify_async(encoded, "wrong", strlen("wrong"), Argon2_id,
+                              verify_done, (void *)&verified[4]);
+    assert(ret == ARGON2_OK);
+
+    deadline = time(NULL) + 30;
+    do {
+        for (i = 0, pending = 0; i < 5; ++i) {
+            pending += verified[i] == 1;
+        }
+    } while (pending != 0 && time(NULL) < deadline);
+    for (i = 0; i < 4; ++i) {
+        assert(verified[i] == ARGON2_OK);
+    }
+    assert(verified[4] == ARGON2_VERIFY_MISMATCH);
+    printf("Verify asynchronously: PASS\n");
+
+    argon2_metrics_snapshot(&after);
+#if !defined(ARGON2_NO_THREADS)
+    assert(after.verify_coalesced == before.verify_coalesced + 3);
+#else
+    assert(after.verify_coalesced == before.verify_coalesced);
+#endif
+    printf("Coalesce identical requests: PASS\n");
+
+#if !defined(_WIN32) && !defined(ARGON2_NO_THREADS)
+    {
+        pid_t child;
+        int status;
+
+        /* The child must not wait for the parent's workers, nor attach to
+         * the verification the parent has in flight */
+        verified[0] = 1;
+        ret = argon2_verify_async(encoded, "password", strlen("password"),
+                                  Argon2_id, verify_done,
+                                  (void *)&verified[0]);
+        assert(ret == ARGON2_OK);
+        fflush(stdout);
+        child = fork();
+        assert(child >= 0);
+        if (child == 0) {
+            alarm(30);
+            verified[1] = 1;
+            ret = argon2_verify_async(encoded, "password", strlen("password"),
+                                      Argon2_id, verify_done,
+                                      (void *)&verified[1]);
+            while (ret == ARGON2_OK && verified[1] == 1) {
+            }
+            _exit(ret == ARGON2_OK && verified[1] == ARGON2_OK ? 0 : 1);
+        }
+        assert(waitpid(child, &status, 0) == child);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        deadline = time(NULL) + 30;
+        while (verified[0] == 1 && time(NULL) < deadline) {
+        }
+        assert(verified[0] == ARGON2_OK);
+        printf("Verify asynchronously in a forked child: PASS\n");
+    }
+#endif
+}
+
+static volatile int tenant_results[8];
+static volatile int tenant_finished;
+
+/* Records the order in which verifications finish, not their result */
+static void tenant_done(int result, void *arg) {
+    (void)result;
+    *(volatile int *)arg = tenant_finished++;
+}
+
+/* Submits @count verifications of distinct passwords for @tenant, whose
+ * completion order lands in tenant_results from @first on */
+static void tenant_submit(const char *encoded, uint32_t tenant, int first,
+                          int count) {
+    char pwd[16];
+    int i, ret;
+
+    for (i = first; i < first + count; ++i) {
+        tenant_results[i] = -1;
+        sprintf(pwd, "password%d", i);
+        ret = argon2_verify_async_tenant(encoded, pwd, strlen(pwd), Argon2_id,
+                                         tenant, tenant_done,
+                                         (void *)&tenant_results[i]);
+        assert(ret == ARGON2_OK);
+    }
+}
+
+/* Waits for @count verifications, checking that the running hashes of
+ * @tenant never exceed @max_running nor @max_memory KiB */
+static void tenant_wait(uint32_t tenant, int count, int64_t max_running,
+                        int64_t max_memory) {
+    argon2_tenant_metrics metrics;
+    time_t deadline = time(NULL) + 30;
+    int i, pending;
+
+    do {
+        argon2_tenant_snapshot(tenant, &metrics);
+        assert(metrics.running <= max_running);
+        assert(metrics.memory <= max_memory);
+        for (i = 0, pending = 0; i < count; ++i) {
+            pending += tenant_results[i] == -1;
+        }
+    } while (pending != 0 && time(NULL) < deadline);
+    assert(pending == 0);
+}
+
+/* Test harness will assert:
+ * hashes and verifications are accounted to their tenant
+ * tenant 0 is accounted the same whether or not its hashes take the
+ *   scheduler lock, and caps on it apply
+ * a tenant never exceeds its concurrency and memory caps
+ * a tenant flooding the scheduler does not hold back another one
+ * tenants without configuration past the table's limit share tenant 0
+ */
+void tenanttest(uint32_t version) {
+    argon2_tenant_config config;
+    argon2_tenant_metrics metrics, before;
+    argon2_sched_config sched;
+    argon2_context context;
+    uint8_t out[OUT_LEN];
+    char encoded[128], blocker[128];
+    int ret, i;
+
+    ret = argon2_hash(1, 1 << 12, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, encoded,
+                      sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    ret = argon2_hash(2, 1 << 16, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, blocker,
+                      sizeof(blocker), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+
+    memset(&config, 0, sizeof(config));
+    config.max_concurrency = 1;
+    ret = argon2_tenant_configure(7, &config);
+#if defined(ARGON2_NO_THREADS)
+    assert(ret == ARGON2_THREAD_FAIL);
+    ret = argon2_verify_tenant(encoded, "password", strlen("password"),
+                               Argon2_id, 7);
+    assert(ret == ARGON2_OK);
+    (void)metrics;
+    (void)before;
+    (void)sched;
+    (void)blocker;
+    (void)context;
+    (void)out;
+    (void)i;
+    return;
+#endif
+    assert(ret == ARGON2_OK);
+
+    memset(&context, 0, sizeof(context));
+    context.out = out;
+    context.outlen = OUT_LEN;
+    context.pwd = (uint8_t *)"password";
+    context.pwdlen = (uint32_t)strlen("password");
+    context.salt = (uint8_t *)"somesalt";
+    context.saltlen = (uint32_t)strlen("somesalt");
+    context.t_cost = 1;
+    context.m_cost = 8;
+    context.lanes = 1;
+    context.threads = 1;
+    context.version = version;
+
+    ret = argon2_verify_tenant(encoded, "password", strlen("password"),
+                               Argon2_id, 7);
+    assert(ret == ARGON2_OK);
+    ret = argon2_tenant_snapshot(7, &metrics);
+    assert(ret == ARGON2_OK);
+    assert(metrics.admitted == 1);
+    assert(metrics.running == 0 && metrics.queued == 0);
+    argon2_tenant_snapshot(9, &metrics);
+    assert(metrics.admitted == 0);
+    printf("Account hashes to their tenant: PASS\n");
+
+    /* Without caps nor admission control, tenant 0 skips the lock */
+    argon2_tenant_snapshot(0, &before);
+    ret = argon2_ctx(&context, Argon2_id);
+    assert(ret == ARGON2_OK);
+    argon2_tenant_snapshot(0, &metrics);
+    assert(metrics.admitted == before.admitted + 1);
+    assert(metrics.blocks == before.blocks + 8);
+    assert(metrics.running == 0 && metrics.memory == 0);
+    ret = argon2_tenant_configure(0, &config);
+    assert(ret == ARGON2_OK);
+    tenant_finished = 0;
+    tenant_submit(encoded, 0, 0, 4);
+    tenant_wait(0, 4, 1, 1 << 12);
+    argon2_tenant_snapshot(0, &metrics);
+    assert(metrics.admitted == before.admitted + 5);
+    assert(metrics.running == 0 && metrics.memory == 0);
+    argon2_tenant_configure(0, NULL);
+    printf("Account and cap tenant 0 with and without the lock: PASS\n");
+
+    tenant_finished = 0;
+    tenant_submit(encoded, 7, 0, 4);
+    tenant_wait(7, 4, 1, 1 << 12);
+    argon2_tenant_snapshot(7, &metrics);
+    assert(metrics.admitted == 5);
+    assert(metrics.delayed >= 1);
+    assert(metrics.running == 0 && metrics.queued == 0 && metrics.memory == 0);
+    printf("Cap the concurrency of a tenant: PASS\n");
+
+    config.max_concurrency = 0;
+    config.max_memory = (1 << 12) + (1 << 11);
+    ret = argon2_tenant_configure(8, &config);
+    assert(ret == ARGON2_OK);
+    tenant_finished = 0;
+    tenant_submit(encoded, 8, 0, 3);
+    tenant_wait(8, 3, 1, config.max_memory);
+    printf("Cap the memory of a tenant: PASS\n");
+
+    sched.dram_threshold = 1 << 8;
+    sched.max_concurrency = 1;
+    sched.bandwidth_cap = 0;
+    sched.adaptive = 0;
+    ret = argon2_sched_configure(&sched);
+    assert(ret == ARGON2_OK);
+    /* The slot is held by a longer hash while both queues fill up */
+    tenant_finished = 0;
+    tenant_submit(blocker, 13, 7, 1);
+    tenant_submit(encoded, 11, 0, 6);
+    tenant_submit(encoded, 12, 6, 1);
+    tenant_wait(12, 8, 1, 1 << 16);
+    /* First in line, it would come last */
+    assert(tenant_results[7] == 0);
+    assert(tenant_results[6] <= 2);
+    printf("Share admissions fairly between tenants: PASS\n");
+
+    ret = argon2_sched_configure(NULL);
+    assert(ret == ARGON2_OK);
+    argon2_tenant_configure(7, NULL);
+    argon2_tenant_configure(8, NULL);
+
+    /* Ids past the table's limit share tenant 0, configured ones do not */
+    argon2_tenant_snapshot(0, &before);
+    for (i = 0; i < 4200; ++i) {
+        ret = argon2_ctx_tenant(&context, Argon2_id, 100000 + i);
+        assert(ret == ARGON2_OK);
+    }
+    argon2_tenant_snapshot(100000, &metrics);
+    assert(metrics.admitted == 1);
+    argon2_tenant_snapshot(100000 + 4199, &metrics);
+    assert(metrics.admitted == 0);
+    argon2_tenant_snapshot(0, &metrics);
+    assert(metrics.admitted >= before.admitted + 104);
+    memset(&config, 0, sizeof(config));
+    ret = argon2_tenant_configure(200000, &config);
+    assert(ret == ARGON2_OK);
+    ret = argon2_ctx_tenant(&context, Argon2_id, 200000);
+    assert(ret == ARGON2_OK);
+    argon2_tenant_snapshot(200000, &metrics);
+    assert(metrics.admitted == 1);
+    printf("Bound the tenants without configuration: PASS\n");
+}
+
+/* Test harness will assert:
+ * a hash reports the blocks it computed and the memory it allocated
+ * the CPU time of a hash includes the worker threads that filled it
+ * a verification reports its cost whatever its result
+ * costs are summed per tenant, with the time spent queued
+ */
+void costtest(uint32_t version) {
+    argon2_context context;
+    argon2_cost cost, single;
+    argon2_tenant_metrics before, after;
+    argon2_tenant_config config;
+    uint8_t out[OUT_LEN];
+    char encoded[128], blocker[128];
+    int ret;
+
+    memset(&context, 0, sizeof(context));
+    context.out = out;
+    context.outlen = OUT_LEN;
+    context.pwd = (uint8_t *)"password";
+    context.pwdlen = (uint32_t)strlen("password");
+    context.salt = (uint8_t *)"somesalt";
+    context.saltlen = (uint32_t)strlen("somesalt");
+    context.t_cost = 2;
+    context.m_cost = 1 << 14;
+    context.lanes = 1;
+    context.threads = 1;
+    context.version = version;
+
+    ret = argon2_ctx_cost(&context, Argon2_id, 0, &single);
+    assert(ret == ARGON2_OK);
+    assert(single.blocks == 2 << 14);
+    assert(single.memory == (uint64_t)1024 << 14);
+    assert(single.queue_time == 0);
+#if defined(_WIN32) || defined(CLOCK_THREAD_CPUTIME_ID)
+    assert(single.cpu_time > 0);
+#endif
+    printf("Report the blocks and memory of a hash: PASS\n");
+
+    /* The calling thread only waits while the pool fills the lanes */
+    context.lanes = 4;
+    context.threads = 4;
+    ret = argon2_ctx_cost(&context, Argon2_id, 0, &cost);
+    assert(ret == ARGON2_OK);
+    assert(cost.blocks == single.blocks);
+    assert(cost.cpu_time >= single.cpu_time / 4);
+    printf("Include worker threads in the CPU time: PASS\n");
+
+    ret = argon2_hash(1, 1 << 12, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, encoded,
+                      sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    ret = argon2_verify_cost(encoded, "wrong", strlen("wrong"), Argon2_id, 0,
+                             &cost);
+    assert(ret == ARGON2_VERIFY_MISMATCH);
+    assert(cost.blocks == 1 << 12);
+    assert(cost.memory == (uint64_t)1024 << 12);
+    ret = argon2_verify_cost("$argon2id$", "password", strlen("password"),
+                             Argon2_id, 0, &cost);
+    assert(ret == ARGON2_DECODING_FAIL);
+    assert(cost.blocks == 0 && cost.memory == 0);
+    printf("Report the cost of verifications: PASS\n");
+
+    ret = argon2_tenant_snapshot(21, &before);
+#if defined(ARGON2_NO_THREADS)
+    assert(ret == ARGON2_THREAD_FAIL);
+    (void)after;
+    (void)config;
+    (void)blocker;
+    return;
+#endif
+    assert(ret == ARGON2_OK);
+    /* Configured, it has an entry of its own whatever the tenants before */
+    memset(&config, 0, sizeof(config));
+    ret = argon2_tenant_configure(21, &config);
+    assert(ret == ARGON2_OK);
+    ret = argon2_ctx_cost(&context, Argon2_id, 21, &cost);
+    assert(ret == ARGON2_OK);
+    ret = argon2_verify_cost(encoded, "password", strlen("password"),
+                             Argon2_id, 21, &single);
+    assert(ret == ARGON2_OK);
+    argon2_tenant_snapshot(21, &after);
+    assert(after.cpu_time - before.cpu_time == cost.cpu_time + single.cpu_time);
+    assert(after.allocated - before.allocated == cost.memory + single.memory);
+    assert(after.blocks - before.blocks == cost.blocks + single.blocks);
+
+    ret = argon2_hash(2, 1 << 16, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, blocker,
+                      sizeof(blocker), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    memset(&config, 0, sizeof(config));
+    config.max_concurrency = 1;
+    ret = argon2_tenant_configure(22, &config);
+    assert(ret == ARGON2_OK);
+    /* Admitted before it returns, the blocker holds the only slot */
+    tenant_finished = 0;
+    tenant_submit(blocker, 22, 0, 1);
+    ret = argon2_verify_cost(encoded, "password", strlen("password"),
+                             Argon2_id, 22, &cost);
+    assert(ret == ARGON2_OK);
+    assert(cost.queue_time > 0);
+    tenant_wait(22, 1, 1, 1 << 16);
+    argon2_tenant_snapshot(22, &after);
+    assert(after.blocks == (2 << 16) + (1 << 12));
+    assert(after.queue_time >= cost.queue_time);
+    argon2_tenant_configure(21, NULL);
+    argon2_tenant_configure(22, NULL);
+    printf("Sum costs per tenant: PASS\n");
+}
+
+static volatile int batch_results[8];
+
+/* Test harness will assert:
+ * a batch size of 0 is refused
+ * verifications of the same parameters are gathered into batches while
+ *   hashes wait for admission, and each gets its own result
+ * a batch that does not fill is dispatched once its window is over
+ */
+void batchtest(uint32_t version) {
+    argon2_batch_config config;
+    argon2_sched_config sched;
+    argon2_metrics before, after;
+    char encoded[128], blocker[128], pwd[16];
+    time_t deadline;
+    int ret, i, pending;
+
+    config.window_us = 100000;
+    config.max_batch = 0;
+    ret = argon2_batch_configure(&config);
+#if defined(ARGON2_NO_THREADS)
+    assert(ret == ARGON2_THREAD_FAIL);
+    (void)sched;
+    (void)before;
+    (void)after;
+    (void)encoded;
+    (void)blocker;
+    (void)pwd;
+    (void)deadline;
+    (void)i;
+    (void)pending;
+    (void)version;
+    return;
+#endif
+    assert(ret == ARGON2_INCORRECT_PARAMETER);
+    printf("Refuse empty batches: PASS\n");
+
+    ret = argon2_hash(1, 1 << 12, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, encoded,
+                      sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    ret = argon2_hash(2, 1 << 16, 1, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, blocker,
+                      sizeof(blocker), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+
+    sched.dram_threshold = 1 << 8;
+    sched.max_concurrency = 1;
+    sched.bandwidth_cap = 0;
+    sched.adaptive = 0;
+    ret = argon2_sched_configure(&sched);
+    assert(ret == ARGON2_OK);
+    config.max_batch = 4;
+    ret = argon2_batch_configure(&config);
+    assert(ret == ARGON2_OK);
+
+    /* The slot is held by a longer hash, so that the others queue up */
+    argon2_metrics_snapshot(&before);
+    batch_results[7] = 1;
+    ret = argon2_verify_async(blocker, "password", strlen("password"),
+                              Argon2_id, verify_done,
+                              (void *)&batch_results[7]);
+    assert(ret == ARGON2_OK);
+    for (i = 0; i < 7; ++i) {
+        batch_results[i] = 1;
+        sprintf(pwd, i == 3 ? "password" : "password%d", i);
+        ret = argon2_verify_async(encoded, pwd, strlen(pwd), Argon2_id,
+                                  verify_done, (void *)&batch_results[i]);
+        assert(ret == ARGON2_OK);
+    }
+
+    deadline = time(NULL) + 30;
+    do {
+        for (i = 0, pending = 0; i < 8; ++i) {
+            pending += batch_results[i] == 1;
+        }
+    } while (pending != 0 && time(NULL) < deadline);
+    assert(pending == 0);
+    for (i = 0; i < 7; ++i) {
+        assert(batch_results[i] ==
+               (i == 3 ? ARGON2_OK : ARGON2_VERIFY_MISMATCH));
+    }
+    assert(batch_results[7] == ARGON2_OK);
+    argon2_metrics_snapshot(&after);
+    assert(after.verify_batches >= before.verify_batches + 2);
+    assert(after.verify_batched >= before.verify_batched + 6);
+    printf("Gather verifications into batches: PASS\n");
+    printf("Dispatch batches once their window is over: PASS\n");
+
+    ret = argon2_batch_configure(NULL);
+    assert(ret == ARGON2_OK);
+    ret = argon2_sched_configure(NULL);
+    assert(ret == ARGON2_OK);
+}
+
+#if !defined(_WIN32) && !defined(ARGON2_NO_THREADS)
+/* A node that takes connections into its backlog and never answers; closing
+ * it resets them */
+static int node_black_hole(char *spec) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    assert(fd >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(fd, 16) == 0);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    sprintf(spec, "127.0.0.1:%u", (unsigned)ntohs(addr.sin_port));
+    return fd;
+}
+
+/* Connects to the node on @port of the loopback address */
+static int node_connect(unsigned port, int window) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    assert(fd >= 0);
+    if (window != 0) {
+        assert(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &window,
+                          sizeof(window)) == 0);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+/* Pipelines hashes with long results to the node on @port without ever
+ * reading them, until the node drops the connection
+ * @return 0 once dropped, -1 if still connected after 30 seconds */
+static int node_flood(unsigned port) {
+    /* length, id, op, type, tenant, t_cost, m_cost, lanes, hash length,
+     * salt length, then the salt and password */
+    static const uint32_t fields[10] = {52, 0, 2, 2, 0, 1, 8, 1, 4096, 8};
+    uint8_t frame[56];
+    struct timespec pause = {0, 1000000};
+    time_t deadline = time(NULL) + 30;
+    ssize_t sent;
+    size_t off = 0;
+    int fd = node_connect(port, 4096), i, dropped = 0;
+
+    for (i = 0; i < 40; ++i) {
+        frame[i] = (uint8_t)(fields[i / 4] >> (8 * (i % 4)));
+    }
+    memcpy(frame + 40, "somesaltpassword", 16);
+    while (time(NULL) < deadline) {
+        sent = send(fd, frame + off, sizeof(frame) - off, MSG_DONTWAIT);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        if (sent < 0) {
+            dropped = 1;
+            break;
+        }
+        off = (off + (size_t)sent) % sizeof(frame);
+    }
+    close(fd);
+    return dropped ? 0 : -1;
+}
+
+static struct {
+    argon2_client *client;
+    const char *encoded;
+    int failures;
+} node_load;
+
+/* Verifies through the shared client, alternating right and wrong
+ * passwords */
+static void *node_verify(void *arg) {
+    int i, ret;
+
+    for (i = 0; i < 8; ++i) {
+        ret = argon2_client_verify(node_load.client, 0, node_load.encoded,
+                                   i % 2 ? "password" : "wrong",
+                                   i % 2 ? 8 : 5, Argon2_id);
+        if (ret != (i % 2 ? ARGON2_OK : ARGON2_VERIFY_MISMATCH)) {
+            ++node_load.failures;
+        }
+    }
+    (void)arg;
+    return NULL;
+}
+#endif
+
+/* Test harness will assert:
+ * hashes and verifications through hashing nodes match local ones
+ * nodes refuse costs above their caps
+ * requests of many threads pipelined over a few connections get their own
+ *   results, and least-outstanding balancing keeps most of them off a node
+ *   that never answers, whose requests are hedged to another node
+ * requests on a node that resets are retried on another node
+ * requests no node answers time out
+ * a client that does not read its responses is dropped, and the workers
+ *   it held serve the other clients again
+ * connections past the cap of a node are closed
+ * nodes account requests to their own tenant unless they trust the tenant
+ *   requests name
+ */
+void nodetest(uint32_t version) {
+#if defined(_WIN32) || defined(ARGON2_NO_THREADS)
+    argon2_server *server;
+    assert(argon2_server_start(&server, NULL) == ARGON2_NETWORK_FAIL);
+    (void)version;
+#else
+    argon2_server *servers[3];
+    argon2_server_config server_config;
+    argon2_tenant_metrics before, after, tenant;
+    char specs[5][32], encoded[128], local[128];
+    const char *nodes[4];
+    argon2_client_config config;
+    argon2_client_stats stats;
+    argon2_client *client;
+    pthread_t threads[8];
+    struct timespec pause = {0, 100000000};
+    int ret, i, holes[2];
+
+    /* On the loopback address by default */
+    for (i = 0; i < 3; ++i) {
+        ret = argon2_server_start(&servers[i], NULL);
+        assert(ret == ARGON2_OK);
+        sprintf(specs[i], "127.0.0.1:%u", argon2_server_port(servers[i]));
+        nodes[i] = specs[i];
+    }
+    holes[0] = node_black_hole(specs[3]);
+    holes[1] = node_black_hole(specs[4]);
+
+    memset(&config, 0, sizeof(config));
+    config.nodes = nodes;
+    config.node_count = 0;
+    assert(argon2_client_create(&client, &config) ==
+           ARGON2_INCORRECT_PARAMETER);
+    nodes[3] = "localhost";
+    config.node_count = 4;
+    assert(argon2_client_create(&client, &config) ==
+           ARGON2_INCORRECT_PARAMETER);
+
+    config.node_count = 3;
+    config.connections = 2;
+    ret = argon2_client_create(&client, &config);
+    assert(ret == ARGON2_OK);
+    ret = argon2_client_hash(client, 42, 2, 1 << 10, 2, "password", 8,
+                             "somesalt", 8, OUT_LEN, encoded, sizeof(encoded),
+                             Argon2_id);
+    assert(ret == ARGON2_OK);
+    ret = argon2_hash(2, 1 << 10, 2, "password", 8, "somesalt", 8, NULL,
+                      OUT_LEN, local, sizeof(local), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    assert(strcmp(encoded, local) == 0);
+    assert(argon2_client_hash(client, 42, 2, 1 << 10, 2, "password", 8,
+                              "somesalt", 8, OUT_LEN, encoded, 20,
+                              Argon2_id) == ARGON2_ENCODING_FAIL);
+    assert(argon2_client_verify(client, 42, local, "password", 8,
+                                Argon2_id) == ARGON2_OK);
+    assert(argon2_client_verify(client, 42, local, "wrong", 5, Argon2_id) ==
+           ARGON2_VERIFY_MISMATCH);
+    assert(argon2_client_verify(client, 42, local, "password", 8,
+                                (argon2_type)7) == ARGON2_INCORRECT_TYPE);
+    assert(argon2_client_hash(client, 42, 2, 1 << 21, 1, "password", 8,
+                              "somesalt", 8, OUT_LEN, encoded,
+                              sizeof(encoded),
+                              Argon2_id) == ARGON2_MEMORY_TOO_MUCH);
+    assert(argon2_client_hash(client, 42, 2, 1 << 10, 17, "password", 8,
+                              "somesalt", 8, OUT_LEN, encoded,
+                              sizeof(encoded),
+                              Argon2_id) == ARGON2_LANES_TOO_MANY);
+    ret = argon2_hash(17, 8, 1, "password", 8, "somesalt", 8, NULL, OUT_LEN,
+                      encoded, sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    assert(argon2_client_verify(client, 42, encoded, "password", 8,
+                                Argon2_id) == ARGON2_TIME_TOO_LARGE);
+    argon2_client_destroy(client);
+    printf("Hash and verify on hashing nodes: PASS\n");
+    printf("Refuse costs above the caps of a node: PASS\n");
+
+    /* One node in four never answers */
+    nodes[3] = specs[3];
+    config.node_count = 4;
+    config.hedge_ms = 100;
+    ret = argon2_client_create(&client, &config);
+    assert(ret == ARGON2_OK);
+    node_load.client = client;
+    node_load.encoded = local;
+    node_load.failures = 0;
+    for (i = 0; i < 8; ++i) {
+        assert(pthread_create(&threads[i], NULL, node_verify, NULL) == 0);
+    }
+    for (i = 0; i < 8; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(node_load.failures == 0);
+    argon2_client_snapshot(client, &stats);
+    assert(stats.requests == 64);
+    /* Round-robin would have sent 16 there */
+    assert(stats.hedges >= 1 && stats.hedges < 8);
+    assert(stats.timeouts == 0);
+    argon2_client_destroy(client);
+    printf("Pipeline requests to the least loaded nodes: PASS\n");
+    printf("Hedge requests a node does not answer: PASS\n");
+
+    /* The first request goes to the first node, which resets */
+    nodes[0] = specs[4];
+    nodes[1] = specs[1];
+    config.node_count = 2;
+    config.hedge_ms = 0;
+    ret = argon2_client_create(&client, &config);
+    assert(ret == ARGON2_OK);
+    node_load.client = client;
+    node_load.failures = 0;
+    assert(pthread_create(&threads[0], NULL, node_verify, NULL) == 0);
+    nanosleep(&pause, NULL);
+    close(holes[1]);
+    pthread_join(threads[0], NULL);
+    assert(node_load.failures == 0);
+    argon2_client_snapshot(client, &stats);
+    assert(stats.retries >= 1);
+    argon2_client_destroy(client);
+    printf("Retry requests of a failed node: PASS\n");
+
+    nodes[0] = specs[3];
+    config.node_count = 1;
+    config.timeout_ms = 200;
+    ret = argon2_client_create(&client, &config);
+    assert(ret == ARGON2_OK);
+    assert(argon2_client_verify(client, 0, local, "password", 8,
+                                Argon2_id) == ARGON2_NODE_TIMEOUT);
+    argon2_client_snapshot(client, &stats);
+    assert(stats.timeouts == 1);
+    argon2_client_destroy(client);
+    printf("Time out requests no node answers: PASS\n");
+
+    signal(SIGPIPE, SIG_IGN);
+    assert(node_flood(argon2_server_port(servers[0])) == 0);
+    nodes[0] = specs[0];
+    config.timeout_ms = 0;
+    ret = argon2_client_create(&client, &config);
+    assert(ret == ARGON2_OK);
+    assert(argon2_client_verify(client, 0, local, "password", 8,
+                                Argon2_id) == ARGON2_OK);
+    argon2_client_destroy(client);
+    printf("Drop clients that do not read their responses: PASS\n");
+
+    argon2_server_stop(servers[0]);
+    memset(&server_config, 0, sizeof(server_config));
+    server_config.max_connections = 1;
+    ret = argon2_server_start(&servers[0], &server_config);
+    assert(ret == ARGON2_OK);
+    holes[1] = node_connect(argon2_server_port(servers[0]), 0);
+    nanosleep(&pause, NULL);
+    i = node_connect(argon2_server_port(servers[0]), 0);
+    assert(recv(i, encoded, sizeof(encoded), 0) == 0);
+    close(i);
+    close(holes[1]);
+    signal(SIGPIPE, SIG_DFL);
+    printf("Close connections past the cap: PASS\n");
+
+    argon2_server_stop(servers[0]);
+    server_config.max_connections = 0;
+    server_config.tenant = 43;
+    ret = argon2_server_start(&servers[0], &server_config);
+    assert(ret == ARGON2_OK);
+    server_config.tenant = 0;
+    server_config.trust_tenants = 1;
+    argon2_server_stop(servers[1]);
+    ret = argon2_server_start(&servers[1], &server_config);
+    assert(ret == ARGON2_OK);
+    /* Configured, so tracked even with the tenant table full */
+    assert(argon2_tenant_configure(43, NULL) == ARGON2_OK);
+    assert(argon2_tenant_configure(44, NULL) == ARGON2_OK);
+    argon2_tenant_snapshot(43, &before);
+    argon2_tenant_snapshot(44, &tenant);
+    for (i = 0; i < 2; ++i) {
+        sprintf(specs[i], "127.0.0.1:%u", argon2_server_port(servers[i]));
+        nodes[0] = specs[i];
+        ret = argon2_client_create(&client, &config);
+        assert(ret == ARGON2_OK);
+        assert(argon2_client_verify(client, 44, local, "password", 8,
+                                    Argon2_id) == ARGON2_OK);
+        argon2_client_destroy(client);
+    }
+    argon2_tenant_snapshot(43, &after);
+    assert(after.admitted == before.admitted + 1);
+    argon2_tenant_snapshot(44, &after);
+    assert(after.admitted == tenant.admitted + 1);
+    printf("Account requests to the tenant of a node: PASS\n");
+
+    close(holes[0]);
+    for (i = 0; i < 3; ++i) {
+        argon2_server_stop(servers[i]);
+    }
+#endif
+}
+
+/* Test harness will assert:
+ * a hasher produces the encoded hashes argon2_hash() does
+ * its encoded length is exact, and shorter buffers are refused
+ * invalid parameter sets are refused up front
+ */
+void hashertest(uint32_t version) {
+    argon2_hasher hasher;
+    char encoded[128], expected[128];
+    size_t len;
+    int ret;
+
+    ret = argon2_hasher_init(&hasher, 2, 1 << 10, 2, OUT_LEN, Argon2_id,
+                             version);
+    assert(ret == ARGON2_OK);
+    ret = argon2_hash(2, 1 << 10, 2, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, expected,
+                      sizeof(expected), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+    ret = argon2_hasher_hash(&hasher, "password", strlen("password"),
+                             "somesalt", strlen("somesalt"), encoded,
+                             sizeof(encoded));
+    assert(ret == ARGON2_OK);
+    assert(strcmp(encoded, expected) == 0);
+    assert(argon2_verify(encoded, "password", strlen("password"),
+                         Argon2_id) == ARGON2_OK);
+    printf("Hash with a precomputed header: PASS\n");
+
+    len = argon2_hasher_encodedlen(&hasher, strlen("somesalt"));
+    assert(len == strlen(expected) + 1);
+    ret = argon2_hasher_hash(&hasher, "password", strlen("password"),
+                             "somesalt", strlen("somesalt"), encoded, len);
+    assert(ret == ARGON2_OK);
+    assert(strcmp(encoded, expected) == 0);
+    ret = argon2_hasher_hash(&hasher, "password", strlen("password"),
+                             "somesalt", strlen("somesalt"), encoded,
+                             len - 1);
+    assert(ret == ARGON2_ENCODING_FAIL);
+    printf("Exact encoded length: PASS\n");
+
+    ret = argon2_hasher_init(&hasher, 2, 1 << 10, 2, OUT_LEN, Argon2_id, 42);
+    assert(ret == ARGON2_INCORRECT_PARAMETER);
+    ret = argon2_hasher_init(&hasher, 2, 1, 2, OUT_LEN, Argon2_id, version);
+    assert(ret == ARGON2_MEMORY_TOO_LITTLE);
+    ret = argon2_hasher_init(&hasher, 2, 1 << 10, 2, 1, Argon2_id, version);
+    assert(ret == ARGON2_OUTPUT_TOO_SHORT);
+    printf("Refuse invalid parameter sets: PASS\n");
+}
+
+/* Test harness will assert:
+ * encoded hashes and binary records convert losslessly both ways
+ * a binary record verifies as its encoded hash does
+ * truncated, overlong and malformed records are rejected
+ */
+void binarytest(uint32_t version) {
+    unsigned char record[128];
+    char encoded[128], decoded[128];
+    size_t recordlen = sizeof(record);
+    argon2_type type = Argon2_d;
+    int ret;
+
+    ret = argon2_hash(2, 1 << 12, 2, "password", strlen("password"),
+                      "somesalt", strlen("somesalt"), NULL, OUT_LEN, encoded,
+                      sizeof(encoded), Argon2_id, version);
+    assert(ret == ARGON2_OK);
+
+    ret = argon2_encode_binary(record, &recordlen, encoded, Argon2_id);
+    assert(ret == ARGON2_OK);
+    assert(recordlen == argon2_binarylen(2, 1 << 12, 2, strlen("somesalt"),
+                                         OUT_LEN));
+    assert(recordlen < strlen(encoded));
+    ret = argon2_decode_binary(decoded, sizeof(decoded), record, recordlen,
+                               &type);
+    assert(ret == ARGON2_OK);
+    assert(type == Argon2_id);
+    assert(strcmp(decoded, encoded) == 0);
+    printf("Convert to and from binary records: PASS\n");
+
+    ret = argon2_verify_binary(record, recordlen, "password",
+                               strlen("password"));
+    assert(ret == ARGON2_OK);
+    ret = argon2_verify_binary(record, recordlen, "wrong", strlen("wrong"));
+    assert(ret == ARGON2_VERIFY_MISMATCH);
+    printf("Verify binary records: PASS\n");
+
+    ret = argon2_verify_binary(record, 4, "password", strlen("password"));
+    assert(ret == ARGON2_DECODING_FAIL);
+    ret = argon2_decode_binary(decoded, sizeof(decoded), record, 0, NULL);
+    assert(ret == ARGON2_DECODING_FAIL);
+    /* the salt length as an overlong varint */
+    memmove(record + 6, record + 5, recordlen - 5);
+    record[5] = 0x88;
+    record[6] = 0x00;
+    ret = argon2_verify_binary(record, recordlen + 1, "password",
+                               strlen("password"));
+    assert(ret == ARGON2_DECODING_FAIL);
+    record[0] = 0x23; /* unknown record format */
+    ret = argon2_verify_binary(record, recordlen, "password",
+                               strlen("password"));
+    assert(ret == ARGON2_DECODING_FAIL);
+    recordlen = 8;
+    ret = argon2_encode_binary(record, &recordlen, encoded, Argon2_id);
+    assert(ret == ARGON2_ENCODING_FAIL);
+    printf("Reject malformed binary records: PASS\n");
+}
+
+/* Test harness will assert:
+ * the placement policy is validated and resolved per hash
+ * multi-lane hashes give the same output under every placement
+ * lanes shared by fewer workers, one or in batches of several at a
+ *   time, give the single-threaded output
+ * a child forked after the pool started hashes on workers of its own
+ */
+void placementtest(uint32_t version) {
+    argon2_placement placements[3] = {ARGON2_PLACEMENT_AUTO,
+                                      ARGON2_PLACEMENT_PACK,
+                                      ARGON2_PLACEMENT_SPREAD};
+    unsigned char out[OUT_LEN];
+    unsigned char single[OUT_LEN];
+    unsigned char hex_out[OUT_LEN * 2 + 4];
+    argon2_context context;
+    int ret, i, j;
+#if !defined(_WIN32)
+    pid_t child;
+    int status;
+#endif
+
+    ret = argon2_set_placement((argon2_placement)42);
+#if defined(ARGON2_NO_THREADS)
+    assert(ret == ARGON2_THREAD_FAIL);
+    return;
+#endif
+    assert(ret == ARGON2_INCORRECT_PARAMETER);
+    assert(strcmp(argon2_placement2string(ARGON2_PLACEMENT_PACK), "pack") == 0);
+    assert(argon2_placement2string((argon2_placement)42) == NULL);
+
+    ret = argon2_set_placement(ARGON2_PLACEMENT_AUTO);
+    assert(ret == ARGON2_OK);
+    assert(argon2_placement_for(64, 1) == ARGON2_PLACEMENT_SPREAD);
+    assert(argon2_placement_for(1 << 22, 1) == ARGON2_PLACEMENT_PACK);
+    printf("Resolve auto placement: PASS\n");
+
+    for (j = 0; j < 3; ++j) {
+        ret = argon2_set_placement(placements[j]);
+        assert(ret == ARGON2_OK);
+        ret = argon2_hash(2, 1 << 8, 2, "password", strlen("password"),
+                          "somesalt", strlen("somesalt"), out, OUT_LEN, NULL,
+                          0, Argon2_i, version);
+        assert(ret == ARGON2_OK);
+        for (i = 0; i < OUT_LEN; ++i)
+            sprintf((char *)(hex_out + i * 2), "%02x", out[i]);
+        assert(memcmp(hex_out, "4ff5ce2769a1d7f4c8a491df09d41a9f"
+                               "be90e5eb02155a13e4c01e20cd4eab61",
+                      OUT_LEN * 2) == 0);
+        printf("Hash with %s placement: PASS\n",
+               argon2_placement2string(placements[j]));
+    }
+    argon2_set_placement(ARGON2_PLACEMENT_AUTO);
+
+    memset(&context, 0, sizeof(context));
+    context.outlen = OUT_LEN;
+    context.pwd = (uint8_t *)"password";
+    context.pwdlen = strlen("password");
+    context.salt = (uint8_t *)"somesalt";
+    context.saltlen = strlen("somesalt");
+    context.t_cost = 2;
+    context.m_cost = 1 << 12;
+    context.version = version;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    for (i = 7; i <= 64; i += 57) {
+        context.lanes = i;
+        context.out = single;
+        context.threads = 1;
+        ret = argon2_ctx(&context, Argon2_id);
+        assert(ret == ARGON2_OK);
+        context.out = out;
+        context.threads = 3;
+        ret = argon2_ctx(&context, Argon2_id);
+        assert(ret == ARGON2_OK);
+        assert(memcmp(out, single, OUT_LEN) == 0);
+        printf("Share %d lanes among 3 workers: PASS\n", i);
+    }
+
+#if !defined(_WIN32)
+    /* The workers of the parent do not exist in the child: the child must
+     * start its own rather than wait for them */
+    context.lanes = 4;
+    context.threads = 1;
+    context.m_cost = 1 << 14;
+    context.out = single;
+    ret = argon2_ctx(&context, Argon2_id);
+    assert(ret == ARGON2_OK);
+    context.out = out;
+    context.threads = 4;
+    ret = argon2_ctx(&context, Argon2_id);
+    assert(ret == ARGON2_OK);
+    fflush(stdout);
+    child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        alarm(30);
+        memset(out, 0, OUT_LEN);
+        ret = argon2_ctx(&context, Argon2_id);
+        _exit(ret == ARGON2_OK && memcmp(out, single, OUT_LEN) == 0 ? 0 : 1);
+    }
+    assert(waitpid(child, &status, 0) == child);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    printf("Hash with workers in a forked child: PASS\n");
+#endif
+}
+
+/* Test harness will assert:
+ * every memory layout gives the same output
+ * conflicting layout flags are rejected
+ */
+void layouttest(uint32_t version) {
+    uint32_t layouts[3] = {ARGON2_FLAG_LAYOUT_SEGMENT_MAJOR,
+                           ARGON2_FLAG_LAYOUT_SPLIT_LANES,
+                           ARGON2_FLAG_LAYOUT_SPLIT_LANES |
+                               ARGON2_FLAG_LOCK_MEMORY};
+    unsigned char out[OUT_LEN];
+    unsigned char lane_major[OUT_LEN];
+    argon2_context context;
+    int ret, i;
+
+    memset(&context, 0, sizeof(context));
+    context.out = lane_major;
+    context.outlen = OUT_LEN;
+    context.pwd = (uint8_t *)"password";
+    context.pwdlen = strlen("password");
+    context.salt = (uint8_t *)"somesalt";
+    context.saltlen = strlen("somesalt");
+    context.t_cost = 2;
+    context.m_cost = 1 << 12;
+    context.lanes = 5;
+    context.threads = 5;
+    context.version = version;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    ret = argon2_ctx(&context, Argon2_d);
+    assert(ret == ARGON2_OK);
+
+    context.out = out;
+    for (i = 0; i < 3; ++i) {
+        context.flags = layouts[i];
+        ret = argon2_ctx(&context, Argon2_d);
+        assert(ret == ARGON2_OK);
+        assert(memcmp(out, lane_major, OUT_LEN) == 0);
+    }
+    printf("Hash with every layout: PASS\n");
+
+    context.flags = ARGON2_FLAG_LAYOUT_SEGMENT_MAJOR |
+                    ARGON2_FLAG_LAYOUT_SPLIT_LANES;
+    ret = argon2_ctx(&context, Argon2_d);
+    assert(ret == ARGON2_INCORRECT_PARAMETER);
+    printf("Reject conflicting layouts: PASS\n");
+}
+
+/* Test harness will assert:
+ * a matrix given back to the pool is reused by the next hash
+ * idle matrices are trimmed once cold
+ * turning the pool off releases the idle matrices
+ */
+void mempooltest(uint32_t version) {
+    argon2_mempool_config config;
+    argon2_metrics before, after;
+    unsigned char out[OUT_LEN];
+    time_t deadline;
+    int ret, i;
+
+    memset(&config, 0, sizeof(config));
+    config.low_watermark = 1 << 20;
+    config.high_watermark = 0;
+    ret = argon2_mempool_configure(&config);
+    assert(ret == ARGON2_INCORRECT_PARAMETER);
+    printf("Reject inverted watermarks: PASS\n");
+
+    config.high_watermark = 64 << 20;
+    ret = argon2_mempool_configure(&config);
+    assert(ret == ARGON2_OK);
+    argon2_metrics_snapshot(&before);
+    for (i = 0; i < 2; ++i) {
+        ret = argon2_hash(2, 1 << 12, 1, "password", strlen("password"),
+                          "somesalt", strlen("somesalt"), out, OUT_LEN, NULL,
+                          0, Argon2_id, version);
+        assert(ret == ARGON2_OK);
+    }
+    argon2_metrics_snapshot(&after);
+    assert(after.mempool_hits >= before.mempool_hits + 1);
+    assert(after.mempool_retained > 0);
+    assert(after.mempool_resident > 0);
+    printf("Reuse a pooled matrix: PASS\n");
+
+#if !defined(ARGON2_NO_THREADS)
+    config.low_watermark = 0;
+    config.idle_ms = 1;
+    ret = argon2_mempool_configure(&config);
+    assert(ret == ARGON2_OK);
+    deadline = time(NULL) + 10;
+    do {
+        argon2_metrics_snapshot(&after);
+    } while (after.mempool_retained > 0 && time(NULL) < deadline);
+    assert(after.mempool_retained == 0);
+    printf("Trim cold matrices: PASS\n");
+#else
+    (void)deadline;
+#endif
+
+    ret = argon2_mempool_configure(NULL);
+    assert(ret == ARGON2_OK);
+    argon2_metrics_snapshot(&after);
+    assert(after.mempool_retained == 0);
+    assert(after.mempool_resident == 0);
+    printf("Release the pool: PASS\n");
+}
+
 int main() {
     int ret;
     unsigned char out[OUT_LEN];
@@ -285,5 +1902,69 @@ int main() {
     assert(ret == ARGON2_SALT_TOO_SHORT);
     printf("Fail on salt too short: PASS\n");
 
+    printf("\n");
+    printf("Caller-supplied memory tests\n");
+    memorytest(version);
+
+    printf("\n");
+    printf("Metrics tests\n");
+    metricstest(version);
+
+    printf("\n");
+    printf("Scheduler tests\n");
+    schedtest(version);
+
+    printf("\n");
+    printf("Memory pressure tests\n");
+    pressuretest(version);
+
+    printf("\n");
+    printf("Hasher tests\n");
+    hashertest(version);
+
+    printf("\n");
+    printf("Binary record tests\n");
+    binarytest(version);
+
+    printf("\n");
+    printf("Asynchronous verification tests\n");
+    asynctest(version);
+
+    printf("\n");
+    printf("Tenant tests\n");
+    tenanttest(version);
+
+    printf("\n");
+    printf("Cost attribution tests\n");
+    costtest(version);
+
+    printf("\n");
+    printf("Batching tests\n");
+    batchtest(version);
+
+    printf("\n");
+    printf("Hashing node tests\n");
+    nodetest(version);
+
+    printf("\n");
+    printf("Upgrade tests\n");
+    upgradetest(version);
+
+    printf("\n");
+    printf("Checkpoint tests\n");
+    checkpointtest(version);
+
+    printf("\n");
+    printf("Placement tests\n");
+    placementtest(version);
+
+    printf("\n");
+    printf("Layout tests\n");
+    layouttest(version);
+
+    printf("\n");
+    printf("Matrix pool tests\n");
+    mempooltest(version);
+
     return 0;
 }
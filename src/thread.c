@@ -17,6 +17,22 @@
 
 #if !defined(ARGON2_NO_THREADS)
 
+#if !defined(_WIN32)
+#if defined(__linux__)
+#if !defined(ARGON2_AMALGAMATION)
+/* for sched_setaffinity(), clock_gettime() and sysconf() */
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <sys/resource.h>
+#elif !defined(ARGON2_AMALGAMATION)
+/* for clock_gettime() and sysconf() */
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <time.h>
+#include <unistd.h>
+#endif
+
 #include "thread.h"
 #if defined(_WIN32)
 #include <windows.h>
@@ -54,4 +70,206 @@ void argon2_thread_exit(void) {
 #endif
 }
 
+int argon2_cond_init(argon2_cond_t *cond) {
+#if defined(_WIN32)
+    InitializeConditionVariable(cond);
+    return 0;
+#else
+    return pthread_cond_init(cond, NULL);
+#endif
+}
+
+void argon2_cond_destroy(argon2_cond_t *cond) {
+#if defined(_WIN32)
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+int argon2_mutex_init(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    InitializeSRWLock(mutex);
+    return 0;
+#else
+    return pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void argon2_mutex_destroy(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    (void)mutex;
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+#if defined(_WIN32)
+static BOOL CALLBACK argon2_once_run(PINIT_ONCE once, PVOID func,
+                                     PVOID *context) {
+    (void)once;
+    (void)context;
+    (*(void (**)(void))func)();
+    return TRUE;
+}
+#endif
+
+void argon2_thread_once(argon2_once_t *once, void (*func)(void)) {
+#if defined(_WIN32)
+    InitOnceExecuteOnce(once, argon2_once_run, &func, NULL);
+#else
+    pthread_once(once, func);
+#endif
+}
+
+#if !defined(_WIN32) && !defined(__GNUC__)
+/* Unknown compiler: no atomics, so a lock guards every access */
+static pthread_mutex_t argon2_atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+int argon2_atomic_load(const int *p) {
+#if defined(_WIN32)
+    return (int)InterlockedCompareExchange((volatile LONG *)p, 0, 0);
+#elif defined(__GNUC__)
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+    int value;
+    pthread_mutex_lock(&argon2_atomic_mutex);
+    value = *p;
+    pthread_mutex_unlock(&argon2_atomic_mutex);
+    return value;
+#endif
+}
+
+void argon2_atomic_store(int *p, int value) {
+#if defined(_WIN32)
+    InterlockedExchange((volatile LONG *)p, (LONG)value);
+#elif defined(__GNUC__)
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+#else
+    pthread_mutex_lock(&argon2_atomic_mutex);
+    *p = value;
+    pthread_mutex_unlock(&argon2_atomic_mutex);
+#endif
+}
+
+int argon2_thread_atfork(void (*prepare)(void), void (*parent)(void),
+                         void (*child)(void)) {
+#if defined(_WIN32)
+    (void)prepare;
+    (void)parent;
+    (void)child;
+    return -1;
+#else
+    return pthread_atfork(prepare, parent, child) == 0 ? 0 : -1;
+#endif
+}
+
+void argon2_mutex_lock(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void argon2_mutex_unlock(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void argon2_cond_wait(argon2_cond_t *cond, argon2_mutex_t *mutex,
+                      unsigned timeout_ms) {
+    argon2_cond_wait_us(cond, mutex, (unsigned long)timeout_ms * 1000);
+}
+
+void argon2_cond_wait_us(argon2_cond_t *cond, argon2_mutex_t *mutex,
+                         unsigned long timeout_us) {
+#if defined(_WIN32)
+    SleepConditionVariableSRW(cond, mutex,
+                              timeout_us ? (DWORD)((timeout_us + 999) / 1000)
+                                         : INFINITE,
+                              0);
+#else
+    if (timeout_us == 0) {
+        pthread_cond_wait(cond, mutex);
+    } else {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_us / 1000000;
+        deadline.tv_nsec += (long)(timeout_us % 1000000) * 1000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(cond, mutex, &deadline);
+    }
+#endif
+}
+
+void argon2_cond_broadcast(argon2_cond_t *cond) {
+#if defined(_WIN32)
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+unsigned argon2_thread_cpus(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+#else
+    return 1;
+#endif
+}
+
+int argon2_thread_pin(unsigned cpu) {
+#if defined(_WIN32)
+    if (cpu >= sizeof(DWORD_PTR) * 8) {
+        return -1;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0
+               ? 0
+               : -1;
+#elif defined(__linux__)
+    cpu_set_t set;
+    if (cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+int argon2_thread_lower_priority(void) {
+#if defined(_WIN32)
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE) ? 0
+                                                                        : -1;
+#elif defined(__linux__)
+    /* Both apply to the calling thread only on Linux */
+#if defined(SCHED_IDLE)
+    struct sched_param param;
+    param.sched_priority = 0;
+    if (sched_setscheduler(0, SCHED_IDLE, &param) == 0) {
+        return 0;
+    }
+#endif
+    return setpriority(PRIO_PROCESS, 0, 19);
+#else
+    return -1;
+#endif
+}
+
 #endif /* ARGON2_NO_THREADS */
@@ -18,26 +18,46 @@
 #ifndef ARGON2_THREAD_H
 #define ARGON2_THREAD_H
 
+#include "argon2.h"
+
 #if !defined(ARGON2_NO_THREADS)
 
 /*
         Here we implement an abstraction layer for the simpĺe requirements
         of the Argon2 code. We only require 3 primitives---thread creation,
-        joining, and termination---so full emulation of the pthreads API
-        is unwarranted. Currently we wrap pthreads and Win32 threads.
+        joining, and termination---plus a mutex and a condition variable
+        for the scheduler, so full emulation of the pthreads API is
+        unwarranted. Currently we wrap pthreads and Win32 threads.
 
-        The API defines 2 types: the function pointer type,
+        The API defines 5 types: the function pointer type,
    argon2_thread_func_t,
-        and the type of the thread handle---argon2_thread_handle_t.
+        the type of the thread handle---argon2_thread_handle_t, the
+        argon2_mutex_t and argon2_cond_t synchronization objects, which
+        can be statically initialized with ARGON2_MUTEX_INITIALIZER and
+        ARGON2_COND_INITIALIZER, and argon2_once_t, initialized with
+        ARGON2_ONCE_INIT.
 */
 #if defined(_WIN32)
+#include <windows.h>
 #include <process.h>
 typedef unsigned(__stdcall *argon2_thread_func_t)(void *);
 typedef uintptr_t argon2_thread_handle_t;
+typedef SRWLOCK argon2_mutex_t;
+typedef CONDITION_VARIABLE argon2_cond_t;
+typedef INIT_ONCE argon2_once_t;
+#define ARGON2_MUTEX_INITIALIZER SRWLOCK_INIT
+#define ARGON2_COND_INITIALIZER CONDITION_VARIABLE_INIT
+#define ARGON2_ONCE_INIT INIT_ONCE_STATIC_INIT
 #else
 #include <pthread.h>
 typedef void *(*argon2_thread_func_t)(void *);
 typedef pthread_t argon2_thread_handle_t;
+typedef pthread_mutex_t argon2_mutex_t;
+typedef pthread_cond_t argon2_cond_t;
+typedef pthread_once_t argon2_once_t;
+#define ARGON2_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define ARGON2_COND_INITIALIZER PTHREAD_COND_INITIALIZER
+#define ARGON2_ONCE_INIT PTHREAD_ONCE_INIT
 #endif
 
 /* Creates a thread
@@ -49,19 +69,89 @@ typedef pthread_t argon2_thread_handle_t;
  * @return 0 if @handle and @func are valid pointers and a thread is successfully
  * created.
  */
-int argon2_thread_create(argon2_thread_handle_t *handle,
-                         argon2_thread_func_t func, void *args);
+ARGON2_LOCAL int argon2_thread_create(argon2_thread_handle_t *handle,
+                                      argon2_thread_func_t func, void *args);
 
 /* Waits for a thread to terminate
  * @param handle Handle to a thread created with argon2_thread_create.
  * @return 0 if @handle is a valid handle, and joining completed successfully.
 */
-int argon2_thread_join(argon2_thread_handle_t handle);
+ARGON2_LOCAL int argon2_thread_join(argon2_thread_handle_t handle);
 
 /* Terminate the current thread. Must be run inside a thread created by
  * argon2_thread_create.
 */
-void argon2_thread_exit(void);
+ARGON2_LOCAL void argon2_thread_exit(void);
+
+/* Initializes a condition variable that cannot be statically initialized
+ * @return 0 on success
+ */
+ARGON2_LOCAL int argon2_cond_init(argon2_cond_t *cond);
+
+/* Releases the resources of a condition variable initialized with
+ * argon2_cond_init(), which no thread may be waiting on */
+ARGON2_LOCAL void argon2_cond_destroy(argon2_cond_t *cond);
+
+/* Initializes and destroys a mutex that cannot be statically initialized
+ * @return 0 on success
+ */
+ARGON2_LOCAL int argon2_mutex_init(argon2_mutex_t *mutex);
+ARGON2_LOCAL void argon2_mutex_destroy(argon2_mutex_t *mutex);
+
+/* Acquires and releases a mutex */
+ARGON2_LOCAL void argon2_mutex_lock(argon2_mutex_t *mutex);
+ARGON2_LOCAL void argon2_mutex_unlock(argon2_mutex_t *mutex);
+
+/* Atomically releases @mutex and waits for @cond to be signaled, for at most
+ * @timeout_ms milliseconds unless @timeout_ms is 0. @mutex is held again on
+ * return. Spurious wake-ups are possible, callers re-check their condition.
+ */
+ARGON2_LOCAL void argon2_cond_wait(argon2_cond_t *cond, argon2_mutex_t *mutex,
+                                   unsigned timeout_ms);
+
+/* Same as argon2_cond_wait(), for at most @timeout_us microseconds (rounded
+ * up to milliseconds on Windows) */
+ARGON2_LOCAL void argon2_cond_wait_us(argon2_cond_t *cond,
+                                      argon2_mutex_t *mutex,
+                                      unsigned long timeout_us);
+
+/* Wakes up all threads waiting on @cond */
+ARGON2_LOCAL void argon2_cond_broadcast(argon2_cond_t *cond);
+
+/* Registers handlers run around fork(): @prepare before it in the parent,
+ * @parent after it in the parent, @child after it in the child, where only
+ * the forking thread exists
+ * @return 0 on success, -1 if the platform does not fork
+ */
+ARGON2_LOCAL int argon2_thread_atfork(void (*prepare)(void),
+                                      void (*parent)(void),
+                                      void (*child)(void));
+
+/* Runs @func the first time it is called with @once, initialized with
+ * ARGON2_ONCE_INIT; later calls return once it is done. Handlers are
+ * registered with argon2_thread_atfork() this way, without any lock a
+ * @prepare handler takes held: fork() keeps registrations out while it runs
+ * the handlers. */
+ARGON2_LOCAL void argon2_thread_once(argon2_once_t *once, void (*func)(void));
+
+/* Reads and writes an int that threads share without a lock: the write is
+ * a release and the read an acquire */
+ARGON2_LOCAL int argon2_atomic_load(const int *p);
+ARGON2_LOCAL void argon2_atomic_store(int *p, int value);
+
+/* Returns the number of online processors, at least 1 */
+ARGON2_LOCAL unsigned argon2_thread_cpus(void);
+
+/* Restricts the calling thread to processor @cpu
+ * @return 0 on success, -1 if the platform does not support it
+ */
+ARGON2_LOCAL int argon2_thread_pin(unsigned cpu);
+
+/* Gives the calling thread the lowest scheduling priority, so that it only
+ * runs on otherwise idle processors
+ * @return 0 on success, -1 if the platform does not support it
+ */
+ARGON2_LOCAL int argon2_thread_lower_priority(void);
 
 #endif /* ARGON2_NO_THREADS */
 #endif
@@ -0,0 +1,49 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_TRACE_H
+#define ARGON2_TRACE_H
+
+/*
+ * Static tracepoints (USDT) at the phase boundaries of a hash, for bpftrace,
+ * perf or SystemTap attached to a live process. They are compiled in when
+ * ARGON2_USDT is defined (make USDT=1, needs <sys/sdt.h>); an unattached probe
+ * costs a single nop. Otherwise the macros expand to nothing.
+ *
+ * Probes of provider "argon2" and their arguments:
+ *   ctx__start(type, m_cost, t_cost, lanes)    ctx__done(type, result)
+ *   init__start(memory_blocks, lanes)          init__done(result)
+ *   slice__start(pass, slice)                  slice__done(pass, slice)
+ *   segment__start(pass, slice, lane)          segment__done(pass, slice, lane)
+ *   finalize__start(lanes)                     finalize__done(outlen)
+ *   allocate(bytes, memory)                    free(bytes, memory)
+ */
+
+#if defined(ARGON2_USDT)
+#include <sys/sdt.h>
+#define ARGON2_PROBE1(name, a) DTRACE_PROBE1(argon2, name, a)
+#define ARGON2_PROBE2(name, a, b) DTRACE_PROBE2(argon2, name, a, b)
+#define ARGON2_PROBE3(name, a, b, c) DTRACE_PROBE3(argon2, name, a, b, c)
+#define ARGON2_PROBE4(name, a, b, c, d) DTRACE_PROBE4(argon2, name, a, b, c, d)
+#else
+#define ARGON2_PROBE1(name, a)
+#define ARGON2_PROBE2(name, a, b)
+#define ARGON2_PROBE3(name, a, b, c)
+#define ARGON2_PROBE4(name, a, b, c, d)
+#endif
+
+#endif
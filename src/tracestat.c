@@ -0,0 +1,296 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "access.h"
+
+/*
+ * Reads reference-access traces written by argon2-trace (see src/access.h)
+ * and reports, for every hash in them:
+ *  - the share of references to other lanes;
+ *  - reuse distance: how many blocks were computed since the referenced
+ *    block was last written or referenced, as a log2 histogram;
+ *  - the page-level working set of each slice: the distinct pages written
+ *    or referenced while the slice was filled, for a given page size and
+ *    physical layout.
+ */
+
+#define DISTANCE_BUCKETS 33
+
+typedef enum { LAYOUT_LANE, LAYOUT_SEGMENT, LAYOUT_SPLIT } layout_t;
+
+/* Statistics of one hash */
+typedef struct stats_ {
+    uint32_t type, version, passes, lanes, segment_length, lane_length;
+    uint64_t memory_blocks, blocks, cross_lane;
+    uint64_t distance[DISTANCE_BUCKETS];
+    uint64_t *last_touch; /* per block, 1 + blocks computed at last touch */
+
+    uint32_t page_blocks, lane_pages;
+    uint64_t *page_window; /* per page, the last slice window it was seen in */
+    uint64_t window, window_pages, slices, pages_sum, pages_max;
+    uint32_t window_pass, window_slice;
+} stats_t;
+
+static void fatal(const char *error) {
+    fprintf(stderr, "Error: %s\n", error);
+    exit(1);
+}
+
+static void usage(const char *cmd) {
+    printf("Usage:  %s [-h] [-k page_kib] [-l lane|segment|split] trace\n",
+           cmd);
+    printf("Parameters:\n");
+    printf("\ttrace\t\tThe access trace, as written by argon2-trace\n");
+    printf("\t-k N\t\tSets the page size to N KiB (default 4)\n");
+    printf("\t-l layout\tPhysical layout the working set is computed for "
+           "(default lane)\n");
+    printf("\t-h\t\tPrint %s usage\n", cmd);
+}
+
+static uint32_t load_frame_word(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+/* Page holding block (lane, index) in the given layout */
+static uint64_t page_of(const stats_t *st, layout_t layout, uint32_t lane,
+                        uint32_t index) {
+    uint64_t offset;
+    switch (layout) {
+    case LAYOUT_SEGMENT:
+        offset = ((uint64_t)(index / st->segment_length) * st->lanes + lane) *
+                     st->segment_length +
+                 index % st->segment_length;
+        return offset / st->page_blocks;
+    case LAYOUT_SPLIT:
+        /* every lane starts on a page of its own */
+        return (uint64_t)lane * st->lane_pages + index / st->page_blocks;
+    default:
+        offset = (uint64_t)lane * st->lane_length + index;
+        return offset / st->page_blocks;
+    }
+}
+
+static void touch_page(stats_t *st, uint64_t page) {
+    if (st->page_window[page] != st->window) {
+        st->page_window[page] = st->window;
+        st->window_pages++;
+    }
+}
+
+static void close_window(stats_t *st) {
+    if (st->window_pages == 0) {
+        return;
+    }
+    st->slices++;
+    st->pages_sum += st->window_pages;
+    if (st->window_pages > st->pages_max) {
+        st->pages_max = st->window_pages;
+    }
+    st->window_pages = 0;
+}
+
+static void report(stats_t *st, uint32_t page_kib, const char *layout) {
+    uint64_t cumulative = 0;
+    unsigned i;
+    double page_mib = page_kib / 1024.0;
+
+    close_window(st);
+    printf("%s v=%u t=%u m=%llu p=%u (segments of %u blocks): %llu blocks "
+           "computed\n",
+           argon2_type2string((argon2_type)st->type, 1), st->version,
+           st->passes, (unsigned long long)st->memory_blocks, st->lanes,
+           st->segment_length, (unsigned long long)st->blocks);
+    if (st->blocks == 0) {
+        return;
+    }
+    printf("  cross-lane references: %.1f%%\n",
+           100.0 * st->cross_lane / st->blocks);
+    printf("  reuse distance (blocks computed since last touch):\n");
+    for (i = 0; i < DISTANCE_BUCKETS; ++i) {
+        if (st->distance[i] == 0) {
+            continue;
+        }
+        cumulative += st->distance[i];
+        if (i == 0) {
+            printf("    never touched  %6.2f%%\n",
+                   100.0 * st->distance[i] / st->blocks);
+        } else {
+            printf("    < 2^%-2u         %6.2f%%  (cumulative %6.2f%%)\n", i,
+                   100.0 * st->distance[i] / st->blocks,
+                   100.0 * cumulative / st->blocks);
+        }
+    }
+    printf("  working set per slice (%u KiB pages, %s layout): average "
+           "%.2f MiB, max %.2f MiB of %.2f MiB\n",
+           page_kib, layout,
+           st->slices ? page_mib * st->pages_sum / st->slices : 0.0,
+           page_mib * st->pages_max, st->memory_blocks / 1024.0);
+    printf("\n");
+}
+
+static void reset(stats_t *st, const uint32_t *frame, uint32_t page_kib,
+                  layout_t layout) {
+    uint64_t pages;
+    uint32_t lane;
+
+    free(st->last_touch);
+    free(st->page_window);
+    memset(st, 0, sizeof(*st));
+    st->type = frame[1];
+    st->version = frame[2];
+    st->passes = frame[3];
+    st->lanes = frame[4];
+    st->segment_length = frame[5];
+    st->lane_length = st->segment_length * ARGON2_SYNC_POINTS;
+    st->memory_blocks = (uint64_t)st->lanes * st->lane_length;
+    if (st->lanes == 0 || st->segment_length == 0) {
+        fatal("corrupt trace header");
+    }
+
+    st->page_blocks = page_kib; /* blocks are 1 KiB */
+    st->lane_pages = (st->lane_length + st->page_blocks - 1) / st->page_blocks;
+    pages = layout == LAYOUT_SPLIT
+                ? (uint64_t)st->lanes * st->lane_pages
+                : (st->memory_blocks + st->page_blocks - 1) / st->page_blocks;
+
+    st->last_touch = calloc(st->memory_blocks, sizeof(uint64_t));
+    st->page_window = calloc(pages, sizeof(uint64_t));
+    if (st->last_touch == NULL || st->page_window == NULL) {
+        fatal("out of memory");
+    }
+    for (lane = 0; lane < st->lanes; ++lane) {
+        /* the first two blocks of each lane are written before any frame */
+        st->last_touch[(uint64_t)lane * st->lane_length] = 1;
+        st->last_touch[(uint64_t)lane * st->lane_length + 1] = 1;
+    }
+    st->window = 1;
+    st->window_pass = st->window_slice = UINT32_MAX;
+}
+
+static void account(stats_t *st, const uint32_t *frame, layout_t layout) {
+    uint32_t pass = frame[0], lane = frame[1], slice = frame[2];
+    uint32_t index = frame[3], ref_lane = frame[4], ref_index = frame[5];
+    uint64_t now, ref, last, distance;
+    unsigned bucket = 0;
+
+    if (lane >= st->lanes || index >= st->lane_length ||
+        ref_lane >= st->lanes || ref_index >= st->lane_length) {
+        fatal("corrupt trace frame");
+    }
+    now = ++st->blocks + 1;
+    st->cross_lane += ref_lane != lane;
+
+    ref = (uint64_t)ref_lane * st->lane_length + ref_index;
+    last = st->last_touch[ref];
+    if (last != 0) {
+        for (distance = now - last; distance != 0; distance >>= 1) {
+            ++bucket;
+        }
+    }
+    st->distance[bucket < DISTANCE_BUCKETS ? bucket : DISTANCE_BUCKETS - 1]++;
+    st->last_touch[ref] = now;
+    st->last_touch[(uint64_t)lane * st->lane_length + index] = now;
+
+    if (pass != st->window_pass || slice != st->window_slice) {
+        close_window(st);
+        st->window++;
+        st->window_pass = pass;
+        st->window_slice = slice;
+    }
+    touch_page(st, page_of(st, layout, lane, index));
+    touch_page(st, page_of(st, layout, ref_lane, ref_index));
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL, *layout_name = "lane";
+    layout_t layout = LAYOUT_LANE;
+    uint32_t page_kib = 4;
+    unsigned char bytes[ACCESS_FRAME_WORDS * 4];
+    uint32_t frame[ACCESS_FRAME_WORDS];
+    stats_t st;
+    int have_hash = 0, i;
+    FILE *f;
+
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-h")) {
+            usage(argv[0]);
+            return 0;
+        } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+            page_kib = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (page_kib == 0) {
+                fatal("bad page size");
+            }
+        } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            layout_name = argv[++i];
+            if (!strcmp(layout_name, "lane")) {
+                layout = LAYOUT_LANE;
+            } else if (!strcmp(layout_name, "segment")) {
+                layout = LAYOUT_SEGMENT;
+            } else if (!strcmp(layout_name, "split")) {
+                layout = LAYOUT_SPLIT;
+            } else {
+                fatal("unknown layout");
+            }
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (path == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        fatal("cannot open the trace");
+    }
+    memset(&st, 0, sizeof(st));
+    while (fread(bytes, sizeof(bytes), 1, f) == 1) {
+        unsigned w;
+        for (w = 0; w < ACCESS_FRAME_WORDS; ++w) {
+            frame[w] = load_frame_word(bytes + 4 * w);
+        }
+        if (frame[0] == ACCESS_HASH_MARK) {
+            if (have_hash) {
+                report(&st, page_kib, layout_name);
+            }
+            reset(&st, frame, page_kib, layout);
+            have_hash = 1;
+        } else if (have_hash) {
+            account(&st, frame, layout);
+        } else {
+            fatal("trace does not start with a hash header");
+        }
+    }
+    fclose(f);
+    if (have_hash) {
+        report(&st, page_kib, layout_name);
+    }
+    free(st.last_touch);
+    free(st.page_window);
+    return 0;
+}
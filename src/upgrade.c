@@ -0,0 +1,195 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "core.h"
+#include "encoding.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "tasks.h"
+
+/* A rehash waiting for, or running on, an upgrade worker */
+typedef struct upgrade_job {
+    argon2_task task; /* first, see tasks.h */
+    uint8_t *pwd; /* copies, wiped once hashed */
+    size_t pwdlen;
+    uint8_t *salt;
+    argon2_upgrade_params params;
+    argon2_upgrade_callback callback;
+    void *arg;
+} upgrade_job;
+
+/*
+ * Tells whether @encoded was made with other parameters than @params
+ * @return 1 if it was, 0 if not, or an error code if it cannot be decoded
+ */
+static int upgrade_needed(const char *encoded, argon2_type type,
+                          const argon2_upgrade_params *params) {
+    argon2_context ctx;
+    size_t encoded_len = strlen(encoded);
+    int ret;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.saltlen = (uint32_t)encoded_len;
+    ctx.outlen = (uint32_t)encoded_len;
+    ctx.salt = malloc(ctx.saltlen);
+    ctx.out = malloc(ctx.outlen);
+    if (!ctx.salt || !ctx.out) {
+        ret = ARGON2_MEMORY_ALLOCATION_ERROR;
+    } else if ((ret = decode_string(&ctx, encoded, type)) == ARGON2_OK) {
+        ret = type != params->type || ctx.version != params->version ||
+              ctx.t_cost != params->t_cost || ctx.m_cost != params->m_cost ||
+              ctx.lanes != params->parallelism ||
+              ctx.saltlen != params->saltlen ||
+              ctx.outlen != params->hashlen;
+    }
+    free(ctx.salt);
+    free(ctx.out);
+    return ret;
+}
+
+/* Wipes the password of a job and frees it */
+static void upgrade_free(upgrade_job *job) {
+    secure_wipe_memory(job->pwd, job->pwdlen);
+    free(job->pwd);
+    free(job->salt);
+    free(job);
+    metrics_add(METRIC_UPGRADES_PENDING, -1);
+}
+
+/* Drops a job queued by the parent of a forked child */
+static void upgrade_forget(argon2_task *task) {
+    upgrade_free((upgrade_job *)task);
+}
+
+/* Rehashes the password of a job, hands the result to its callback, and
+ * frees the job */
+static void upgrade_run(argon2_task *task) {
+    upgrade_job *job = (upgrade_job *)task;
+    const argon2_upgrade_params *params = &job->params;
+    size_t encodedlen =
+        argon2_encodedlen(params->t_cost, params->m_cost, params->parallelism,
+                          params->saltlen, params->hashlen, params->type);
+    char *encoded = malloc(encodedlen);
+    uint8_t *out = malloc(params->hashlen);
+    argon2_context context;
+    argon2_sched_ticket ticket;
+    int result;
+
+    memset(&context, 0, sizeof(context));
+    context.out = out;
+    context.outlen = params->hashlen;
+    context.pwd = job->pwd;
+    context.pwdlen = (uint32_t)job->pwdlen;
+    context.salt = job->salt;
+    context.saltlen = params->saltlen;
+    context.t_cost = params->t_cost;
+    context.m_cost = params->m_cost;
+    context.lanes = params->parallelism;
+    /* one lane at a time: the lane pool stays with the foreground hashes */
+    context.threads = 1;
+    context.flags = ARGON2_DEFAULT_FLAGS;
+    context.version = params->version;
+
+    /* This thread has the lowest priority: admitted, it could hold a slot
+     * for as long as foreground hashes keep the processors busy */
+    sched_ticket(&ticket, 0);
+    sched_exempt(&ticket);
+    if (encoded == NULL || out == NULL) {
+        result = ARGON2_MEMORY_ALLOCATION_ERROR;
+    } else if ((result = hash_ticket(&context, params->type, &ticket)) ==
+                   ARGON2_OK &&
+               encode_string(encoded, encodedlen, &context, params->type) !=
+                   ARGON2_OK) {
+        result = ARGON2_ENCODING_FAIL;
+    }
+    sched_release(&ticket);
+
+    job->callback(result, result == ARGON2_OK ? encoded : NULL, job->arg);
+
+    if (encoded != NULL) {
+        clear_internal_memory(encoded, encodedlen);
+        free(encoded);
+    }
+    if (out != NULL) {
+        clear_internal_memory(out, params->hashlen);
+        free(out);
+    }
+    upgrade_free(job);
+}
+
+int argon2_verify_and_upgrade(const char *encoded, const void *pwd,
+                              const size_t pwdlen, argon2_type type,
+                              const argon2_upgrade_params *params,
+                              argon2_upgrade_callback callback, void *arg) {
+    upgrade_job *job;
+    int ret;
+
+    if (params == NULL || callback == NULL) {
+        return ARGON2_MISSING_ARGS;
+    }
+    if (params->salt == NULL && params->saltlen != 0) {
+        return ARGON2_SALT_PTR_MISMATCH;
+    }
+
+    ret = argon2_verify(encoded, pwd, pwdlen, type);
+    if (ret != ARGON2_OK) {
+        return ret;
+    }
+    if (upgrade_needed(encoded, type, params) != 1) {
+        return ARGON2_OK;
+    }
+
+    job = malloc(sizeof(*job));
+    if (job != NULL) {
+        job->pwd = malloc(pwdlen + 1);
+        job->salt = malloc(params->saltlen + 1);
+    }
+    if (job == NULL || job->pwd == NULL || job->salt == NULL) {
+        if (job != NULL) {
+            free(job->pwd);
+            free(job->salt);
+            free(job);
+        }
+        callback(ARGON2_MEMORY_ALLOCATION_ERROR, NULL, arg);
+        return ARGON2_OK;
+    }
+    if (pwdlen != 0) {
+        memcpy(job->pwd, pwd, pwdlen);
+    }
+    job->pwdlen = pwdlen;
+    if (params->saltlen != 0) {
+        memcpy(job->salt, params->salt, params->saltlen);
+    }
+    job->params = *params;
+    job->params.salt = job->salt;
+    job->callback = callback;
+    job->arg = arg;
+    job->task.run = upgrade_run;
+    job->task.forget = upgrade_forget;
+
+    /* Without threads the rehash runs before returning to the caller */
+    metrics_add(METRIC_UPGRADES_PENDING, 1);
+    if (tasks_submit(TASKS_BACKGROUND, &job->task) != 0) {
+        upgrade_free(job);
+        callback(ARGON2_THREAD_FAIL, NULL, arg);
+    }
+    return ARGON2_OK;
+}
@@ -0,0 +1,243 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#if !defined(_WIN32)
+#if defined(ARGON2_AMALGAMATION)
+/* feature-test macros are set by amalgamation.h */
+#elif defined(__linux__)
+/* for getaddrinfo() */
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+#endif
+
+#include "wire.h"
+
+#if defined(ARGON2_WIRE)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "blake2/blake2-impl.h"
+
+/* Writes to a connection the peer closed fail with EPIPE rather than raise
+ * SIGPIPE, which would kill the process */
+#if defined(MSG_NOSIGNAL)
+#define WIRE_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define WIRE_SEND_FLAGS 0
+#endif
+
+/* Options of every connected socket */
+static void wire_setup(int fd) {
+    int one = 1;
+    /* Frames are small and each is sent in one call: do not hold them back
+     * waiting for the acknowledgement of the previous one */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#if defined(SO_NOSIGPIPE)
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+int wire_listen(const char *address, unsigned port, unsigned *bound) {
+    struct addrinfo hints, *list, *ai;
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+    char service[16];
+    int fd = -1, one = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    sprintf(service, "%u", port & 0xFFFF);
+    if (getaddrinfo(address, service, &hints, &list) != 0) {
+        return -1;
+    }
+    for (ai = list; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+            listen(fd, SOMAXCONN) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(list);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (getsockname(fd, (struct sockaddr *)&local, &local_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (local.ss_family == AF_INET6) {
+        *bound = ntohs(((struct sockaddr_in6 *)&local)->sin6_port);
+    } else {
+        *bound = ntohs(((struct sockaddr_in *)&local)->sin_port);
+    }
+    return fd;
+}
+
+int wire_accept(int listener, unsigned timeout_ms) {
+    struct pollfd pfd;
+    int fd;
+
+    pfd.fd = listener;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, (int)timeout_ms) <= 0) {
+        return -1;
+    }
+    fd = accept(listener, NULL, NULL);
+    if (fd >= 0) {
+        wire_setup(fd);
+    }
+    return fd;
+}
+
+/* Connects @fd to @addr without blocking for longer than @timeout_ms */
+static int wire_connect_one(int fd, const struct addrinfo *addr,
+                            unsigned timeout_ms) {
+    struct pollfd pfd;
+    int flags = fcntl(fd, F_GETFL, 0), error = 0;
+    socklen_t error_len = sizeof(error);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        return -1;
+    }
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+        if (errno != EINPROGRESS) {
+            return -1;
+        }
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (int)timeout_ms) <= 0 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 ||
+            error != 0) {
+            return -1;
+        }
+    }
+    return fcntl(fd, F_SETFL, flags);
+}
+
+int wire_connect(const char *host, const char *port, unsigned timeout_ms) {
+    struct addrinfo hints, *list, *ai;
+    int fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &list) != 0) {
+        return -1;
+    }
+    for (ai = list; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (wire_connect_one(fd, ai, timeout_ms) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(list);
+    if (fd >= 0) {
+        wire_setup(fd);
+    }
+    return fd;
+}
+
+void wire_send_timeout(int fd, unsigned timeout_ms) {
+    struct timeval timeout;
+
+    timeout.tv_sec = (time_t)(timeout_ms / 1000);
+    timeout.tv_usec = (suseconds_t)(timeout_ms % 1000 * 1000);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+int wire_send(int fd, const uint8_t *frame, size_t len) {
+    ssize_t sent;
+
+    while (len > 0) {
+        sent = send(fd, frame, len, WIRE_SEND_FLAGS);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        frame += sent;
+        len -= (size_t)sent;
+    }
+    return 0;
+}
+
+/* Receives exactly @len bytes */
+static int wire_recv_all(int fd, uint8_t *buf, size_t len) {
+    ssize_t got;
+
+    while (len > 0) {
+        got = recv(fd, buf, len, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        buf += got;
+        len -= (size_t)got;
+    }
+    return 0;
+}
+
+long wire_recv(int fd, uint8_t *frame) {
+    uint8_t length[4];
+    uint32_t len;
+
+    if (wire_recv_all(fd, length, sizeof(length)) != 0) {
+        return -1;
+    }
+    len = load32(length);
+    if (len > WIRE_FRAME_MAX || wire_recv_all(fd, frame, len) != 0) {
+        return -1;
+    }
+    return (long)len;
+}
+
+void wire_shutdown(int fd) { shutdown(fd, SHUT_RD); }
+
+void wire_close(int fd) { close(fd); }
+
+#endif /* ARGON2_WIRE */
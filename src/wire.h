@@ -0,0 +1,116 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : https://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef ARGON2_WIRE_H
+#define ARGON2_WIRE_H
+
+#include "argon2-node.h"
+
+/* Hashing nodes need sockets and threads, see argon2_server_start() */
+#if !defined(ARGON2_NO_THREADS) && !defined(_WIN32)
+#define ARGON2_WIRE
+#endif
+
+/*
+ * Protocol between argon2_client and argon2_server, over TCP. Each message
+ * is a frame: its length (the bytes after it) as 4 bytes, then the fields
+ * below. All integers are 4 bytes little-endian, as in Argon2 itself.
+ *
+ *  request:  id | op | type | tenant | body
+ *    WIRE_VERIFY body: encoded length | encoded string | password
+ *    WIRE_HASH body:   t_cost | m_cost | lanes | hash length |
+ *                      salt length | salt | password
+ *  response: id | result (an argon2_error_codes value) | body
+ *    the body is the encoded hash of a successful WIRE_HASH, empty otherwise
+ *
+ * A connection carries any number of requests without waiting for their
+ * responses, which come back in completion order; the client matches them
+ * to requests by id.
+ *
+ * Trust model: the server trusts the network, not the peer. Frames are
+ * neither authenticated nor encrypted, so passwords and hashes cross it in
+ * the clear, and the tenant of a request is whatever the peer claims, so
+ * the server ignores it unless told to trust its peers.
+ * Nodes therefore listen on the loopback address unless told otherwise, and
+ * are meant to be exposed only to a network of login servers or through a
+ * tunnel. What a peer can make a node do is bounded regardless: frames are
+ * at most WIRE_FRAME_MAX bytes, a node has a bounded number of connections,
+ * each with a bounded number of requests in flight, a peer that stops
+ * reading its responses is dropped, costs above the caps of
+ * argon2_server_config are refused before anything is queued, and
+ * everything admitted goes through admission control.
+ */
+#define WIRE_VERIFY 1
+#define WIRE_HASH 2
+
+#define WIRE_REQUEST_HEADER 16  /* id, op, type, tenant */
+#define WIRE_RESPONSE_HEADER 8  /* id, result */
+#define WIRE_FRAME_MAX 8192     /* longest frame after its length */
+
+#if defined(ARGON2_WIRE)
+
+/*
+ * Opens a listening TCP socket
+ * @param address Numeric address or host name to bind, NULL for all
+ * @param port Port, 0 for one chosen by the system
+ * @param bound Where to store the port bound
+ * @return The socket, or -1
+ */
+ARGON2_LOCAL int wire_listen(const char *address, unsigned port,
+                             unsigned *bound);
+
+/*
+ * Waits at most @timeout_ms milliseconds for a connection on @listener
+ * @return The connected socket, or -1 if none arrived
+ */
+ARGON2_LOCAL int wire_accept(int listener, unsigned timeout_ms);
+
+/*
+ * Connects to @host on @port, giving up after @timeout_ms milliseconds
+ * @return The connected socket, or -1
+ */
+ARGON2_LOCAL int wire_connect(const char *host, const char *port,
+                              unsigned timeout_ms);
+
+/*
+ * Makes wire_send() on @fd fail once the peer has not taken any of the frame
+ * for @timeout_ms milliseconds
+ */
+ARGON2_LOCAL void wire_send_timeout(int fd, unsigned timeout_ms);
+
+/*
+ * Sends the @len bytes of @frame, its length field included, in full
+ * @return 0, or -1 if the connection failed or timed out
+ */
+ARGON2_LOCAL int wire_send(int fd, const uint8_t *frame, size_t len);
+
+/*
+ * Receives a frame into @frame, which holds WIRE_FRAME_MAX bytes; the length
+ * is not stored
+ * @return The frame length, or -1 at end of stream, on errors, and for
+ * frames longer than WIRE_FRAME_MAX
+ */
+ARGON2_LOCAL long wire_recv(int fd, uint8_t *frame);
+
+/* Ends the receiving side of @fd: a thread blocked in wire_recv() on it
+ * gets -1, while frames can still be sent */
+ARGON2_LOCAL void wire_shutdown(int fd);
+
+ARGON2_LOCAL void wire_close(int fd);
+
+#endif /* ARGON2_WIRE */
+#endif